@@ -5,20 +5,52 @@
 #ifndef APPFRAME_STARTER_AFDEF_H
 #define APPFRAME_STARTER_AFDEF_H
 
+#if !defined(WINDOWS) && !defined(UNIX) && !defined(LINUX)
 #define WINDOWS
+#endif
 
 const char *CONFIG_FILE = "appframe-starter.conf";
 
+const char *CONFIG_SNAPSHOT_SUFFIX = ".snapshot";
+
+// ports allocated for "auto", kept so that restarts use the same ports
+const char *PORTS_FILE = "appframe-starter.ports";
+
+// [region]_appframe.slot, the active slot of a region (blue | green)
+const char *SLOT_FILE_SUFFIX = "_appframe.slot";
+const char *SLOT_BLUE = "blue";
+const char *SLOT_GREEN = "green";
+
 #if defined(WINDOWS)
 const char *TOMCAT_CATALINA = "\\bin\\catalina.bat";
 #elif defined(UNIX) || defined(LINUX)
 const char *TOMCAT_CATALINA = "/bin/catalina.sh";
 #endif
 
+#if defined(WINDOWS)
+const char *TOMCAT_BOOTSTRAP_CLASSPATH[] = {"\\bin\\bootstrap.jar", "\\bin\\tomcat-juli.jar"};
+const char *JAVA_EXECUTABLE = "\\bin\\java.exe";
+const char *PATH_LIST_SEPARATOR = ";";
+#elif defined(UNIX) || defined(LINUX)
+const char *TOMCAT_BOOTSTRAP_CLASSPATH[] = {"/bin/bootstrap.jar", "/bin/tomcat-juli.jar"};
+const char *JAVA_EXECUTABLE = "/bin/java";
+const char *PATH_LIST_SEPARATOR = ":";
+#endif
+
 #if defined(WINDOWS)
 const char *TOMCAT_SERVER_XML = "\\conf\\server.xml";
+const char *APPFRAME_MANIFEST = "\\appframe.manifest";
+const char *TOMCAT_CONSOLE_LOG = "\\logs\\console.log";
+const char *TOMCAT_SAMPLES = "\\logs\\samples.bin";
+const char *APPCDS_ARCHIVE = "\\work\\appcds.jsa";
+const char *APPCDS_STAMP = "\\work\\appcds.stamp";
 #elif defined(UNIX) || defined(LINUX)
 const char *TOMCAT_SERVER_XML = "/conf/server.xml";
+const char *APPFRAME_MANIFEST = "/appframe.manifest";
+const char *TOMCAT_CONSOLE_LOG = "/logs/console.log";
+const char *TOMCAT_SAMPLES = "/logs/samples.bin";
+const char *APPCDS_ARCHIVE = "/work/appcds.jsa";
+const char *APPCDS_STAMP = "/work/appcds.stamp";
 #endif
 
 // default: true
@@ -30,9 +62,96 @@ const char *COMMON_JAVA_HOME = "common.java.home";
 // default: ""
 const char *COMMON_JVM_OPTIONS = "common.java.options";
 
+// default: catalina (catalina | java)
+const char *COMMON_LAUNCH_MODE = "common.launch.mode";
+
+// default: 1000 (milliseconds between two JVM starts)
+const char *COMMON_LAUNCH_STAGGER = "common.launch.stagger";
+
+// default: 1000 (milliseconds before the first restart, doubled on every crash)
+const char *COMMON_SUPERVISE_BACKOFF = "common.supervise.backoff";
+
+// default: 60000 (milliseconds, a longer run resets the crash counter)
+const char *COMMON_SUPERVISE_BACKOFF_MAX = "common.supervise.backoff.max";
+
+// default: 5 (crashes in a row before a region is given up)
+const char *COMMON_SUPERVISE_RESTART_LIMIT = "common.supervise.restart.limit";
+
+// default: 30000 (milliseconds before a region that does not stop is killed)
+const char *COMMON_SUPERVISE_SHUTDOWN_TIMEOUT = "common.supervise.shutdown.timeout";
+
+// default: 120000 (milliseconds, --ready only)
+const char *COMMON_READY_TIMEOUT = "common.ready.timeout";
+
+// default: false (write Tomcat stdout/stderr to [region]_appframe/logs/console.log)
+const char *COMMON_CONSOLE_CAPTURE = "common.console.capture";
+
+// default: 1048576 (bytes buffered per region)
+const char *COMMON_CONSOLE_BUFFER = "common.console.buffer";
+
+// default: 10485760 (bytes, console.log is rotated once it is larger)
+const char *COMMON_CONSOLE_MAX_SIZE = "common.console.max.size";
+
+// default: 5 (rotated files kept: console.log.1 ... console.log.5)
+const char *COMMON_CONSOLE_MAX_FILES = "common.console.max.files";
+
+// default: block (block | drop, what to do when the buffer is full)
+const char *COMMON_CONSOLE_OVERFLOW = "common.console.overflow";
+
+// default: false (per region AppCDS archive in [region]_appframe/work, JDK 13+)
+const char *COMMON_CDS_ENABLE = "common.cds.enable";
+
+// default: false (divide the cgroup cpu.max/memory.max across the regions)
+const char *COMMON_SIZING_ENABLE = "common.sizing.enable";
+
+// default: 70 (percent of a region's memory share used for -Xmx)
+const char *COMMON_SIZING_HEAP_PERCENT = "common.sizing.heap.percent";
+
+// default: none (none | auto, auto spreads the regions without cpu.set/numa.node over the NUMA nodes)
+const char *COMMON_NUMA_PLACEMENT = "common.numa.placement";
+
+// default: false (two CATALINA_BASE slots per region, [region]_appframe_blue and _green, see --redeploy)
+const char *COMMON_SLOTS_ENABLE = "common.slots.enable";
+
+// default: 1000 (ports of the green slot are the region's ports plus the offset)
+const char *COMMON_SLOTS_PORT_OFFSET = "common.slots.port.offset";
+
+// default: "" (built-in template, values: ${shutdown.port} ${http.port} ... sections: ${#https.port}...${/https.port})
+const char *COMMON_SERVER_XML_TEMPLATE = "common.server.xml.template";
+
+// default: 0 (disabled), milliseconds between two samples of /proc/<pid> (Linux only)
+const char *COMMON_SAMPLER_INTERVAL = "common.sampler.interval";
+
+// default: 3600 (samples kept per region in [region]_appframe/logs/samples.bin)
+const char *COMMON_SAMPLER_CAPACITY = "common.sampler.capacity";
+
+// default: 0 (disabled), seconds between two scans of [region]_appframe/logs (Linux only)
+const char *COMMON_LOGS_INTERVAL = "common.logs.interval";
+
+// default: 3600 (seconds, closed log files not modified for this long are compressed to .gz)
+const char *COMMON_LOGS_MAX_AGE = "common.logs.max.age";
+
+// default: 0 (disabled), bytes, a log file being written is compressed and truncated once larger
+const char *COMMON_LOGS_MAX_SIZE = "common.logs.max.size";
+
+// default: 0 (unlimited), bytes per region logs directory, the oldest archives and closed logs are deleted
+const char *COMMON_LOGS_BUDGET = "common.logs.budget";
+
+// default: 2 (compression threads, they run under SCHED_IDLE and the idle IO class)
+const char *COMMON_LOGS_THREADS = "common.logs.threads";
+
+// default: "" (disabled), [address:]port of the /metrics endpoint, the address defaults to 127.0.0.1
+const char *COMMON_METRICS_LISTEN = "common.metrics.listen";
+
+// default: 20000-29999 (ports for [region].*.port=auto)
+const char *COMMON_PORT_RANGE = "common.port.range";
+
 // default: CATALINA_HOME
 const char *COMMON_TOMCAT_LOCATION = "common.tomcat.location";
 
+// default: 200 (milliseconds)
+const char *COMMON_WATCH_DEBOUNCE = "common.watch.debounce";
+
 // required
 const char *APPFRAME_WAR_LOCATION = ".war.location";
 
@@ -48,12 +167,68 @@ const char *APPFRAME_HTTP_PORT = ".http.port";
 // default: ""
 const char *APPFRAME_HTTPS_PORT = ".https.port";
 
-// default: 1099
+// default: "" (JMX remote through -Dcom.sun.management.jmxremote.*, bound to 127.0.0.1)
 const char *APPFRAME_JMX_PORT = ".jmx.port";
 
+// default: true (false lets everyone who reaches jmx.port run code in the JVM)
+const char *APPFRAME_JMX_AUTHENTICATE = ".jmx.authenticate";
+
+// default: "" (required when jmx.port is set and jmx.authenticate=true, readable by the JVM user only)
+const char *APPFRAME_JMX_PASSWORD_FILE = ".jmx.password.file";
+
+// default: "" (the JDK's conf/management/jmxremote.access)
+const char *APPFRAME_JMX_ACCESS_FILE = ".jmx.access.file";
+
 // default: ""
 const char *APPFRAME_AJP_PORT = ".ajp.port";
 
+// default: "" (Tomcat's default ~/.keystore)
+const char *APPFRAME_HTTPS_KEYSTORE = ".https.keystore";
+
+// default: "" (Tomcat's default changeit)
+const char *APPFRAME_HTTPS_KEYSTORE_PASSWORD = ".https.keystore.password";
+
+// default: HTTP/1.1 (HTTP/1.1 | nio | nio2 | apr)
+const char *APPFRAME_CONNECTOR_PROTOCOL = ".connector.protocol";
+
+// default: "" (200, threads of the executor shared by the connectors)
+const char *APPFRAME_CONNECTOR_MAX_THREADS = ".connector.maxThreads";
+
+// default: "" (25, idle threads kept by the shared executor)
+const char *APPFRAME_CONNECTOR_MIN_SPARE_THREADS = ".connector.minSpareThreads";
+
+// default: "" (100, queued connections when all threads are busy)
+const char *APPFRAME_CONNECTOR_ACCEPT_COUNT = ".connector.acceptCount";
+
+// default: "" (8192, -1 for no limit)
+const char *APPFRAME_CONNECTOR_MAX_CONNECTIONS = ".connector.maxConnections";
+
+// default: "" (connectionTimeout, milliseconds, -1 for no timeout)
+const char *APPFRAME_CONNECTOR_KEEP_ALIVE_TIMEOUT = ".connector.keepAliveTimeout";
+
+// default: "" (100, -1 for no limit, 1 disables keep-alive)
+const char *APPFRAME_CONNECTOR_MAX_KEEP_ALIVE_REQUESTS = ".connector.maxKeepAliveRequests";
+
+// default: "" (off | on | force | minimum response size in bytes)
+const char *APPFRAME_CONNECTOR_COMPRESSION = ".connector.compression";
+
+// default: dev (dev | production)
+const char *APPFRAME_PROFILE = ".profile";
+const char *PROFILE_DEV = "dev";
+const char *PROFILE_PRODUCTION = "production";
+
+// default: "" (no HTTP check, --ready only)
+const char *APPFRAME_READY_PATH = ".ready.path";
+
+// default: 1 (share of cpu and memory, common.sizing.enable only)
+const char *APPFRAME_SIZING_WEIGHT = ".sizing.weight";
+
+// default: "" (cpus the JVM runs on, e.g. 0-3,8-11)
+const char *APPFRAME_CPU_SET = ".cpu.set";
+
+// default: "" (NUMA node the JVM runs on and allocates from)
+const char *APPFRAME_NUMA_NODE = ".numa.node";
+
 
 const int CONF_COPY_FILE_NUMBER = 9;
 const char *CONF_COPY_FILE[] = {
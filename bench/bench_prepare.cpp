@@ -0,0 +1,477 @@
+//
+// Created by arsia on 2026/10/19.
+//
+// End-to-end benchmark of the CATALINA_BASE preparation.
+//
+// bench_prepare [--war-size MB] [--iterations N] [--regions N] [--port BASE] [--dir /tmp]
+//               [--starter PATH] [--output result.json]
+//
+// Builds a synthetic Tomcat home (the CONF_COPY_FILE entries, server.xml and a
+// bin/catalina.sh that exits at once) and WAR, then runs the real starter in
+// it: configuration, region checks and generateVirtualTomcat, as in
+// production. Every scenario reports the wall time of the runs (p50/p99), the
+// peak RSS of the starter and the syscalls of one extra run under ptrace.
+//
+
+#include <algorithm>
+#include <chrono>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <ftw.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/ptrace.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+#ifndef APPFRAME_STARTER
+#define APPFRAME_STARTER "appframe-starter"
+#endif
+
+static const char *CONF_FILES[] = {
+        "catalina.policy",
+        "catalina.properties",
+        "context.xml",
+        "jaspic-providers.xml",
+        "jaspic-providers.xsd",
+        "logging.properties",
+        "tomcat-users.xml",
+        "tomcat-users.xsd",
+        "web.xml",
+        "server.xml"
+};
+
+// about the sizes of a Tomcat 9 distribution
+static const size_t CONF_SIZES[] = {13000, 8000, 1400, 1100, 2500, 2400, 2700, 2500, 172000, 7500};
+
+/* synthetic installation */
+struct Setup {
+    std::string directory;
+    std::string starter;
+    std::string war;
+    size_t warBytes;
+    int regions;
+    int port;
+};
+
+static unsigned long long randomState = 0x9E3779B97F4A7C15ULL;
+
+static unsigned long long nextRandom() {
+    randomState ^= randomState << 13;
+    randomState ^= randomState >> 7;
+    randomState ^= randomState << 17;
+    return randomState;
+}
+
+static bool writeFile(const std::string &path, const std::string &content, mode_t mode = 0644) {
+    int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, mode);
+    if (fd == -1 || write(fd, content.data(), content.size()) != (ssize_t) content.size()) {
+        fprintf(stderr, "bench_prepare: write file failed.[%s]\n", path.c_str());
+        if (fd != -1) {
+            close(fd);
+        }
+        return false;
+    }
+    close(fd);
+    return true;
+}
+
+static std::string confContent(const char *name, size_t size) {
+    std::string content = "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n<!-- bench_prepare: ";
+    content.append(name).append(" -->\n");
+    while (content.size() < size) {
+        content.append("<!-- Licensed to the Apache Software Foundation (ASF) under one or more contributor "
+                       "license agreements. -->\n");
+    }
+    return content;
+}
+
+// random bytes do not compress, like the jars in a WAR
+static bool writeWar(const std::string &path, size_t size) {
+    int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd == -1) {
+        fprintf(stderr, "bench_prepare: create war failed.[%s]\n", path.c_str());
+        return false;
+    }
+    std::vector<unsigned long long> buffer(1 << 17);
+    size_t written = 0;
+    while (written < size) {
+        for (auto &word : buffer) {
+            word = nextRandom();
+        }
+        size_t chunk = std::min(size - written, buffer.size() * sizeof(buffer[0]));
+        if (write(fd, buffer.data(), chunk) != (ssize_t) chunk) {
+            fprintf(stderr, "bench_prepare: write war failed.[%s]\n", path.c_str());
+            close(fd);
+            return false;
+        }
+        written += chunk;
+    }
+    close(fd);
+    return true;
+}
+
+// changes 4 KiB in the middle and the mtime, the size stays the same
+static bool changeWar(const Setup &setup) {
+    int fd = open(setup.war.c_str(), O_WRONLY | O_CLOEXEC);
+    if (fd == -1) {
+        return false;
+    }
+    unsigned long long block[512];
+    for (auto &word : block) {
+        word = nextRandom();
+    }
+    off_t offset = (off_t) (setup.warBytes / 2) & ~(off_t) 4095;
+    bool success = pwrite(fd, block, sizeof(block), offset) == (ssize_t) sizeof(block);
+    struct timespec times[2];
+    clock_gettime(CLOCK_REALTIME, &times[0]);
+    times[1] = times[0];
+    futimens(fd, times);
+    close(fd);
+    return success;
+}
+
+static bool createSetup(const Setup &setup) {
+    std::string tomcat = setup.directory + "/tomcat";
+    for (const std::string &path : {setup.directory, tomcat, tomcat + "/conf", tomcat + "/bin", tomcat + "/lib",
+                                    setup.directory + "/jdk", setup.directory + "/bshome"}) {
+        if (0 != mkdir(path.c_str(), 0755) && errno != EEXIST) {
+            fprintf(stderr, "bench_prepare: mkdir failed.[%s]\n", path.c_str());
+            return false;
+        }
+    }
+    for (size_t i = 0; i < sizeof(CONF_FILES) / sizeof(CONF_FILES[0]); i++) {
+        if (!writeFile(tomcat + "/conf/" + CONF_FILES[i], confContent(CONF_FILES[i], CONF_SIZES[i]))) {
+            return false;
+        }
+    }
+    if (!writeFile(tomcat + "/bin/catalina.sh", "#!/bin/sh\nexit 0\n", 0755) ||
+        !writeWar(setup.war, setup.warBytes)) {
+        return false;
+    }
+    return true;
+}
+
+static bool writeConfiguration(const Setup &setup, int regions) {
+    std::string content;
+    content.append("common.tomcat.location=").append(setup.directory).append("/tomcat\n");
+    content.append("common.java.home=").append(setup.directory).append("/jdk\n");
+    content.append("common.launch.mode=catalina\n");
+    content.append("common.launch.stagger=0\n");
+    for (int i = 0; i < regions; i++) {
+        std::string region = "bench" + std::to_string(i);
+        content.append(region).append(".war.location=").append(setup.war).append("\n");
+        content.append(region).append(".bshome.location=").append(setup.directory).append("/bshome\n");
+        content.append(region).append(".shutdown.port=").append(std::to_string(setup.port + i * 2)).append("\n");
+        content.append(region).append(".http.port=").append(std::to_string(setup.port + i * 2 + 1)).append("\n");
+    }
+    return writeFile(setup.directory + "/appframe-starter.conf", content);
+}
+
+static int removeEntry(const char *path, const struct stat *, int, struct FTW *) {
+    return remove(path);
+}
+
+static void removeTree(const std::string &path) {
+    nftw(path.c_str(), removeEntry, 16, FTW_DEPTH | FTW_PHYS);
+}
+
+static void removeRegions(const Setup &setup, int regions) {
+    for (int i = 0; i < regions; i++) {
+        removeTree(setup.directory + "/bench" + std::to_string(i) + "_appframe");
+    }
+}
+
+static int evictEntry(const char *path, const struct stat *, int type, struct FTW *) {
+    if (type == FTW_F) {
+        int fd = open(path, O_RDONLY | O_CLOEXEC);
+        if (fd != -1) {
+            posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+            close(fd);
+        }
+    }
+    return 0;
+}
+
+// drops the page cache when running as root, else evicts the inputs and the starter
+static const char *evictCaches(const Setup &setup) {
+    sync();
+    int fd = open("/proc/sys/vm/drop_caches", O_WRONLY | O_CLOEXEC);
+    if (fd != -1) {
+        bool dropped = write(fd, "1", 1) == 1;
+        close(fd);
+        if (dropped) {
+            return "drop_caches";
+        }
+    }
+    nftw(setup.directory.c_str(), evictEntry, 16, FTW_PHYS);
+    evictEntry(setup.starter.c_str(), nullptr, FTW_F, nullptr);
+    return "fadvise";
+}
+
+/* measurement */
+struct Run {
+    double millis;
+    long peakRssKb;
+    int status;
+};
+
+static void execStarter(const Setup &setup, const std::vector<std::string> &regions, bool traced) {
+    if (0 != chdir(setup.directory.c_str())) {
+        _exit(127);
+    }
+    int log = open((setup.directory + "/starter.log").c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (log != -1) {
+        dup2(log, STDOUT_FILENO);
+        dup2(log, STDERR_FILENO);
+    }
+    std::vector<char *> argv;
+    argv.push_back((char *) setup.starter.c_str());
+    for (auto &region : regions) {
+        argv.push_back((char *) region.c_str());
+    }
+    argv.push_back(nullptr);
+    if (traced) {
+        ptrace(PTRACE_TRACEME, 0, nullptr, nullptr);
+    }
+    execv(argv[0], argv.data());
+    _exit(127);
+}
+
+static Run runStarter(const Setup &setup, const std::vector<std::string> &regions) {
+    Run run{-1, -1, -1};
+    auto begin = std::chrono::steady_clock::now();
+    pid_t pid = fork();
+    if (pid == 0) {
+        execStarter(setup, regions, false);
+    }
+    if (pid == -1) {
+        return run;
+    }
+    int status;
+    struct rusage usage{};
+    if (wait4(pid, &status, 0, &usage) == pid) {
+        run.millis = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+        run.peakRssKb = usage.ru_maxrss;
+        run.status = WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+    }
+    return run;
+}
+
+// syscalls of the starter and its threads, not of the processes it starts; -1 without ptrace
+static long long countSyscalls(const Setup &setup, const std::vector<std::string> &regions) {
+    pid_t pid = fork();
+    if (pid == 0) {
+        execStarter(setup, regions, true);
+    }
+    if (pid == -1) {
+        return -1;
+    }
+    int status;
+    // stopped at exec
+    if (waitpid(pid, &status, 0) != pid || !WIFSTOPPED(status)) {
+        return -1;
+    }
+    ptrace(PTRACE_SETOPTIONS, pid, nullptr,
+           (void *) (long) (PTRACE_O_TRACESYSGOOD | PTRACE_O_TRACECLONE | PTRACE_O_EXITKILL));
+    ptrace(PTRACE_SYSCALL, pid, nullptr, nullptr);
+
+    long long syscalls = 0;
+    // a thread alternates between syscall entry and exit stops
+    std::map<pid_t, bool> inSyscall;
+    pid_t stopped;
+    while ((stopped = waitpid(-1, &status, __WALL)) > 0) {
+        if (!WIFSTOPPED(status)) {
+            inSyscall.erase(stopped);
+            continue;
+        }
+        int signal = WSTOPSIG(status);
+        int deliver = 0;
+        if (signal == (SIGTRAP | 0x80)) {
+            bool &entered = inSyscall[stopped];
+            if (!entered) {
+                syscalls++;
+            }
+            entered = !entered;
+        } else if (signal != SIGTRAP && signal != SIGSTOP) {
+            // SIGTRAP: ptrace events, SIGSTOP: new threads
+            deliver = signal;
+        }
+        ptrace(PTRACE_SYSCALL, stopped, nullptr, (void *) (long) deliver);
+    }
+    return syscalls;
+}
+
+struct Scenario {
+    std::string name;
+    int regions;
+    const char *eviction;
+    std::vector<Run> runs;
+    long long syscalls;
+};
+
+static double percentile(std::vector<double> values, double rank) {
+    if (values.empty()) {
+        return 0;
+    }
+    std::sort(values.begin(), values.end());
+    size_t index = (size_t) (rank * (double) values.size() + 0.999999);
+    return values[index == 0 ? 0 : std::min(index, values.size()) - 1];
+}
+
+/**
+ * before every run: COLD removes the CATALINA_BASEs and evicts the caches,
+ * FRESH only removes them, CHANGED_WAR changes the WAR, WARM does nothing
+ */
+enum Preparation {
+    COLD,
+    FRESH,
+    CHANGED_WAR,
+    WARM
+};
+
+static bool runScenario(const Setup &setup, Scenario &scenario, Preparation preparation, int iterations) {
+    std::vector<std::string> regions;
+    for (int i = 0; i < scenario.regions; i++) {
+        regions.push_back("bench" + std::to_string(i));
+    }
+    if (!writeConfiguration(setup, scenario.regions)) {
+        return false;
+    }
+    // the warm and changed-WAR runs start from a prepared CATALINA_BASE
+    removeRegions(setup, scenario.regions);
+    if (preparation == WARM || preparation == CHANGED_WAR) {
+        runStarter(setup, regions);
+    }
+
+    scenario.eviction = "none";
+    for (int i = 0; i <= iterations; i++) {
+        if (preparation == COLD || preparation == FRESH) {
+            removeRegions(setup, scenario.regions);
+        }
+        if (preparation == COLD) {
+            scenario.eviction = evictCaches(setup);
+        }
+        if (preparation == CHANGED_WAR && !changeWar(setup)) {
+            fprintf(stderr, "bench_prepare: change war failed.[%s]\n", setup.war.c_str());
+            return false;
+        }
+        // the last round counts the syscalls, ptrace slows it down
+        if (i == iterations) {
+            scenario.syscalls = countSyscalls(setup, regions);
+            break;
+        }
+        Run run = runStarter(setup, regions);
+        if (run.status != 0) {
+            fprintf(stderr, "bench_prepare: %s: the starter exited with %d, see %s/starter.log\n",
+                    scenario.name.c_str(), run.status, setup.directory.c_str());
+            return false;
+        }
+        scenario.runs.push_back(run);
+    }
+    removeRegions(setup, scenario.regions);
+    return true;
+}
+
+/* JSON output */
+// the separator goes before the entry, a failed scenario then leaves no dangling ","
+static void writeScenario(FILE *out, const Scenario &scenario, bool first) {
+    std::vector<double> millis;
+    long peakRssKb = 0;
+    for (auto &run : scenario.runs) {
+        millis.push_back(run.millis);
+        peakRssKb = std::max(peakRssKb, run.peakRssKb);
+    }
+    fprintf(out, "%s    {\"scenario\": \"%s\", \"regions\": %d, \"runs\": %zu, \"eviction\": \"%s\", "
+                 "\"p50Ms\": %.3f, \"p99Ms\": %.3f, \"minMs\": %.3f, \"maxMs\": %.3f, "
+                 "\"syscalls\": %lld, \"peakRssKb\": %ld}",
+            first ? "" : ",\n", scenario.name.c_str(), scenario.regions, scenario.runs.size(), scenario.eviction,
+            percentile(millis, 0.5), percentile(millis, 0.99), percentile(millis, 0),
+            percentile(millis, 1), scenario.syscalls, peakRssKb);
+}
+
+int main(int argc, char *argv[]) {
+    Setup setup;
+    setup.starter = APPFRAME_STARTER;
+    setup.warBytes = 64 * 1024 * 1024;
+    setup.regions = 8;
+    setup.port = 47000;
+    std::string directory = "/tmp";
+    std::string output;
+    int iterations = 20;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--war-size" && i + 1 < argc) {
+            setup.warBytes = (size_t) atoll(argv[++i]) * 1024 * 1024;
+        } else if (arg == "--iterations" && i + 1 < argc) {
+            iterations = atoi(argv[++i]);
+        } else if (arg == "--regions" && i + 1 < argc) {
+            setup.regions = atoi(argv[++i]);
+        } else if (arg == "--port" && i + 1 < argc) {
+            setup.port = atoi(argv[++i]);
+        } else if (arg == "--dir" && i + 1 < argc) {
+            directory = argv[++i];
+        } else if (arg == "--starter" && i + 1 < argc) {
+            setup.starter = argv[++i];
+        } else if (arg == "--output" && i + 1 < argc) {
+            output = argv[++i];
+        } else {
+            fprintf(stderr, "usage: bench_prepare [--war-size MB] [--iterations N] [--regions N] [--port BASE] "
+                    "[--dir DIR] [--starter PATH] [--output FILE]\n");
+            return 1;
+        }
+    }
+    if (iterations < 1 || setup.regions < 1 || access(setup.starter.c_str(), X_OK) != 0) {
+        fprintf(stderr, "bench_prepare: iterations and regions must be positive, the starter executable.[%s]\n",
+                setup.starter.c_str());
+        return 1;
+    }
+
+    char buffer[64];
+    snprintf(buffer, sizeof(buffer), "/bench_prepare_%d", (int) getpid());
+    setup.directory = directory + buffer;
+    setup.war = setup.directory + "/app.war";
+    if (!createSetup(setup)) {
+        removeTree(setup.directory);
+        return 1;
+    }
+
+    FILE *out = output.empty() ? stdout : fopen(output.c_str(), "w");
+    if (out == nullptr) {
+        fprintf(stderr, "bench_prepare: create output failed.[%s]\n", output.c_str());
+        removeTree(setup.directory);
+        return 1;
+    }
+
+    std::vector<Scenario> scenarios = {
+            {"cold", 1, "none", {}, -1},
+            {"warm", 1, "none", {}, -1},
+            {"changed-war", 1, "none", {}, -1},
+            {"regions", setup.regions, "none", {}, -1}
+    };
+    const Preparation preparations[] = {COLD, WARM, CHANGED_WAR, FRESH};
+    bool success = true;
+    fprintf(out, "{\n  \"benchmark\": \"prepare\",\n  \"warBytes\": %zu,\n  \"results\": [\n", setup.warBytes);
+    for (size_t s = 0; s < scenarios.size() && success; s++) {
+        success = runScenario(setup, scenarios[s], preparations[s], iterations);
+        if (success) {
+            writeScenario(out, scenarios[s], s == 0);
+            fflush(out);
+        }
+    }
+    fprintf(out, "\n  ],\n  \"success\": %s\n}\n", success ? "true" : "false");
+
+    if (out != stdout) {
+        fclose(out);
+    }
+    removeTree(setup.directory);
+    return success ? 0 : 2;
+}
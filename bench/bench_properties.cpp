@@ -0,0 +1,456 @@
+//
+// Created by arsia on 2026/10/19.
+//
+// Benchmark and stress suite for lib_properties.
+//
+// bench_properties [--sizes 10,1000,...] [--threads N] [--dir /tmp] [--output result.json]
+//
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <new>
+#include <string>
+#include <thread>
+#include <vector>
+#if defined(UNIX) || defined(LINUX)
+#include <sys/resource.h>
+#endif
+#include "Properties.h"
+#include "ConcurrentProperties.h"
+#include "Logger.h"
+
+/* allocation counters */
+static std::atomic<long long> allocationCount(0);
+static std::atomic<long long> allocationBytes(0);
+
+void *operator new(size_t size) {
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+    allocationBytes.fetch_add((long long) size, std::memory_order_relaxed);
+    void *ptr = malloc(size == 0 ? 1 : size);
+    if (ptr == nullptr) {
+        throw std::bad_alloc();
+    }
+    return ptr;
+}
+
+void *operator new[](size_t size) {
+    return operator new(size);
+}
+
+void operator delete(void *ptr) noexcept {
+    free(ptr);
+}
+
+void operator delete[](void *ptr) noexcept {
+    free(ptr);
+}
+
+void operator delete(void *ptr, size_t) noexcept {
+    free(ptr);
+}
+
+void operator delete[](void *ptr, size_t) noexcept {
+    free(ptr);
+}
+
+/* measurement */
+struct Measure {
+    const char *name;
+    double seconds;
+    long long operations;
+    long long allocations;
+    long long allocatedBytes;
+    long baselineRssKb;
+    long peakRssKb;
+};
+
+static long statusValueKb(const char *field) {
+    FILE *file = fopen("/proc/self/status", "r");
+    if (file == nullptr) {
+        return -1;
+    }
+    char line[256];
+    long value = -1;
+    size_t length = strlen(field);
+    while (fgets(line, sizeof(line), file) != nullptr) {
+        if (0 == strncmp(line, field, length) && line[length] == ':') {
+            value = atol(line + length + 1);
+            break;
+        }
+    }
+    fclose(file);
+    return value;
+}
+
+class Stopwatch
+{
+public:
+    explicit Stopwatch(const char *name) {
+        measure.name = name;
+        // reset the peak RSS (VmHWM) so each scenario reports its own peak
+        FILE *file = fopen("/proc/self/clear_refs", "w");
+        if (file != nullptr) {
+            fputs("5", file);
+            fclose(file);
+        }
+        measure.baselineRssKb = statusValueKb("VmRSS");
+        allocations = allocationCount.load();
+        bytes = allocationBytes.load();
+        begin = std::chrono::steady_clock::now();
+    }
+
+    Measure stop(long long operations) {
+        auto end = std::chrono::steady_clock::now();
+        measure.seconds = std::chrono::duration<double>(end - begin).count();
+        measure.operations = operations;
+        measure.allocations = allocationCount.load() - allocations;
+        measure.allocatedBytes = allocationBytes.load() - bytes;
+        measure.peakRssKb = statusValueKb("VmHWM");
+#if defined(UNIX) || defined(LINUX)
+        if (measure.peakRssKb < 0) {
+            struct rusage usage{};
+            getrusage(RUSAGE_SELF, &usage);
+            measure.peakRssKb = usage.ru_maxrss;
+        }
+#endif
+        return measure;
+    }
+
+private:
+    Measure measure{};
+    long long allocations;
+    long long bytes;
+    std::chrono::steady_clock::time_point begin;
+};
+
+/* synthetic configuration */
+struct Dataset {
+    std::string path;
+    bool crlf;
+    size_t fileBytes;
+    std::vector<std::string> keys;
+    std::vector<std::string> values;
+};
+
+static std::string makeValue(size_t index) {
+    char buffer[64];
+    snprintf(buffer, sizeof(buffer), "value-%zu-%08zx", index, index * 2654435761u);
+    std::string value = buffer;
+    // every 50th value is long, well past Properties::PROPERTY_MAX_SIZE
+    if (index % 50 == 0) {
+        value.append(1024 + (index % 7) * 300, 'x');
+        value.append("-end");
+    }
+    return value;
+}
+
+static bool generate(Dataset &dataset, size_t keyCount) {
+    const char *lineEnd = dataset.crlf ? "\r\n" : "\n";
+    FILE *file = fopen(dataset.path.c_str(), "wb");
+    if (file == nullptr) {
+        fprintf(stderr, "bench_properties: create file failed.[%s]\n", dataset.path.c_str());
+        return false;
+    }
+    static char buffer[1 << 16];
+    setvbuf(file, buffer, _IOFBF, sizeof(buffer));
+
+    dataset.keys.clear();
+    dataset.values.clear();
+    dataset.keys.reserve(keyCount);
+    dataset.values.reserve(keyCount);
+
+    char key[64];
+    for (size_t i = 0; i < keyCount; i++) {
+        if (i % 10 == 0) {
+            fprintf(file, "# region %zu settings%s", i % 64, lineEnd);
+        }
+        snprintf(key, sizeof(key), "region%zu.key.%zu", i % 64, i);
+        dataset.keys.emplace_back(key);
+        dataset.values.push_back(makeValue(i));
+        // alternate the spacing around '=' and add trailing comments
+        if (i % 3 == 0) {
+            fprintf(file, "%s = %s%s", key, dataset.values.back().c_str(), lineEnd);
+        } else if (i % 3 == 1) {
+            fprintf(file, "%s=%s  # trailing%s", key, dataset.values.back().c_str(), lineEnd);
+        } else {
+            fprintf(file, "  %s\t=\t%s%s", key, dataset.values.back().c_str(), lineEnd);
+        }
+    }
+    dataset.fileBytes = (size_t) ftell(file);
+    fclose(file);
+    return true;
+}
+
+static bool verify(Properties &properties, const Dataset &dataset, const char *stage) {
+    if (properties.size() != (int) dataset.keys.size()) {
+        fprintf(stderr, "bench_properties: %s: size %d, expect %zu\n", stage, properties.size(), dataset.keys.size());
+        return false;
+    }
+    for (size_t i = 0; i < dataset.keys.size(); i++) {
+        const char *value = properties.get(dataset.keys[i].c_str());
+        if (value == nullptr || dataset.values[i] != value) {
+            fprintf(stderr, "bench_properties: %s: mismatch at %s\n", stage, dataset.keys[i].c_str());
+            return false;
+        }
+    }
+    return true;
+}
+
+/* JSON output */
+static void writeMeasure(FILE *out, const Measure &measure, bool last) {
+    double perSecond = measure.seconds > 0 ? (double) measure.operations / measure.seconds : 0;
+    fprintf(out, "        \"%s\": {\"seconds\": %.9f, \"operations\": %lld, \"opsPerSecond\": %.1f, "
+                 "\"allocations\": %lld, \"allocatedBytes\": %lld, \"baselineRssKb\": %ld, \"peakRssKb\": %ld}%s\n",
+            measure.name, measure.seconds, measure.operations, perSecond,
+            measure.allocations, measure.allocatedBytes, measure.baselineRssKb, measure.peakRssKb,
+            last ? "" : ",");
+}
+
+static std::vector<size_t> parseSizes(const char *str) {
+    std::vector<size_t> sizes;
+    while (*str != '\0') {
+        char *end;
+        unsigned long long size = strtoull(str, &end, 10);
+        if (end == str) {
+            break;
+        }
+        sizes.push_back((size_t) size);
+        str = *end == ',' ? end + 1 : end;
+    }
+    return sizes;
+}
+
+static double concurrentGet(ConcurrentProperties &properties, const Dataset &dataset, int threadCount) {
+    std::atomic<bool> stop(false);
+    std::atomic<long long> total(0);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < threadCount; t++) {
+        threads.emplace_back([&properties, &dataset, &stop, &total, t]() {
+            long long count = 0;
+            size_t index = (size_t) t * 7919;
+            while (!stop.load(std::memory_order_relaxed)) {
+                for (int i = 0; i < 256; i++) {
+                    ConcurrentProperties::ReadGuard guard(properties);
+                    if (guard.get(dataset.keys[index % dataset.keys.size()].c_str()) != nullptr) {
+                        count++;
+                    }
+                    index += 31;
+                }
+            }
+            total.fetch_add(count);
+        });
+    }
+
+    auto begin = std::chrono::steady_clock::now();
+    std::this_thread::sleep_for(std::chrono::milliseconds(300));
+    stop.store(true);
+    for (auto &thread : threads) {
+        thread.join();
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+    return (double) total.load() / seconds;
+}
+
+int main(int argc, char *argv[]) {
+    // diagnostics, also those of Properties, must not mix with the JSON on stdout
+    logStream = &std::cerr;
+    std::vector<size_t> sizes = {10, 1000, 10000, 100000, 1000000};
+    std::string directory = "/tmp";
+    std::string output;
+    int maxThreads = (int) std::thread::hardware_concurrency();
+    if (maxThreads < 4) {
+        maxThreads = 4;
+    }
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--sizes" && i + 1 < argc) {
+            sizes = parseSizes(argv[++i]);
+        } else if (arg == "--threads" && i + 1 < argc) {
+            maxThreads = atoi(argv[++i]);
+        } else if (arg == "--dir" && i + 1 < argc) {
+            directory = argv[++i];
+        } else if (arg == "--output" && i + 1 < argc) {
+            output = argv[++i];
+        } else {
+            printf("usage: bench_properties [--sizes 10,1000,...] [--threads N] [--dir DIR] [--output FILE]\n");
+            return 1;
+        }
+    }
+
+    FILE *out = output.empty() ? stdout : fopen(output.c_str(), "w");
+    if (out == nullptr) {
+        fprintf(stderr, "bench_properties: create output failed.[%s]\n", output.c_str());
+        return 1;
+    }
+
+    bool success = true;
+    std::string largest;
+    Dataset concurrentDataset;
+
+    fprintf(out, "{\n  \"benchmark\": \"properties\",\n  \"results\": [\n");
+    for (size_t s = 0; s < sizes.size(); s++) {
+        for (int crlf = 0; crlf < 2; crlf++) {
+            Dataset dataset;
+            dataset.crlf = crlf == 1;
+            dataset.path = directory + "/bench_properties_" + std::to_string(sizes[s]) +
+                           (dataset.crlf ? "_crlf" : "_lf") + ".conf";
+            if (!generate(dataset, sizes[s])) {
+                return 1;
+            }
+            std::string savePath = dataset.path + ".saved";
+            std::string snapshotPath = dataset.path + ".snapshot";
+            remove(snapshotPath.c_str());
+
+            std::vector<std::string> missKeys;
+            missKeys.reserve(dataset.keys.size());
+            for (auto &key : dataset.keys) {
+                missKeys.push_back("missing." + key);
+            }
+            std::vector<std::string> newValues;
+            newValues.reserve(dataset.keys.size());
+            for (size_t i = 0; i < dataset.keys.size(); i++) {
+                newValues.push_back(makeValue(i + 1));
+            }
+
+            std::vector<Measure> measures;
+            bool roundTrip;
+
+            // load
+            auto *properties = new Properties();
+            Stopwatch loadWatch("load");
+            properties->load(dataset.path.c_str());
+            measures.push_back(loadWatch.stop((long long) dataset.keys.size()));
+            roundTrip = verify(*properties, dataset, "load");
+
+            // get hit / miss
+            Stopwatch hitWatch("getHit");
+            long long found = 0;
+            for (auto &key : dataset.keys) {
+                found += properties->get(key.c_str()) != nullptr;
+            }
+            measures.push_back(hitWatch.stop((long long) dataset.keys.size()));
+
+            Stopwatch missWatch("getMiss");
+            for (auto &key : missKeys) {
+                found += properties->get(key.c_str()) != nullptr;
+            }
+            measures.push_back(missWatch.stop((long long) missKeys.size()));
+            roundTrip = roundTrip && found == (long long) dataset.keys.size();
+
+            // save, then reload the saved file
+            Stopwatch saveWatch("save");
+            properties->save(savePath.c_str());
+            measures.push_back(saveWatch.stop((long long) dataset.keys.size()));
+            {
+                Properties saved(savePath.c_str());
+                roundTrip = roundTrip && verify(saved, dataset, "save");
+            }
+
+            // layout preserving save after a one key change
+            properties->set(dataset.keys[0].c_str(), newValues[0].c_str());
+            Stopwatch layoutWatch("saveLayout");
+            properties->save(savePath.c_str(), true);
+            measures.push_back(layoutWatch.stop(1));
+            {
+                Properties saved(savePath.c_str());
+                const char *value = saved.get(dataset.keys[0].c_str());
+                roundTrip = roundTrip && value != nullptr && newValues[0] == value &&
+                            saved.size() == (int) dataset.keys.size();
+                if (dataset.keys.size() > 1) {
+                    value = saved.get(dataset.keys.back().c_str());
+                    roundTrip = roundTrip && value != nullptr && dataset.values.back() == value;
+                }
+            }
+
+            // set: update the first half, insert as many new keys
+            size_t half = dataset.keys.size() / 2;
+            Stopwatch setWatch("set");
+            for (size_t i = 0; i < half; i++) {
+                properties->set(dataset.keys[i].c_str(), newValues[i].c_str());
+            }
+            for (size_t i = 0; i < dataset.keys.size() - half; i++) {
+                properties->set(missKeys[i].c_str(), newValues[i].c_str());
+            }
+            measures.push_back(setWatch.stop((long long) dataset.keys.size()));
+            for (size_t i = 0; roundTrip && i < half; i++) {
+                const char *value = properties->get(dataset.keys[i].c_str());
+                roundTrip = value != nullptr && newValues[i] == value;
+            }
+
+            // remove every original key
+            Stopwatch removeWatch("remove");
+            for (auto &key : dataset.keys) {
+                properties->remove(key.c_str());
+            }
+            measures.push_back(removeWatch.stop((long long) dataset.keys.size()));
+            roundTrip = roundTrip && properties->size() == (int) (dataset.keys.size() - half) &&
+                        properties->get(dataset.keys[0].c_str()) == nullptr;
+            delete properties;
+
+            // compiled snapshot: first load compiles, second one maps
+            {
+                Properties compile;
+                Stopwatch compileWatch("snapshotCompile");
+                compile.loadSnapshot(dataset.path.c_str(), snapshotPath.c_str());
+                measures.push_back(compileWatch.stop((long long) dataset.keys.size()));
+            }
+            {
+                Properties mapped;
+                Stopwatch mapWatch("snapshotLoad");
+                mapped.loadSnapshot(dataset.path.c_str(), snapshotPath.c_str());
+                measures.push_back(mapWatch.stop((long long) dataset.keys.size()));
+                roundTrip = roundTrip && verify(mapped, dataset, "snapshot");
+            }
+
+            success = success && roundTrip;
+            fprintf(out, "    {\n      \"keys\": %zu,\n      \"lineEnding\": \"%s\",\n      \"fileBytes\": %zu,\n"
+                         "      \"roundTrip\": %s,\n      \"operations\": {\n",
+                    dataset.keys.size(), dataset.crlf ? "CRLF" : "LF", dataset.fileBytes,
+                    roundTrip ? "true" : "false");
+            for (size_t m = 0; m < measures.size(); m++) {
+                writeMeasure(out, measures[m], m + 1 == measures.size());
+            }
+            bool last = s + 1 == sizes.size() && crlf == 1;
+            fprintf(out, "      }\n    }%s\n", last ? "" : ",");
+            fflush(out);
+
+            remove(savePath.c_str());
+            remove(snapshotPath.c_str());
+            if (!dataset.crlf && dataset.keys.size() <= 100000 &&
+                dataset.keys.size() >= concurrentDataset.keys.size()) {
+                if (!largest.empty()) {
+                    remove(largest.c_str());
+                }
+                largest = dataset.path;
+                concurrentDataset = dataset;
+            } else {
+                remove(dataset.path.c_str());
+            }
+        }
+    }
+    fprintf(out, "  ],\n  \"concurrentGet\": [");
+
+    // read scaling of ConcurrentProperties
+    if (!concurrentDataset.keys.empty()) {
+        ConcurrentProperties concurrent(concurrentDataset.path.c_str());
+        bool first = true;
+        for (int threads = 1; threads <= maxThreads; threads *= 2) {
+            double perSecond = concurrentGet(concurrent, concurrentDataset, threads);
+            fprintf(out, "%s\n    {\"keys\": %zu, \"threads\": %d, \"opsPerSecond\": %.1f}",
+                    first ? "" : ",", concurrentDataset.keys.size(), threads, perSecond);
+            first = false;
+        }
+        remove(concurrentDataset.path.c_str());
+    }
+    fprintf(out, "\n  ],\n  \"success\": %s\n}\n", success ? "true" : "false");
+
+    if (out != stdout) {
+        fclose(out);
+    }
+    return success ? 0 : 2;
+}
@@ -5,21 +5,125 @@
 #ifndef APPFRAME_STARTER_COMMON_H
 #define APPFRAME_STARTER_COMMON_H
 
+#include <algorithm>
 #include <cctype>
+#include <map>
+#include <mutex>
 #include <string>
+#include <vector>
+#include <cstring>
 #include <iostream>
 #include <cstdio>
 #include <sys/stat.h>
-#include <direct.h>
 #include "md5.h"
+#include "Logger.h"
+#include "Metrics.h"
+#include "Template.h"
+#include "Trace.h"
 
+#if !defined(WINDOWS) && !defined(UNIX) && !defined(LINUX)
 #define WINDOWS
+#endif
+
+#if defined(WINDOWS)
+#include <direct.h>
+#include <io.h>
+#elif defined(UNIX) || defined(LINUX)
+#include <dirent.h>
+#endif
 #define MD5_BUFFER_SIZE 1024
+#define COPY_BUFFER_SIZE (256 * 1024)
 #define MD5_VALUE_SIZE 16
 #define MD5_STRING_SIZE 32
 
 bool enableDebug = true;
 
+// --plan: 只打印会执行的操作, 不修改文件
+bool planOnly = false;
+
+/**
+ * 区域准备阶段
+ */
+enum PreparePhase {
+    PREPARE_TOTAL,
+    PREPARE_MANIFEST,
+    PREPARE_DIRECTORIES,
+    PREPARE_CONF,
+    PREPARE_WAR,
+    PREPARE_CDS,
+    PREPARE_PHASE_NUMBER
+};
+
+const char *PREPARE_PHASES[] = {
+        "total",
+        "manifest",
+        "directories",
+        "conf",
+        "war",
+        "cds"
+};
+
+/**
+ * 区域的指标, 未启用 common.metrics.listen 时区域没有指标
+ */
+struct RegionMetrics {
+    Metrics::Value *prepareSeconds[PREPARE_PHASE_NUMBER];
+    Metrics::Value *upToDate;
+    Metrics::Value *bytesHashed;
+    Metrics::Value *bytesCopied;
+    Metrics::Value *digestCacheHits;
+    Metrics::Value *digestCacheMisses;
+    Metrics::Value *spawns;
+    Metrics::Value *restarts;
+    Metrics::Value *exits;
+    Metrics::Value *lastExitStatus;
+    Metrics::Value *uptime;
+    Metrics::Value *logsCompressed;
+    Metrics::Value *logsRotated;
+    Metrics::Value *logsDeleted;
+    Metrics::Value *logsBytesRead;
+    Metrics::Value *logsBytesWritten;
+    Metrics::Value *logsCompressSeconds;
+    Metrics::Value *logsBytesReclaimed;
+};
+
+// 当前线程正在准备的区域的指标
+thread_local RegionMetrics *currentMetrics = nullptr;
+
+#define METRICS_COUNT(field, delta) \
+    do { if (currentMetrics != nullptr) Metrics::count(currentMetrics->field, delta); } while (0)
+
+/**
+ * 当前区域的准备阶段耗时指标
+ *
+ * @param phase 阶段
+ * @return 指标, 没有指标时为 nullptr
+ */
+Metrics::Value *preparePhaseMetric(PreparePhase phase) {
+    return currentMetrics != nullptr ? currentMetrics->prepareSeconds[phase] : nullptr;
+}
+
+/**
+ * 设置当前线程的区域指标, 析构时恢复
+ */
+class RegionMetricsScope
+{
+public:
+    explicit RegionMetricsScope(RegionMetrics *metrics) : previous(currentMetrics) {
+        currentMetrics = metrics;
+    }
+
+    ~RegionMetricsScope() {
+        currentMetrics = previous;
+    }
+
+    RegionMetricsScope(const RegionMetricsScope &other) = delete;
+    RegionMetricsScope &operator=(const RegionMetricsScope &other) = delete;
+
+private:
+    RegionMetrics *previous;
+};
+
 /**
  * 是否为空白
  *
@@ -58,18 +162,18 @@ std::string convent2string(const char *value) {
  * @param endLine 是否换行
  */
 void printKeyValue(const char *key, const std::string &value, bool endLine = true) {
-    std::cout << "[INFO ] " << key << ": ";
+    logger() << "[INFO ] " << key << ": ";
 
     if (value.empty()) {
-        std::cout << "\"\"";
+        logger() << "\"\"";
     } else {
-        std::cout << value;
+        logger() << value;
     }
 
     if (endLine) {
-        std::cout << std::endl;
+        logger() << std::endl;
     } else {
-        std::cout << "; ";
+        logger() << "; ";
     }
 }
 
@@ -107,14 +211,23 @@ bool isDirectory(const std::string &path) {
  */
 bool checkDirectory(const std::string &path) {
     if (enableDebug) {
-        std::cout << "[Debug] check directory: " << path << std::endl;
+        logger() << "[Debug] check directory: " << path << std::endl;
     }
     if (!fileExist(path)) {
+        if (planOnly) {
+            logger() << "[PLAN ] mkdir " << path << std::endl;
+            return true;
+        }
         if (enableDebug) {
-            std::cout << "[Debug] directory not exist, try create: " << path << std::endl;
+            logger() << "[Debug] directory not exist, try create: " << path << std::endl;
         }
-        if (-1 == mkdir(path.c_str())) {
-            std::cout << "[Error] create folder failed: " << path << std::endl;
+#if defined(WINDOWS)
+        int ret = mkdir(path.c_str());
+#elif defined(UNIX) || defined(LINUX)
+        int ret = mkdir(path.c_str(), 0755);
+#endif
+        if (-1 == ret) {
+            logger() << "[Error] create folder failed: " << path << std::endl;
             return false;
         }
     }
@@ -122,57 +235,82 @@ bool checkDirectory(const std::string &path) {
 }
 
 /**
- * 获取文件大小
+ * 读取文本文件
  *
- * @param file 文件
- * @return 文件大小
+ * @param path 文件路径
+ * @param content 文件内容
+ * @return 是否成功
  */
-size_t fileSize(FILE *file) {
+bool readTextFile(const std::string &path, std::string &content) {
+    FILE *file = fopen(path.c_str(), "rb");
     if (file == nullptr) {
-        return -1;
+        logger() << "[ERROR] open file failed: " << path << std::endl;
+        return false;
     }
-
-    long locationCache;
-    size_t size;
-
-    locationCache = ftell(file);
-    fseek(file, 0, SEEK_END);
-    size = ftell(file);
-    fseek(file, locationCache, SEEK_SET);
-    return size;
+    content.clear();
+    char buffer[4096];
+    size_t readCount;
+    while ((readCount = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+        content.append(buffer, readCount);
+    }
+    fclose(file);
+    return true;
 }
 
 /**
- * 复制文件
+ * 复制文件, 通过固定大小的缓冲区读写
  *
  * @param src 源文件
  * @param dest 目标文件
  * @return 是否成功
  */
 bool copyFile(const std::string &src, const std::string &dest) {
+    if (planOnly) {
+        logger() << "[PLAN ] copy " << src << " -> " << dest << std::endl;
+        return true;
+    }
+    TRACE_SCOPE("copy");
     if (enableDebug) {
-        std::cout << "[Debug] copy " << src << " to " << dest << std::endl;
+        logger() << "[Debug] copy " << src << " to " << dest << std::endl;
     }
     FILE *srcFile = fopen(src.c_str(), "rb");
     if (srcFile == nullptr) {
-        std::cout << "[Error] file not exist: " << src << std::endl;
+        logger() << "[Error] file not exist: " << src << std::endl;
         return false;
     }
     FILE *destFile = fopen(dest.c_str(), "wb");
     if (destFile == nullptr) {
-        std::cout << "[Error] create file failed: " << dest << std::endl;
+        logger() << "[Error] create file failed: " << dest << std::endl;
+        fclose(srcFile);
         return false;
     }
 
-    size_t size = fileSize(srcFile);
-    char *buffer = new char[size + 1];
-
-    fread(buffer, 1, size, srcFile);
-    fwrite(buffer, 1, size, destFile);
-
+    std::vector<char> buffer(COPY_BUFFER_SIZE);
+    long long copied = 0;
+    bool success = true;
+    size_t readCount;
+    while ((readCount = fread(buffer.data(), 1, buffer.size(), srcFile)) > 0) {
+        size_t written = fwrite(buffer.data(), 1, readCount, destFile);
+        copied += (long long) written;
+        if (written != readCount) {
+            logger() << "[Error] write file failed: " << dest << std::endl;
+            success = false;
+            break;
+        }
+    }
+    if (success && ferror(srcFile)) {
+        logger() << "[Error] read file failed: " << src << std::endl;
+        success = false;
+    }
     fclose(srcFile);
-    fclose(destFile);
-    return true;
+    // 关闭时写入缓冲区中剩余的数据
+    if (0 != fclose(destFile) && success) {
+        logger() << "[Error] write file failed: " << dest << std::endl;
+        success = false;
+    }
+    TRACE_COUNT("bytes copied", copied);
+    METRICS_COUNT(bytesCopied, copied);
+    return success;
 }
 
 /**
@@ -183,23 +321,26 @@ bool copyFile(const std::string &src, const std::string &dest) {
  * @return 是否成功
  */
 bool fileMd5(const std::string &path, char *md5Str) {
+    TRACE_SCOPE("hash");
     unsigned char buffer[MD5_BUFFER_SIZE];
     unsigned char md5Value[MD5_VALUE_SIZE];
     MD5_CTX md5;
 
     FILE *file = fopen(path.c_str(), "rb");
     if (file == nullptr) {
-        std::cout << "[Error] MD5: open file failed[" << path << "]." << std::endl;
+        logger() << "[Error] MD5: open file failed[" << path << "]." << std::endl;
         return false;
     }
 
     MD5Init(&md5);
 
     unsigned long readCount;
+    long long hashed = 0;
     while (true) {
         readCount = fread(buffer, 1, MD5_BUFFER_SIZE, file);
+        hashed += (long long) readCount;
         if (-1 == readCount) {
-            std::cout << "[Error] MD5: read file failed[" << path << "]." << std::endl;
+            logger() << "[Error] MD5: read file failed[" << path << "]." << std::endl;
             return false;
         }
 
@@ -210,6 +351,8 @@ bool fileMd5(const std::string &path, char *md5Str) {
         }
     }
     fclose(file);
+    TRACE_COUNT("bytes hashed", hashed);
+    METRICS_COUNT(bytesHashed, hashed);
     MD5Final(&md5, md5Value);
     for (int i = 0; i < MD5_VALUE_SIZE; i++) {
         snprintf(md5Str + i * 2, 2 + 1, "%02x", md5Value[i]);
@@ -255,76 +398,346 @@ bool sameFile(const std::string &fileA, const std::string &fileB) {
 }
 
 /**
- * 生成 server.xml
+ * 文件大小和修改时间, 用于判断文件是否被替换
+ *
+ * @param path 文件路径
+ * @param stamp 大小:修改时间, 文件不存在时为空
+ * @return 文件是否存在
+ */
+bool fileStamp(const std::string &path, std::string &stamp) {
+    struct stat status{};
+    if (0 != stat(path.c_str(), &status)) {
+        stamp.clear();
+        return false;
+    }
+#if defined(UNIX) || defined(LINUX)
+    long long mtime = (long long) status.st_mtim.tv_sec * 1000000000LL + status.st_mtim.tv_nsec;
+#else
+    long long mtime = (long long) status.st_mtime;
+#endif
+    stamp = std::to_string((long long) status.st_size) + ":" + std::to_string(mtime);
+    return true;
+}
+
+struct DigestEntry {
+    std::string stamp;
+    char md5[MD5_STRING_SIZE + 1];
+};
+
+// 源文件摘要缓存, 多个区域共享同一个 Tomcat conf 和 war 包时只计算一次
+std::map<std::string, DigestEntry> digestCache;
+std::mutex digestMutex;
+
+/**
+ * 记录已知的文件MD5, 例如 manifest 中记录的摘要
+ *
+ * @param path 文件路径
+ * @param stamp 计算摘要时的大小:修改时间
+ * @param md5Str MD5
+ */
+void rememberFileMd5(const std::string &path, const std::string &stamp, const char *md5Str) {
+    if (stamp.empty() || strlen(md5Str) != MD5_STRING_SIZE) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(digestMutex);
+    DigestEntry &entry = digestCache[path];
+    entry.stamp = stamp;
+    memcpy(entry.md5, md5Str, MD5_STRING_SIZE + 1);
+}
+
+/**
+ * 计算文件MD5, 文件大小和修改时间不变时使用缓存
+ *
+ * @param path 文件路径
+ * @param md5Str MD5
+ * @return 是否成功
+ */
+bool cachedFileMd5(const std::string &path, char *md5Str) {
+    std::string stamp;
+    if (!fileStamp(path, stamp)) {
+        return fileMd5(path, md5Str);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(digestMutex);
+        auto found = digestCache.find(path);
+        if (found != digestCache.end() && found->second.stamp == stamp) {
+            memcpy(md5Str, found->second.md5, MD5_STRING_SIZE + 1);
+            TRACE_COUNT("digest cache hits", 1);
+            METRICS_COUNT(digestCacheHits, 1);
+            return true;
+        }
+    }
+
+    METRICS_COUNT(digestCacheMisses, 1);
+    if (!fileMd5(path, md5Str)) {
+        return false;
+    }
+    rememberFileMd5(path, stamp, md5Str);
+    return true;
+}
+
+/**
+ * 目标文件是否与源文件相同, 源文件摘要使用缓存
  *
- * @param catlinaHome tomcat位置
- * @param shutdownPort 关闭端口
- * @param httpPort http端口
- * @return
+ * @param source 源文件路径
+ * @param target 目标文件路径
+ * @param sourceMd5 源文件md5
+ * @param targetMd5 目标文件md5
+ * @return 是否相同
  */
-std::string generateServerXml(const std::string &catalinaHome,
-                              const std::string &shutdownPort,
-                              const std::string &httpPort) {
-    return "<Server port=\"" + shutdownPort + "\" shutdown=\"SHUTDOWN\">\n" +
-           "  <Listener className=\"org.apache.catalina.startup.VersionLoggerListener\" />\n" +
-           "  <Listener className=\"org.apache.catalina.core.AprLifecycleListener\" SSLEngine=\"on\" />\n" +
-           "  <Listener className=\"org.apache.catalina.core.JreMemoryLeakPreventionListener\" />\n" +
-           "  <Listener className=\"org.apache.catalina.mbeans.GlobalResourcesLifecycleListener\" />\n" +
-           "  <Listener className=\"org.apache.catalina.core.ThreadLocalLeakPreventionListener\" />\n" +
-           "  <GlobalNamingResources>\n" +
-           "    <Resource name=\"UserDatabase\" auth=\"Container\" \n" +
-           "      type=\"org.apache.catalina.UserDatabase\" \n" +
-           "      description=\"User database that can be updated and saved\" \n" +
-           "      factory=\"org.apache.catalina.users.MemoryUserDatabaseFactory\" \n" +
-           "      pathname=\"conf/tomcat-users.xml\" />\n" +
-           "  </GlobalNamingResources>\n" +
-           "  <Service name=\"Catalina\">\n" +
-           "    <Connector port=\"" + httpPort +
-           "\" protocol=\"HTTP/1.1\" connectionTimeout=\"20000\" redirectPort=\"8443\" />\n" +
-           "    <Engine name=\"Catalina\" defaultHost=\"localhost\">\n" +
-           "      <Realm className=\"org.apache.catalina.realm.LockOutRealm\">\n" +
-           "        <Realm className=\"org.apache.catalina.realm.UserDatabaseRealm\" resourceName=\"UserDatabase\" />\n" +
-           "      </Realm>\n" +
-           R"(      <Host name="localhost" appBase=")" + catalinaHome + "\" \n" +
-           "        unpackWARs=\"true\" autoDeploy=\"true\" deployOnStartup=\"false\" deployIgnore=\"^(?!(manager)|(tomee)$).*\">\n" +
-           "        <Valve className=\"org.apache.catalina.valves.AccessLogValve\" \n" +
-           "          directory=\"logs\" prefix=\"localhost_access_log\" \n" +
-           "          suffix=\".txt\" pattern=\"%h %l %u %t &quot;%r&quot; %s %b\" />\n" +
-           R"(         <Context path="/appframe-web" docBase=")" + catalinaHome +
-           "/appframe.war\" reloadable=\"true\"/>\n" +
-           "      </Host>\n" +
-           "    </Engine>\n" +
-           "  </Service>\n" +
-           "</Server>";
+bool sameAsSource(const std::string &source,
+                  const std::string &target,
+                  char *sourceMd5,
+                  char *targetMd5) {
+    if (!cachedFileMd5(source, sourceMd5)) {
+        return false;
+    }
+
+    if (!fileMd5(target, targetMd5)) {
+        return false;
+    }
+    return 0 == strcmp(sourceMd5, targetMd5);
+}
+
+/**
+ * 计算字符串MD5
+ *
+ * @param str 字符串
+ * @param md5Str MD5
+ */
+void stringMd5(const std::string &str, char *md5Str) {
+    unsigned char md5Value[MD5_VALUE_SIZE];
+    MD5_CTX md5;
+    MD5Init(&md5);
+    MD5Update(&md5, (unsigned char *) str.data(), (unsigned int) str.size());
+    MD5Final(&md5, md5Value);
+    for (int i = 0; i < MD5_VALUE_SIZE; i++) {
+        snprintf(md5Str + i * 2, 2 + 1, "%02x", md5Value[i]);
+    }
+    md5Str[MD5_STRING_SIZE] = '\0';
 }
 
-std::string generateCommand(const std::string &javaHome,
-                            const std::string &catalinaHome,
-                            const std::string &catalinaBase,
-                            const std::string &javaOpts,
-                            const std::string &bsHome) {
+/**
+ * 文件夹下指定后缀文件的名称, 大小和修改时间的MD5, 不读取文件内容
+ *
+ * @param directory 文件夹路径, 以分隔符结尾
+ * @param suffix 文件后缀
+ * @param md5Str MD5
+ * @return 是否成功
+ */
+bool directoryStamp(const std::string &directory, const char *suffix, char *md5Str) {
+    std::vector<std::string> names;
+    size_t suffixLength = strlen(suffix);
 #if defined(WINDOWS)
-    std::string cmd = "set JAVA_HOME=" + javaHome +
-                      "&set CATALINA_HOME=" + catalinaHome +
-                      "&set CATALINA_BASE=" + catalinaBase +
-                      "&set JAVA_OPTS=";
-    if (!isBlank(javaOpts)) {
-        cmd.append(javaOpts).append(" ");
-    }
-    cmd.append("-DBOSSSOFT_HOME=").append(bsHome)
-            .append("&").append(catalinaHome).append(TOMCAT_CATALINA).append(" run");
+    struct _finddata_t entry{};
+    intptr_t handle = _findfirst((directory + "*" + suffix).c_str(), &entry);
+    if (handle == -1) {
+        logger() << "[ERROR] list directory failed: " << directory << std::endl;
+        return false;
+    }
+    do {
+        names.emplace_back(entry.name);
+    } while (0 == _findnext(handle, &entry));
+    _findclose(handle);
 #elif defined(UNIX) || defined(LINUX)
-    std::string cmd = "JAVA_HOME=" + javaHome +
-                      "&CATALINA_HOME=" + catalinaHome +
-                      "&CATALINA_BASE=" + catalinaBase +
-                      "&JAVA_OPTS=";
-    if (!isBlank(javaOpts)) {
-        cmd.append(javaOpts).append(" ");
-    }
-    cmd.append("-DBOSSSOFT_HOME=").append(bsHome)
-            .append("&").append(catalinaHome).append(TOMCAT_CATALINA).append(" run");
+    DIR *dir = opendir(directory.c_str());
+    if (dir == nullptr) {
+        logger() << "[ERROR] list directory failed: " << directory << std::endl;
+        return false;
+    }
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != nullptr) {
+        size_t length = strlen(entry->d_name);
+        if (length > suffixLength && 0 == strcmp(entry->d_name + length - suffixLength, suffix)) {
+            names.emplace_back(entry->d_name);
+        }
+    }
+    closedir(dir);
 #endif
-    return cmd;
+    // readdir 的顺序与文件系统有关
+    std::sort(names.begin(), names.end());
+
+    std::string listing;
+    std::string stamp;
+    for (auto &name : names) {
+        fileStamp(directory + name, stamp);
+        listing.append(name).append("=").append(stamp).append("\n");
+    }
+
+    stringMd5(listing, md5Str);
+    return true;
+}
+
+// server.xml 模板中可用的值
+enum ServerXmlValue {
+    XML_SHUTDOWN_PORT,
+    XML_HTTP_PORT,
+    XML_HTTPS_PORT,
+    XML_HTTPS_KEYSTORE,
+    XML_HTTPS_KEYSTORE_PASSWORD,
+    XML_AJP_PORT,
+    XML_JMX_PORT,
+    XML_APP_BASE,
+    XML_WAR_PATH,
+    XML_PROTOCOL,
+    XML_HTTPS_PROTOCOL,
+    XML_EXECUTOR,
+    XML_MAX_THREADS,
+    XML_MIN_SPARE_THREADS,
+    XML_ACCEPT_COUNT,
+    XML_MAX_CONNECTIONS,
+    XML_KEEP_ALIVE_TIMEOUT,
+    XML_MAX_KEEP_ALIVE_REQUESTS,
+    XML_COMPRESSION,
+    XML_PRODUCTION,
+    SERVER_XML_VALUE_NUMBER
+};
+
+const char *SERVER_XML_VALUES[] = {
+        "shutdown.port",
+        "http.port",
+        "https.port",
+        "https.keystore",
+        "https.keystore.password",
+        "ajp.port",
+        "jmx.port",
+        "app.base",
+        "war.path",
+        "connector.protocol",
+        "https.protocol",
+        "executor",
+        "connector.maxThreads",
+        "connector.minSpareThreads",
+        "connector.acceptCount",
+        "connector.maxConnections",
+        "connector.keepAliveTimeout",
+        "connector.maxKeepAliveRequests",
+        "connector.compression",
+        "production"
+};
+
+// 默认的 server.xml 模板, HTTPS/AJP 连接器只在配置了端口时生成, JMX 端口通过 JVM 参数设置
+const char *SERVER_XML_TEMPLATE = R"(<Server port="${shutdown.port}" shutdown="SHUTDOWN">
+  <Listener className="org.apache.catalina.startup.VersionLoggerListener" />
+  <Listener className="org.apache.catalina.core.AprLifecycleListener" SSLEngine="on" />
+  <Listener className="org.apache.catalina.core.JreMemoryLeakPreventionListener" />
+  <Listener className="org.apache.catalina.mbeans.GlobalResourcesLifecycleListener" />
+  <Listener className="org.apache.catalina.core.ThreadLocalLeakPreventionListener" />
+  <GlobalNamingResources>
+    <Resource name="UserDatabase" auth="Container" 
+      type="org.apache.catalina.UserDatabase" 
+      description="User database that can be updated and saved" 
+      factory="org.apache.catalina.users.MemoryUserDatabaseFactory" 
+      pathname="conf/tomcat-users.xml" />
+  </GlobalNamingResources>
+  <Service name="Catalina">
+${#executor}    <Executor name="${executor}" namePrefix="catalina-exec-"${#connector.maxThreads} maxThreads="${connector.maxThreads}"${/connector.maxThreads}${#connector.minSpareThreads} minSpareThreads="${connector.minSpareThreads}"${/connector.minSpareThreads} />
+${/executor}    <Connector port="${http.port}" protocol="${connector.protocol}" connectionTimeout="20000" redirectPort="${#https.port}${https.port}${/https.port}${^https.port}8443${/https.port}"${#executor} executor="${executor}"${/executor}${#connector.acceptCount} acceptCount="${connector.acceptCount}"${/connector.acceptCount}${#connector.maxConnections} maxConnections="${connector.maxConnections}"${/connector.maxConnections}${#connector.keepAliveTimeout} keepAliveTimeout="${connector.keepAliveTimeout}"${/connector.keepAliveTimeout}${#connector.maxKeepAliveRequests} maxKeepAliveRequests="${connector.maxKeepAliveRequests}"${/connector.maxKeepAliveRequests}${#connector.compression} compression="${connector.compression}"${/connector.compression} />
+${#https.port}    <Connector port="${https.port}" protocol="${https.protocol}" SSLEnabled="true"${#executor} executor="${executor}"${/executor}${#connector.acceptCount} acceptCount="${connector.acceptCount}"${/connector.acceptCount}${#connector.maxConnections} maxConnections="${connector.maxConnections}"${/connector.maxConnections}${#connector.keepAliveTimeout} keepAliveTimeout="${connector.keepAliveTimeout}"${/connector.keepAliveTimeout}${#connector.maxKeepAliveRequests} maxKeepAliveRequests="${connector.maxKeepAliveRequests}"${/connector.maxKeepAliveRequests}${#connector.compression} compression="${connector.compression}"${/connector.compression}>
+      <SSLHostConfig>
+        <Certificate type="RSA"${#https.keystore} certificateKeystoreFile="${https.keystore}"${/https.keystore}${#https.keystore.password} certificateKeystorePassword="${https.keystore.password}"${/https.keystore.password} />
+      </SSLHostConfig>
+    </Connector>
+${/https.port}${#ajp.port}    <Connector protocol="AJP/1.3" address="127.0.0.1" port="${ajp.port}" redirectPort="${#https.port}${https.port}${/https.port}${^https.port}8443${/https.port}" secretRequired="false"${#executor} executor="${executor}"${/executor}${#connector.acceptCount} acceptCount="${connector.acceptCount}"${/connector.acceptCount}${#connector.maxConnections} maxConnections="${connector.maxConnections}"${/connector.maxConnections} />
+${/ajp.port}    <Engine name="Catalina" defaultHost="localhost"${#production} backgroundProcessorDelay="60"${/production}>
+      <Realm className="org.apache.catalina.realm.LockOutRealm">
+        <Realm className="org.apache.catalina.realm.UserDatabaseRealm" resourceName="UserDatabase" />
+      </Realm>
+      <Host name="localhost" appBase="${app.base}" 
+        unpackWARs="true" autoDeploy="${^production}true${/production}${#production}false${/production}" deployOnStartup="false" deployIgnore="^(?!(manager)|(tomee)$).*">
+        <Valve className="org.apache.catalina.valves.AccessLogValve" 
+          directory="logs" prefix="localhost_access_log" 
+          suffix=".txt" pattern="%h %l %u %t &quot;%r&quot; %s %b" />
+         <Context path="/appframe-web" docBase="${war.path}" reloadable="${^production}true${/production}${#production}false${/production}"${^production}/>${/production}${#production}>
+           <Resources cachingAllowed="true" cacheMaxSize="102400" cacheObjectMaxSize="2048" cacheTtl="60000" />
+         </Context>${/production}
+      </Host>
+    </Engine>
+  </Service>
+</Server>)";
+
+/**
+ * 转义 XML 属性值
+ *
+ * @param value 值
+ * @return 转义后的值
+ */
+std::string xmlEscape(const std::string &value) {
+    if (value.find_first_of("&<>\"'") == std::string::npos) {
+        return value;
+    }
+    std::string escaped;
+    for (char c : value) {
+        switch (c) {
+            case '&':
+                escaped.append("&amp;");
+                break;
+            case '<':
+                escaped.append("&lt;");
+                break;
+            case '>':
+                escaped.append("&gt;");
+                break;
+            case '"':
+                escaped.append("&quot;");
+                break;
+            case '\'':
+                escaped.append("&apos;");
+                break;
+            default:
+                escaped.push_back(c);
+        }
+    }
+    return escaped;
+}
+
+/**
+ * 生成 server.xml
+ *
+ * @param serverXml 编译后的模板
+ * @param values 模板的值, 按 ServerXmlValue 排列, 已转义
+ * @return server.xml
+ */
+std::string generateServerXml(const Template &serverXml, const std::string *values) {
+    TRACE_SCOPE("render server.xml");
+    return serverXml.render(values);
+}
+
+/**
+ * 按空白拆分参数, 单引号或双引号内的空白不拆分
+ *
+ * @param str 参数字符串
+ * @param arguments 拆分结果
+ */
+void splitArguments(const std::string &str, std::vector<std::string> &arguments) {
+    std::string current;
+    bool hasCurrent = false;
+    char quote = '\0';
+    for (char c : str) {
+        if (quote != '\0') {
+            if (c == quote) {
+                quote = '\0';
+            } else {
+                current.push_back(c);
+            }
+        } else if (c == '"' || c == '\'') {
+            quote = c;
+            hasCurrent = true;
+        } else if (isspace((unsigned char) c)) {
+            if (hasCurrent) {
+                arguments.push_back(current);
+                current.clear();
+                hasCurrent = false;
+            }
+        } else {
+            current.push_back(c);
+            hasCurrent = true;
+        }
+    }
+    if (hasCurrent) {
+        arguments.push_back(current);
+    }
 }
 
 #endif //APPFRAME_STARTER_COMMON_H
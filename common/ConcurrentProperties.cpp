@@ -0,0 +1,159 @@
+#include "ConcurrentProperties.h"
+
+#include <thread>
+
+/***********************************
+ *     ConcurrentProperties      *
+ ***********************************/
+
+/* Construct */
+ConcurrentProperties::ConcurrentProperties() : ConcurrentProperties(nullptr) {}
+
+ConcurrentProperties::ConcurrentProperties(const char *path) {
+    for (auto &reader : readers) {
+        reader.used.store(false, std::memory_order_relaxed);
+        reader.epoch.store(0, std::memory_order_relaxed);
+    }
+    globalEpoch.store(1, std::memory_order_relaxed);
+    current.store(new Properties(), std::memory_order_release);
+
+    if (path != nullptr) {
+        load(path);
+    }
+}
+
+ConcurrentProperties::~ConcurrentProperties() {
+    delete current.load(std::memory_order_acquire);
+    for (auto &item : retired) {
+        delete item.properties;
+    }
+}
+
+/* Private */
+int ConcurrentProperties::acquireSlot() {
+    // each thread keeps coming back to the slot it used last, so the slot's
+    // cache line stays local to that thread
+    static thread_local int hint = -1;
+    if (hint < 0) {
+        static std::atomic<int> nextHint(0);
+        hint = nextHint.fetch_add(1, std::memory_order_relaxed) % MAX_READERS;
+    }
+
+    while (true) {
+        for (int i = 0; i < MAX_READERS; i++) {
+            int index = (hint + i) % MAX_READERS;
+            bool expected = false;
+            if (!readers[index].used.load(std::memory_order_relaxed) &&
+                readers[index].used.compare_exchange_strong(expected, true, std::memory_order_acquire)) {
+                hint = index;
+                return index;
+            }
+        }
+        // more than MAX_READERS concurrent guards
+        std::this_thread::yield();
+    }
+}
+
+void ConcurrentProperties::publish(Properties *next) {
+    const Properties *old = current.exchange(next, std::memory_order_seq_cst);
+    unsigned long long epoch = globalEpoch.fetch_add(1, std::memory_order_seq_cst) + 1;
+    retired.push_back(Retired{old, epoch});
+    reclaim();
+}
+
+void ConcurrentProperties::reclaim() {
+    // readers that announced an epoch >= the retire epoch loaded the pointer
+    // after it was replaced and cannot see the retired version
+    unsigned long long minEpoch = ~0ULL;
+    for (auto &reader : readers) {
+        unsigned long long epoch = reader.epoch.load(std::memory_order_seq_cst);
+        if (epoch != 0 && epoch < minEpoch) {
+            minEpoch = epoch;
+        }
+    }
+
+    size_t keep = 0;
+    for (auto &item : retired) {
+        if (item.epoch <= minEpoch) {
+            delete item.properties;
+        } else {
+            retired[keep++] = item;
+        }
+    }
+    retired.resize(keep);
+}
+
+/* Public */
+bool ConcurrentProperties::load(const char *path) {
+    std::lock_guard<std::mutex> lock(writeMutex);
+    auto *next = new Properties(*current.load(std::memory_order_acquire));
+    if (!next->load(path)) {
+        delete next;
+        return false;
+    }
+    publish(next);
+    return true;
+}
+
+void ConcurrentProperties::set(const char *key, const char *value) {
+    std::lock_guard<std::mutex> lock(writeMutex);
+    auto *next = new Properties(*current.load(std::memory_order_acquire));
+    next->set(key, value);
+    publish(next);
+}
+
+void ConcurrentProperties::remove(const char *key) {
+    std::lock_guard<std::mutex> lock(writeMutex);
+    const Properties *properties = current.load(std::memory_order_acquire);
+    if (properties->get(key) == nullptr) {
+        return;
+    }
+    auto *next = new Properties(*properties);
+    next->remove(key);
+    publish(next);
+}
+
+bool ConcurrentProperties::get(const char *key, std::string &value) {
+    ReadGuard guard(*this);
+    const char *found = guard.get(key);
+    if (found == nullptr) {
+        return false;
+    }
+    value = found;
+    return true;
+}
+
+int ConcurrentProperties::size() {
+    ReadGuard guard(*this);
+    return guard.properties().size();
+}
+
+unsigned long long ConcurrentProperties::version() const {
+    return globalEpoch.load(std::memory_order_acquire);
+}
+
+/******************************************
+ *    ConcurrentProperties::ReadGuard    *
+ ******************************************/
+
+/* Construct */
+ConcurrentProperties::ReadGuard::ReadGuard(ConcurrentProperties &owner) {
+    slot = &owner.readers[owner.acquireSlot()];
+    // announce the epoch before loading the pointer, see reclaim()
+    slot->epoch.store(owner.globalEpoch.load(std::memory_order_seq_cst), std::memory_order_seq_cst);
+    pinned = owner.current.load(std::memory_order_seq_cst);
+}
+
+ConcurrentProperties::ReadGuard::~ReadGuard() {
+    slot->epoch.store(0, std::memory_order_release);
+    slot->used.store(false, std::memory_order_release);
+}
+
+/* Public */
+const char *ConcurrentProperties::ReadGuard::get(const char *key) const {
+    return pinned->get(key);
+}
+
+const Properties &ConcurrentProperties::ReadGuard::properties() const {
+    return *pinned;
+}
@@ -0,0 +1,87 @@
+//
+// Created by arsia on 2026/10/19.
+//
+
+#ifndef APPFRAME_STARTER_CONCURRENTPROPERTIES_H
+#define APPFRAME_STARTER_CONCURRENTPROPERTIES_H
+
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "Properties.h"
+
+/**
+ * Properties shared between threads.
+ *
+ * Readers take an immutable version through an atomic pointer and never lock.
+ * set/remove/load copy the current version, modify the copy and publish it;
+ * a replaced version is freed once no reader that may still see it is active
+ * (epoch based reclamation). Writes are O(size), so this is meant for data
+ * that is read far more often than it is written.
+ */
+class ConcurrentProperties
+{
+public:
+    static const int MAX_READERS = 128;
+
+    class ReadGuard;
+
+    ConcurrentProperties();
+    explicit ConcurrentProperties(const char *path);
+    ~ConcurrentProperties();
+
+    ConcurrentProperties(const ConcurrentProperties &other) = delete;
+    ConcurrentProperties &operator=(const ConcurrentProperties &other) = delete;
+
+    bool load(const char *path);
+    void set(const char *key, const char *value);
+    void remove(const char *key);
+    bool get(const char *key, std::string &value);
+    int size();
+    unsigned long long version() const;
+
+private:
+    struct alignas(64) ReaderSlot {
+        std::atomic<bool> used;
+        std::atomic<unsigned long long> epoch;
+    };
+
+    struct Retired {
+        const Properties *properties;
+        unsigned long long epoch;
+    };
+
+    std::atomic<const Properties *> current;
+    std::atomic<unsigned long long> globalEpoch;
+    ReaderSlot readers[MAX_READERS];
+    std::mutex writeMutex;
+    std::vector<Retired> retired;
+
+    int acquireSlot();
+    void publish(Properties *next);
+    void reclaim();
+};
+
+/**
+ * Pins the current version for the lifetime of the guard. Values returned by
+ * get() stay valid until the guard is destroyed.
+ */
+class ConcurrentProperties::ReadGuard
+{
+public:
+    explicit ReadGuard(ConcurrentProperties &owner);
+    ~ReadGuard();
+
+    ReadGuard(const ReadGuard &other) = delete;
+    ReadGuard &operator=(const ReadGuard &other) = delete;
+
+    const char *get(const char *key) const;
+    const Properties &properties() const;
+
+private:
+    ReaderSlot *slot;
+    const Properties *pinned;
+};
+
+#endif //APPFRAME_STARTER_CONCURRENTPROPERTIES_H
@@ -0,0 +1,199 @@
+#include "ConfigWatcher.h"
+
+#include <cstring>
+#include "Logger.h"
+#include <sys/stat.h>
+
+#if defined(WINDOWS)
+#include <Windows.h>
+#elif defined(UNIX) || defined(LINUX)
+#include <cerrno>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/inotify.h>
+#endif
+
+/* Construct */
+ConfigWatcher::ConfigWatcher(const char *path, int debounceMillis) {
+    std::string fullPath = path == nullptr ? "" : path;
+    size_t separator = fullPath.find_last_of("/\\");
+    if (separator == std::string::npos) {
+        directory = ".";
+        fileName = fullPath;
+    } else {
+        directory = fullPath.substr(0, separator == 0 ? 1 : separator);
+        fileName = fullPath.substr(separator + 1);
+    }
+
+    this->debounceMillis = debounceMillis < 0 ? 0 : debounceMillis;
+    watchFd = -1;
+    watchDescriptor = -1;
+#if defined(WINDOWS)
+    changeHandle = nullptr;
+    lastStamp = 0;
+#endif
+}
+
+ConfigWatcher::~ConfigWatcher() {
+    stop();
+}
+
+/* Private */
+#if defined(WINDOWS)
+
+static long long fileStamp(const std::string &path) {
+    struct stat status{};
+    if (0 != stat(path.c_str(), &status)) {
+        return -1;
+    }
+    return (long long) status.st_mtime * 1000003LL + (long long) status.st_size;
+}
+
+bool ConfigWatcher::waitForEvent(int timeoutMillis, bool &relevant) {
+    relevant = false;
+    DWORD ret = WaitForSingleObject((HANDLE) changeHandle,
+                                    timeoutMillis < 0 ? INFINITE : (DWORD) timeoutMillis);
+    if (ret == WAIT_TIMEOUT) {
+        return true;
+    }
+    if (ret != WAIT_OBJECT_0 || !FindNextChangeNotification((HANDLE) changeHandle)) {
+        logger() << "[ERROR] ConfigWatcher::waitForEvent: wait for change notification failed." << std::endl;
+        return false;
+    }
+
+    // the notification covers the whole directory, compare the stamp of our file
+    long long stamp = fileStamp(directory + "\\" + fileName);
+    if (stamp != lastStamp) {
+        lastStamp = stamp;
+        relevant = true;
+    }
+    return true;
+}
+
+#elif defined(UNIX) || defined(LINUX)
+
+bool ConfigWatcher::waitForEvent(int timeoutMillis, bool &relevant) {
+    relevant = false;
+
+    struct pollfd pfd{};
+    pfd.fd = watchFd;
+    pfd.events = POLLIN;
+    int ret = poll(&pfd, 1, timeoutMillis);
+    if (ret == 0) {
+        return true;
+    }
+    if (ret < 0) {
+        if (errno == EINTR) {
+            return true;
+        }
+        logger() << "[ERROR] ConfigWatcher::waitForEvent: poll: " << strerror(errno) << std::endl;
+        return false;
+    }
+
+    char buffer[4096] __attribute__ ((aligned(__alignof__(struct inotify_event))));
+    ssize_t length = read(watchFd, buffer, sizeof(buffer));
+    if (length <= 0) {
+        return length == 0 || errno == EAGAIN || errno == EINTR;
+    }
+
+    for (char *ptr = buffer; ptr < buffer + length;) {
+        auto *event = (struct inotify_event *) ptr;
+        if (event->len > 0 && fileName == event->name) {
+            relevant = true;
+        }
+        ptr += sizeof(struct inotify_event) + event->len;
+    }
+    return true;
+}
+
+#endif
+
+/* Public */
+bool ConfigWatcher::start() {
+    if (fileName.empty()) {
+        logger() << "[ERROR] ConfigWatcher::start: file path is empty." << std::endl;
+        return false;
+    }
+
+#if defined(WINDOWS)
+    HANDLE handle = FindFirstChangeNotificationA(directory.c_str(), FALSE,
+                                                 FILE_NOTIFY_CHANGE_LAST_WRITE |
+                                                 FILE_NOTIFY_CHANGE_FILE_NAME |
+                                                 FILE_NOTIFY_CHANGE_SIZE);
+    if (handle == INVALID_HANDLE_VALUE) {
+        logger() << "[ERROR] ConfigWatcher::start: watch directory failed.[" << directory << "]" << std::endl;
+        return false;
+    }
+    changeHandle = handle;
+    lastStamp = fileStamp(directory + "\\" + fileName);
+#elif defined(UNIX) || defined(LINUX)
+    watchFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (watchFd == -1) {
+        logger() << "[ERROR] ConfigWatcher::start: inotify_init1: " << strerror(errno) << std::endl;
+        return false;
+    }
+
+    watchDescriptor = inotify_add_watch(watchFd, directory.c_str(),
+                                        IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE | IN_MODIFY);
+    if (watchDescriptor == -1) {
+        logger() << "[ERROR] ConfigWatcher::start: watch directory failed.[" << directory << "]" << std::endl;
+        stop();
+        return false;
+    }
+#endif
+    return true;
+}
+
+bool ConfigWatcher::waitForChange() {
+    bool relevant = false;
+
+    // block until the first relevant event
+    while (!relevant) {
+        if (!waitForEvent(-1, relevant)) {
+            return false;
+        }
+    }
+
+    // debounce: wait until the file has been quiet for the whole window
+    bool more = true;
+    while (more) {
+        if (!waitForEvent(debounceMillis, more)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool ConfigWatcher::pollChange(bool &changed) {
+    changed = false;
+    if (!waitForEvent(0, changed)) {
+        return false;
+    }
+
+    bool more = changed;
+    while (more) {
+        if (!waitForEvent(debounceMillis, more)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+int ConfigWatcher::descriptor() const {
+    return watchFd;
+}
+
+void ConfigWatcher::stop() {
+#if defined(WINDOWS)
+    if (changeHandle != nullptr) {
+        FindCloseChangeNotification((HANDLE) changeHandle);
+        changeHandle = nullptr;
+    }
+#elif defined(UNIX) || defined(LINUX)
+    if (watchFd != -1) {
+        close(watchFd);
+        watchFd = -1;
+        watchDescriptor = -1;
+    }
+#endif
+}
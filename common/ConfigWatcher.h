@@ -0,0 +1,47 @@
+//
+// Created by arsia on 2026/10/19.
+//
+
+#ifndef APPFRAME_STARTER_CONFIGWATCHER_H
+#define APPFRAME_STARTER_CONFIGWATCHER_H
+
+#include <string>
+
+/**
+ * Watches a single file for modification.
+ *
+ * The parent directory is watched instead of the file itself, so editors that
+ * save by writing a temporary file and renaming it over the original are seen.
+ * Bursts of events are folded into one change by the debounce window.
+ *
+ * waitForChange() blocks until the next change. Event loops can wait on
+ * descriptor() themselves and call pollChange() when it is readable; it only
+ * blocks for the debounce window after a relevant event (Linux only).
+ */
+class ConfigWatcher
+{
+public:
+    explicit ConfigWatcher(const char *path, int debounceMillis = 200);
+    ~ConfigWatcher();
+
+    bool start();
+    bool waitForChange();
+    bool pollChange(bool &changed);
+    int descriptor() const;
+    void stop();
+
+private:
+    std::string directory;
+    std::string fileName;
+    int debounceMillis;
+    int watchFd;
+    int watchDescriptor;
+#if defined(WINDOWS)
+    void *changeHandle;
+    long long lastStamp;
+#endif
+
+    bool waitForEvent(int timeoutMillis, bool &relevant);
+};
+
+#endif //APPFRAME_STARTER_CONFIGWATCHER_H
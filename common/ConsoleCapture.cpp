@@ -0,0 +1,458 @@
+#include "ConsoleCapture.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include "Logger.h"
+
+#if defined(UNIX) || defined(LINUX)
+#include <cerrno>
+#include <csignal>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#endif
+
+static const uint64_t EVENT_KEY = ~0ULL;
+
+enum ReadResult {
+    READ_AGAIN,
+    READ_STALLED,
+    READ_CLOSED
+};
+
+/* Static */
+static unsigned long long countLines(const char *data, size_t length) {
+    unsigned long long lines = 0;
+    const char *end = data + length;
+    while ((data = (const char *) memchr(data, '\n', (size_t) (end - data))) != nullptr) {
+        lines++;
+        data++;
+    }
+    return lines;
+}
+
+static size_t roundUpPowerOfTwo(size_t value) {
+    size_t result = 4096;
+    while (result < value) {
+        result <<= 1;
+    }
+    return result;
+}
+
+/* Construct */
+ConsoleCapture::ConsoleCapture(const Policy &policy) : policy(policy) {
+    readerDone.store(false);
+    stopping.store(false);
+    started = false;
+    epollFd = -1;
+    eventFd = -1;
+}
+
+ConsoleCapture::~ConsoleCapture() {
+    stop();
+}
+
+/* Private */
+void ConsoleCapture::notifyWriter() {
+    // taking the mutex orders the ring update before the writer's predicate check
+    {
+        std::lock_guard<std::mutex> lock(wakeMutex);
+    }
+    wakeWriter.notify_one();
+}
+
+void ConsoleCapture::notifyReader() {
+#if defined(UNIX) || defined(LINUX)
+    uint64_t one = 1;
+    if (write(eventFd, &one, sizeof(one)) != (ssize_t) sizeof(one)) {
+        logger() << "[ERROR] ConsoleCapture::notifyReader: write: " << strerror(errno) << std::endl;
+    }
+#endif
+}
+
+int ConsoleCapture::readChannel(Channel &channel) {
+#if defined(UNIX) || defined(LINUX)
+    size_t capacity = channel.mask + 1;
+    bool produced = false;
+    int result = READ_AGAIN;
+    while (true) {
+        size_t head = channel.head.load(std::memory_order_relaxed);
+        size_t used = head - channel.tail.load(std::memory_order_seq_cst);
+        ssize_t count;
+        if (used == capacity) {
+            if (policy.overflow == BLOCK) {
+                // stop reading until the writer made room, the pipe fills up
+                // and the child waits
+                channel.stalled.store(true, std::memory_order_seq_cst);
+                if (head - channel.tail.load(std::memory_order_seq_cst) < capacity) {
+                    // the writer drained in between and did not see the flag
+                    channel.stalled.store(false, std::memory_order_seq_cst);
+                    continue;
+                }
+                channel.stalls.fetch_add(1, std::memory_order_relaxed);
+                result = READ_STALLED;
+                break;
+            }
+
+            char scratch[16384];
+            count = read(channel.fd, scratch, sizeof(scratch));
+            if (count > 0) {
+                channel.bytesDropped.fetch_add((unsigned long long) count, std::memory_order_relaxed);
+                channel.linesDropped.fetch_add(countLines(scratch, (size_t) count), std::memory_order_relaxed);
+                continue;
+            }
+        } else {
+            size_t offset = head & channel.mask;
+            size_t contiguous = capacity - used;
+            if (contiguous > capacity - offset) {
+                contiguous = capacity - offset;
+            }
+            count = read(channel.fd, channel.ring.get() + offset, contiguous);
+            if (count > 0) {
+                channel.head.store(head + (size_t) count, std::memory_order_release);
+                produced = true;
+                continue;
+            }
+        }
+
+        if (count == -1 && errno == EINTR) {
+            continue;
+        }
+        result = count == -1 && (errno == EAGAIN || errno == EWOULDBLOCK) ? READ_AGAIN : READ_CLOSED;
+        break;
+    }
+
+    if (produced || result == READ_STALLED) {
+        notifyWriter();
+    }
+    return result;
+#else
+    return READ_CLOSED;
+#endif
+}
+
+bool ConsoleCapture::drainChannel(Channel &channel) {
+#if defined(UNIX) || defined(LINUX)
+    size_t head = channel.head.load(std::memory_order_acquire);
+    size_t tail = channel.tail.load(std::memory_order_relaxed);
+    if (head == tail) {
+        return false;
+    }
+
+    if (channel.file == -1) {
+        channel.file = open(channel.path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+        struct stat status{};
+        channel.fileSize = channel.file != -1 && 0 == fstat(channel.file, &status) ? (long long) status.st_size : 0;
+    }
+
+    size_t capacity = channel.mask + 1;
+    size_t offset = tail & channel.mask;
+    size_t length = head - tail;
+    struct iovec segments[2];
+    int segmentCount = 1;
+    segments[0].iov_base = channel.ring.get() + offset;
+    segments[0].iov_len = length;
+    if (offset + length > capacity) {
+        segments[0].iov_len = capacity - offset;
+        segments[1].iov_base = channel.ring.get();
+        segments[1].iov_len = length - segments[0].iov_len;
+        segmentCount = 2;
+    }
+
+    ssize_t written = channel.file == -1 ? -1 : writev(channel.file, segments, segmentCount);
+    size_t consumed = written > 0 ? (size_t) written : length;
+    unsigned long long lines = countLines((const char *) segments[0].iov_base,
+                                          consumed < segments[0].iov_len ? consumed : segments[0].iov_len);
+    if (segmentCount == 2 && consumed > segments[0].iov_len) {
+        lines += countLines(channel.ring.get(), consumed - segments[0].iov_len);
+    }
+    if (written > 0) {
+        channel.bytesWritten.fetch_add(consumed, std::memory_order_relaxed);
+        channel.linesWritten.fetch_add(lines, std::memory_order_relaxed);
+        channel.fileSize += (long long) consumed;
+    } else {
+        // the file cannot be written, do not wedge the child behind it
+        channel.bytesDropped.fetch_add(consumed, std::memory_order_relaxed);
+        channel.linesDropped.fetch_add(lines, std::memory_order_relaxed);
+    }
+    channel.tail.store(tail + consumed, std::memory_order_seq_cst);
+
+    if (channel.stalled.load(std::memory_order_seq_cst)) {
+        notifyReader();
+    }
+    if (channel.fileSize >= policy.maxFileSize) {
+        rotate(channel);
+    }
+    return true;
+#else
+    return false;
+#endif
+}
+
+void ConsoleCapture::rotate(Channel &channel) {
+#if defined(UNIX) || defined(LINUX)
+    if (channel.file != -1) {
+        close(channel.file);
+        channel.file = -1;
+    }
+    if (policy.maxFiles <= 0) {
+        unlink(channel.path.c_str());
+    } else {
+        for (int i = policy.maxFiles - 1; i >= 1; i--) {
+            std::string from = channel.path + "." + std::to_string(i);
+            std::string to = channel.path + "." + std::to_string(i + 1);
+            rename(from.c_str(), to.c_str());
+        }
+        rename(channel.path.c_str(), (channel.path + ".1").c_str());
+    }
+    channel.fileSize = 0;
+    channel.rotations.fetch_add(1, std::memory_order_relaxed);
+#endif
+}
+
+void ConsoleCapture::readLoop() {
+#if defined(UNIX) || defined(LINUX)
+    struct epoll_event events[64];
+    while (!stopping.load()) {
+        int count = epoll_wait(epollFd, events, 64, -1);
+        if (count == -1 && errno != EINTR) {
+            logger() << "[ERROR] ConsoleCapture::readLoop: epoll_wait: " << strerror(errno) << std::endl;
+            break;
+        }
+
+        for (int i = 0; i < count; i++) {
+            if (events[i].data.u64 != EVENT_KEY) {
+                Channel &channel = *items[events[i].data.u64];
+                int result = readChannel(channel);
+                struct epoll_event event{};
+                event.data.u64 = events[i].data.u64;
+                if (result == READ_CLOSED) {
+                    epoll_ctl(epollFd, EPOLL_CTL_DEL, channel.fd, nullptr);
+                    close(channel.fd);
+                    channel.fd = -1;
+                } else if (result == READ_STALLED) {
+                    epoll_ctl(epollFd, EPOLL_CTL_MOD, channel.fd, &event);
+                }
+                continue;
+            }
+
+            uint64_t value;
+            while (read(eventFd, &value, sizeof(value)) > 0) {}
+
+            std::vector<std::pair<int, int>> pending;
+            {
+                std::lock_guard<std::mutex> lock(attachMutex);
+                pending.swap(attaching);
+            }
+            for (auto &item : pending) {
+                Channel &channel = *items[item.first];
+                if (channel.fd != -1) {
+                    // the previous process of a restarted channel
+                    readChannel(channel);
+                    epoll_ctl(epollFd, EPOLL_CTL_DEL, channel.fd, nullptr);
+                    close(channel.fd);
+                }
+                channel.fd = item.second;
+                struct epoll_event event{};
+                event.events = EPOLLIN;
+                event.data.u64 = (uint64_t) item.first;
+                epoll_ctl(epollFd, EPOLL_CTL_ADD, channel.fd, &event);
+            }
+
+            // the writer made room in stalled rings
+            for (size_t index = 0; index < items.size(); index++) {
+                Channel &channel = *items[index];
+                if (channel.fd != -1 && channel.stalled.load(std::memory_order_seq_cst) &&
+                    channel.head.load() - channel.tail.load(std::memory_order_seq_cst) <= channel.mask) {
+                    channel.stalled.store(false, std::memory_order_seq_cst);
+                    struct epoll_event event{};
+                    event.events = EPOLLIN;
+                    event.data.u64 = (uint64_t) index;
+                    epoll_ctl(epollFd, EPOLL_CTL_MOD, channel.fd, &event);
+                }
+            }
+        }
+    }
+
+    // whatever the exited children left in the pipes
+    {
+        std::lock_guard<std::mutex> lock(attachMutex);
+        for (auto &item : attaching) {
+            Channel &channel = *items[item.first];
+            while (channel.fd != -1 && readChannel(channel) == READ_STALLED) {
+                channel.stalled.store(false);
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+            if (channel.fd != -1) {
+                close(channel.fd);
+            }
+            channel.fd = item.second;
+        }
+        attaching.clear();
+    }
+    for (auto &item : items) {
+        Channel &channel = *item;
+        while (channel.fd != -1) {
+            int result = readChannel(channel);
+            if (result != READ_STALLED) {
+                close(channel.fd);
+                channel.fd = -1;
+            } else {
+                channel.stalled.store(false);
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+        }
+    }
+#endif
+    readerDone.store(true);
+    notifyWriter();
+}
+
+void ConsoleCapture::writeLoop() {
+    while (true) {
+        bool wrote = false;
+        for (auto &item : items) {
+            wrote = drainChannel(*item) || wrote;
+        }
+        if (wrote) {
+            continue;
+        }
+        if (readerDone.load()) {
+            bool empty = true;
+            for (auto &item : items) {
+                empty = empty && item->head.load() == item->tail.load();
+            }
+            if (empty) {
+                break;
+            }
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(wakeMutex);
+        wakeWriter.wait(lock, [this]() {
+            if (readerDone.load()) {
+                return true;
+            }
+            for (auto &item : items) {
+                if (item->head.load(std::memory_order_acquire) != item->tail.load(std::memory_order_relaxed)) {
+                    return true;
+                }
+            }
+            return false;
+        });
+    }
+
+#if defined(UNIX) || defined(LINUX)
+    for (auto &item : items) {
+        if (item->file != -1) {
+            close(item->file);
+            item->file = -1;
+        }
+    }
+#endif
+}
+
+/* Public */
+int ConsoleCapture::add(const std::string &name, const std::string &path) {
+    std::unique_ptr<Channel> channel(new Channel());
+    size_t capacity = roundUpPowerOfTwo(policy.bufferSize);
+    channel->name = name;
+    channel->path = path;
+    channel->ring.reset(new char[capacity]);
+    channel->mask = capacity - 1;
+    channel->head.store(0);
+    channel->tail.store(0);
+    channel->stalled.store(false);
+    channel->fd = -1;
+    channel->file = -1;
+    channel->fileSize = 0;
+    channel->bytesWritten.store(0);
+    channel->linesWritten.store(0);
+    channel->bytesDropped.store(0);
+    channel->linesDropped.store(0);
+    channel->stalls.store(0);
+    channel->rotations.store(0);
+    items.push_back(std::move(channel));
+    return (int) items.size() - 1;
+}
+
+bool ConsoleCapture::start() {
+#if defined(UNIX) || defined(LINUX)
+    epollFd = epoll_create1(EPOLL_CLOEXEC);
+    eventFd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (epollFd == -1 || eventFd == -1) {
+        logger() << "[ERROR] ConsoleCapture::start: create descriptors: " << strerror(errno) << std::endl;
+        return false;
+    }
+    struct epoll_event event{};
+    event.events = EPOLLIN;
+    event.data.u64 = EVENT_KEY;
+    epoll_ctl(epollFd, EPOLL_CTL_ADD, eventFd, &event);
+
+    // the threads inherit a fully blocked mask, signals are for the main
+    // thread where a supervisor waits for SIGCHLD
+    sigset_t signals;
+    sigset_t previous;
+    sigfillset(&signals);
+    pthread_sigmask(SIG_BLOCK, &signals, &previous);
+    reader = std::thread(&ConsoleCapture::readLoop, this);
+    writer = std::thread(&ConsoleCapture::writeLoop, this);
+    pthread_sigmask(SIG_SETMASK, &previous, nullptr);
+    started = true;
+    return true;
+#else
+    logger() << "[ERROR] ConsoleCapture::start: only supported on Linux." << std::endl;
+    return false;
+#endif
+}
+
+void ConsoleCapture::attach(int channel, int fd) {
+    if (!started || fd == -1 || channel < 0 || channel >= (int) items.size()) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(attachMutex);
+        attaching.emplace_back(channel, fd);
+    }
+    notifyReader();
+}
+
+void ConsoleCapture::stop() {
+    if (!started) {
+        return;
+    }
+    started = false;
+    stopping.store(true);
+    notifyReader();
+    reader.join();
+    writer.join();
+
+#if defined(UNIX) || defined(LINUX)
+    close(eventFd);
+    close(epollFd);
+#endif
+}
+
+const std::string &ConsoleCapture::name(int channel) const {
+    return items[channel]->name;
+}
+
+ConsoleCapture::Statistics ConsoleCapture::statistics(int channel) const {
+    const Channel &item = *items[channel];
+    Statistics statistics{};
+    statistics.bytesWritten = item.bytesWritten.load();
+    statistics.linesWritten = item.linesWritten.load();
+    statistics.bytesDropped = item.bytesDropped.load();
+    statistics.linesDropped = item.linesDropped.load();
+    statistics.stalls = item.stalls.load();
+    statistics.rotations = item.rotations.load();
+    return statistics;
+}
+
+int ConsoleCapture::channels() const {
+    return (int) items.size();
+}
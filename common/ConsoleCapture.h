@@ -0,0 +1,111 @@
+//
+// Created by arsia on 2026/10/19.
+//
+
+#ifndef APPFRAME_STARTER_CONSOLECAPTURE_H
+#define APPFRAME_STARTER_CONSOLECAPTURE_H
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * Collects the console output of child processes into log files.
+ *
+ * A reader thread drains the non-blocking pipes of all channels (epoll) into
+ * one single-producer/single-consumer ring buffer per channel, a writer
+ * thread batches the rings into their files and rotates a file once it
+ * reaches maxFileSize (file, file.1 ... file.<maxFiles>).
+ *
+ * When a ring is full, DROP discards the new output and counts it; BLOCK
+ * stops reading that pipe until the writer has made room, so the pipe fills
+ * up and the child waits in write(). Only supported on Linux.
+ */
+class ConsoleCapture
+{
+public:
+    enum Overflow {
+        DROP,
+        BLOCK
+    };
+
+    struct Policy {
+        size_t bufferSize;
+        long long maxFileSize;
+        int maxFiles;
+        Overflow overflow;
+    };
+
+    struct Statistics {
+        unsigned long long bytesWritten;
+        unsigned long long linesWritten;
+        unsigned long long bytesDropped;
+        unsigned long long linesDropped;
+        unsigned long long stalls;
+        unsigned long long rotations;
+    };
+
+    explicit ConsoleCapture(const Policy &policy);
+    ~ConsoleCapture();
+
+    ConsoleCapture(const ConsoleCapture &other) = delete;
+    ConsoleCapture &operator=(const ConsoleCapture &other) = delete;
+
+    int add(const std::string &name, const std::string &path);
+    bool start();
+    void attach(int channel, int fd);
+    void stop();
+    const std::string &name(int channel) const;
+    Statistics statistics(int channel) const;
+    int channels() const;
+
+private:
+    struct Channel {
+        std::string name;
+        std::string path;
+        std::unique_ptr<char[]> ring;
+        size_t mask;
+        // written by the reader thread only
+        std::atomic<size_t> head;
+        // written by the writer thread only
+        std::atomic<size_t> tail;
+        std::atomic<bool> stalled;
+        int fd;
+        int file;
+        long long fileSize;
+        std::atomic<unsigned long long> bytesWritten;
+        std::atomic<unsigned long long> linesWritten;
+        std::atomic<unsigned long long> bytesDropped;
+        std::atomic<unsigned long long> linesDropped;
+        std::atomic<unsigned long long> stalls;
+        std::atomic<unsigned long long> rotations;
+    };
+
+    Policy policy;
+    std::vector<std::unique_ptr<Channel>> items;
+    std::mutex attachMutex;
+    std::vector<std::pair<int, int>> attaching;
+    std::mutex wakeMutex;
+    std::condition_variable wakeWriter;
+    std::atomic<bool> readerDone;
+    std::atomic<bool> stopping;
+    bool started;
+    int epollFd;
+    int eventFd;
+    std::thread reader;
+    std::thread writer;
+
+    void readLoop();
+    void writeLoop();
+    int readChannel(Channel &channel);
+    bool drainChannel(Channel &channel);
+    void rotate(Channel &channel);
+    void notifyWriter();
+    void notifyReader();
+};
+
+#endif //APPFRAME_STARTER_CONSOLECAPTURE_H
@@ -0,0 +1,213 @@
+#include "JvmSizing.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+
+#if defined(UNIX) || defined(LINUX)
+#include <sched.h>
+#include <unistd.h>
+#endif
+
+/* Static */
+// generated option and the user options that set the same thing
+struct OptionAlias {
+    const char *generated;
+    const char *aliases[4];
+};
+
+static const OptionAlias OPTION_ALIASES[] = {
+        {"-Xmx",                      {"-Xmx", "-XX:MaxHeapSize=", "-XX:MaxRAMPercentage=", "-XX:MaxRAM="}},
+        {"-XX:ActiveProcessorCount=", {"-XX:ActiveProcessorCount=", nullptr, nullptr, nullptr}},
+        {"-XX:ParallelGCThreads=",    {"-XX:ParallelGCThreads=", nullptr, nullptr, nullptr}},
+        {"-XX:CICompilerCount=",      {"-XX:CICompilerCount=", nullptr, nullptr, nullptr}}
+};
+
+static bool startsWith(const std::string &value, const char *prefix) {
+    return 0 == value.compare(0, strlen(prefix), prefix);
+}
+
+/* Private */
+bool JvmSizing::readFirstLine(const std::string &path, std::string &line) {
+    FILE *file = fopen(path.c_str(), "r");
+    if (file == nullptr) {
+        return false;
+    }
+    char buffer[4096];
+    bool success = fgets(buffer, sizeof(buffer), file) != nullptr;
+    fclose(file);
+    if (success) {
+        line = buffer;
+        while (!line.empty() && (line.back() == '\n' || line.back() == '\r')) {
+            line.pop_back();
+        }
+    }
+    return success;
+}
+
+bool JvmSizing::cgroupDirectory(std::string &directory, std::string &mountPoint) {
+    // the cgroup2 mount, "/sys/fs/cgroup" or "/sys/fs/cgroup/unified" on hybrid hosts
+    FILE *mountInfo = fopen("/proc/self/mountinfo", "r");
+    if (mountInfo == nullptr) {
+        return false;
+    }
+    char line[4096];
+    mountPoint.clear();
+    while (fgets(line, sizeof(line), mountInfo) != nullptr) {
+        const char *separator = strstr(line, " - ");
+        if (separator == nullptr || 0 != strncmp(separator + 3, "cgroup2 ", 8)) {
+            continue;
+        }
+        // id parent major:minor root mount-point ...
+        char root[1024];
+        char point[1024];
+        if (2 == sscanf(line, "%*s %*s %*s %1023s %1023s", root, point)) {
+            mountPoint = point;
+            break;
+        }
+    }
+    fclose(mountInfo);
+    if (mountPoint.empty()) {
+        return false;
+    }
+
+    FILE *cgroup = fopen("/proc/self/cgroup", "r");
+    if (cgroup == nullptr) {
+        return false;
+    }
+    std::string path;
+    while (fgets(line, sizeof(line), cgroup) != nullptr) {
+        if (0 == strncmp(line, "0::", 3)) {
+            path = line + 3;
+            while (!path.empty() && (path.back() == '\n' || path.back() == '\r')) {
+                path.pop_back();
+            }
+            break;
+        }
+    }
+    fclose(cgroup);
+    directory = path == "/" ? mountPoint : mountPoint + path;
+    return true;
+}
+
+/* Public */
+bool JvmSizing::detect(Resources &resources) {
+    resources.cpus = (double) std::thread::hardware_concurrency();
+    resources.memoryBytes = 0;
+    resources.cpuLimited = false;
+    resources.memoryLimited = false;
+#if defined(UNIX) || defined(LINUX)
+    cpu_set_t cpuSet;
+    CPU_ZERO(&cpuSet);
+    if (0 == sched_getaffinity(0, sizeof(cpuSet), &cpuSet)) {
+        resources.cpus = (double) CPU_COUNT(&cpuSet);
+    }
+    long pages = sysconf(_SC_PHYS_PAGES);
+    long pageSize = sysconf(_SC_PAGESIZE);
+    if (pages > 0 && pageSize > 0) {
+        resources.memoryBytes = (long long) pages * pageSize;
+    }
+
+    std::string directory;
+    std::string mountPoint;
+    if (!cgroupDirectory(directory, mountPoint)) {
+        // cgroup v1 or no cgroup, the host values are used
+        return resources.cpus > 0;
+    }
+    // a parent cgroup can be stricter than our own, the root has no limit files
+    while (directory.size() >= mountPoint.size()) {
+        std::string line;
+        if (readFirstLine(directory + "/cpu.max", line)) {
+            char quota[64];
+            long long period = 0;
+            if (2 == sscanf(line.c_str(), "%63s %lld", quota, &period) &&
+                0 != strcmp(quota, "max") && period > 0) {
+                double cpus = (double) atoll(quota) / (double) period;
+                if (cpus > 0 && cpus < resources.cpus) {
+                    resources.cpus = cpus;
+                    resources.cpuLimited = true;
+                }
+            }
+        }
+        if (readFirstLine(directory + "/memory.max", line) && line != "max") {
+            long long memory = atoll(line.c_str());
+            if (memory > 0 && (resources.memoryBytes == 0 || memory < resources.memoryBytes)) {
+                resources.memoryBytes = memory;
+                resources.memoryLimited = true;
+            }
+        }
+        if (directory.size() == mountPoint.size()) {
+            break;
+        }
+        directory = directory.substr(0, directory.rfind('/'));
+    }
+#endif
+    return resources.cpus > 0;
+}
+
+std::vector<JvmSizing::Share> JvmSizing::divide(const Resources &resources,
+                                                const std::vector<double> &weights,
+                                                int heapPercent) {
+    double total = 0;
+    for (double weight : weights) {
+        total += weight;
+    }
+
+    std::vector<Share> shares;
+    for (double weight : weights) {
+        Share share{};
+        double fraction = total > 0 ? weight / total : 0;
+        share.cpus = resources.cpus * fraction;
+        share.memoryBytes = (long long) ((double) resources.memoryBytes * fraction);
+        share.heapBytes = share.memoryBytes / 100 * heapPercent;
+
+        // same ergonomics as HotSpot, applied to the share instead of the host
+        int processors = (int) std::ceil(share.cpus);
+        share.activeProcessors = processors < 1 ? 1 : processors;
+        int n = share.activeProcessors;
+        share.parallelGcThreads = n <= 8 ? n : 8 + (n - 8) * 5 / 8;
+        int log = (int) std::log2((double) n);
+        int logLog = (int) std::log2((double) (log > 1 ? log : 1));
+        int compilers = log * logLog * 3 / 2;
+        // tiered compilation needs one C1 and one C2 thread
+        share.compilerThreads = compilers < 2 ? 2 : compilers;
+        shares.push_back(share);
+    }
+    return shares;
+}
+
+void JvmSizing::options(const Share &share, std::vector<std::string> &result) {
+    // 0 when the memory is unknown
+    long long heapMegabytes = share.heapBytes / (1024 * 1024);
+    if (heapMegabytes > 0) {
+        result.push_back("-Xmx" + std::to_string(heapMegabytes < 16 ? 16 : heapMegabytes) + "m");
+    }
+    result.push_back("-XX:ActiveProcessorCount=" + std::to_string(share.activeProcessors));
+    result.push_back("-XX:ParallelGCThreads=" + std::to_string(share.parallelGcThreads));
+    result.push_back("-XX:CICompilerCount=" + std::to_string(share.compilerThreads));
+}
+
+void JvmSizing::merge(const std::vector<std::string> &generated,
+                      const std::vector<std::string> &userOptions,
+                      std::vector<std::string> &result) {
+    for (auto &option : generated) {
+        bool overridden = false;
+        for (auto &alias : OPTION_ALIASES) {
+            if (!startsWith(option, alias.generated)) {
+                continue;
+            }
+            for (auto &userOption : userOptions) {
+                for (auto name : alias.aliases) {
+                    if (name != nullptr && startsWith(userOption, name)) {
+                        overridden = true;
+                    }
+                }
+            }
+        }
+        if (!overridden) {
+            result.push_back(option);
+        }
+    }
+}
@@ -0,0 +1,54 @@
+//
+// Created by arsia on 2026/10/19.
+//
+
+#ifndef APPFRAME_STARTER_JVMSIZING_H
+#define APPFRAME_STARTER_JVMSIZING_H
+
+#include <string>
+#include <vector>
+
+/**
+ * Divides the CPUs and memory available to the starter across the JVMs it launches.
+ *
+ * detect() reads the host topology (the CPUs of the affinity mask and the
+ * physical memory) and lowers it to the cgroup v2 limits (cpu.max,
+ * memory.max) of the starter's cgroup and its parents. divide() gives every
+ * region a share proportional to its weight, options() turns a share into
+ * -Xmx, -XX:ActiveProcessorCount, -XX:ParallelGCThreads and
+ * -XX:CICompilerCount. merge() drops every generated option that the user
+ * options already set, so the user options always win.
+ */
+class JvmSizing
+{
+public:
+    struct Resources {
+        double cpus;
+        // 0 when unknown
+        long long memoryBytes;
+        bool cpuLimited;
+        bool memoryLimited;
+    };
+
+    struct Share {
+        double cpus;
+        long long memoryBytes;
+        long long heapBytes;
+        int activeProcessors;
+        int parallelGcThreads;
+        int compilerThreads;
+    };
+
+    static bool detect(Resources &resources);
+    static std::vector<Share> divide(const Resources &resources, const std::vector<double> &weights, int heapPercent);
+    static void options(const Share &share, std::vector<std::string> &result);
+    static void merge(const std::vector<std::string> &generated,
+                      const std::vector<std::string> &userOptions,
+                      std::vector<std::string> &result);
+
+private:
+    static bool cgroupDirectory(std::string &directory, std::string &mountPoint);
+    static bool readFirstLine(const std::string &path, std::string &line);
+};
+
+#endif //APPFRAME_STARTER_JVMSIZING_H
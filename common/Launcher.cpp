@@ -0,0 +1,388 @@
+#include "Launcher.h"
+
+#include <chrono>
+#include <cstring>
+#include "Logger.h"
+
+#if defined(WINDOWS)
+#include <Windows.h>
+#elif defined(UNIX) || defined(LINUX)
+#include <cerrno>
+#include <csignal>
+#include <fcntl.h>
+#include <sched.h>
+#include <spawn.h>
+#include <unistd.h>
+#include <linux/mempolicy.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+
+extern char **environ;
+#endif
+
+/* Static */
+static bool sameName(const std::string &entry, const std::string &name) {
+    if (entry.length() <= name.length() || entry[name.length()] != '=') {
+        return false;
+    }
+#if defined(WINDOWS)
+    // environment variable names are case insensitive on Windows
+    return 0 == _strnicmp(entry.c_str(), name.c_str(), name.length());
+#else
+    return 0 == entry.compare(0, name.length(), name);
+#endif
+}
+
+static std::string quote(const std::string &value) {
+    if (!value.empty() && value.find_first_of(" \t\"'&|;<>()$`\\*?") == std::string::npos) {
+        return value;
+    }
+    std::string quoted = "\"";
+    for (char c : value) {
+        if (c == '"') {
+            quoted.push_back('\\');
+        }
+        quoted.push_back(c);
+    }
+    quoted.push_back('"');
+    return quoted;
+}
+
+/* Construct */
+Launcher::Launcher() {
+    processId = -1;
+    status = -1;
+    spawnTime = 0;
+    capture = false;
+    outputFd = -1;
+    numaNode = -1;
+#if defined(WINDOWS)
+    processHandle = nullptr;
+#endif
+}
+
+Launcher::~Launcher() {
+#if defined(WINDOWS)
+    if (processHandle != nullptr) {
+        CloseHandle((HANDLE) processHandle);
+    }
+#elif defined(UNIX) || defined(LINUX)
+    if (outputFd != -1) {
+        close(outputFd);
+    }
+#endif
+}
+
+/* Private */
+std::vector<std::string> Launcher::buildEnvironment() const {
+    std::vector<std::string> inherited;
+#if defined(WINDOWS)
+    char *block = GetEnvironmentStringsA();
+    for (char *entry = block; entry != nullptr && *entry != '\0'; entry += strlen(entry) + 1) {
+        inherited.emplace_back(entry);
+    }
+    if (block != nullptr) {
+        FreeEnvironmentStringsA(block);
+    }
+#elif defined(UNIX) || defined(LINUX)
+    for (char **entry = environ; *entry != nullptr; entry++) {
+        inherited.emplace_back(*entry);
+    }
+#endif
+
+    std::vector<std::string> result;
+    result.reserve(inherited.size() + environment.size());
+    for (auto &entry : inherited) {
+        bool overridden = false;
+        for (auto &variable : environment) {
+            if (sameName(entry, variable.first)) {
+                overridden = true;
+                break;
+            }
+        }
+        if (!overridden) {
+            result.push_back(entry);
+        }
+    }
+    for (auto &variable : environment) {
+        result.push_back(variable.first + "=" + variable.second);
+    }
+    return result;
+}
+
+bool Launcher::collect(bool block) {
+    if (processId == -1) {
+        return true;
+    }
+
+#if defined(WINDOWS)
+    if (WAIT_OBJECT_0 != WaitForSingleObject((HANDLE) processHandle, block ? INFINITE : 0)) {
+        return false;
+    }
+    DWORD code = 0;
+    GetExitCodeProcess((HANDLE) processHandle, &code);
+    CloseHandle((HANDLE) processHandle);
+    processHandle = nullptr;
+    status = (int) code;
+#elif defined(UNIX) || defined(LINUX)
+    int waitStatus = 0;
+    pid_t ret;
+    do {
+        ret = waitpid((pid_t) processId, &waitStatus, block ? 0 : WNOHANG);
+    } while (ret == -1 && errno == EINTR);
+
+    if (ret == 0) {
+        return false;
+    }
+    if (ret == -1) {
+        logger() << "[ERROR] Launcher::wait: waitpid: " << strerror(errno) << std::endl;
+        status = -1;
+    } else if (WIFEXITED(waitStatus)) {
+        status = WEXITSTATUS(waitStatus);
+    } else if (WIFSIGNALED(waitStatus)) {
+        status = 128 + WTERMSIG(waitStatus);
+    }
+#endif
+    processId = -1;
+    return true;
+}
+
+/* Public */
+void Launcher::setProgram(const std::string &path) {
+    program = path;
+}
+
+void Launcher::addArgument(const std::string &argument) {
+    arguments.push_back(argument);
+}
+
+void Launcher::setEnvironment(const std::string &name, const std::string &value) {
+    for (auto &variable : environment) {
+        if (variable.first == name) {
+            variable.second = value;
+            return;
+        }
+    }
+    environment.emplace_back(name, value);
+}
+
+void Launcher::clearArguments() {
+    arguments.clear();
+}
+
+void Launcher::captureOutput(bool capture) {
+    this->capture = capture;
+}
+
+int Launcher::takeOutput() {
+    int fd = outputFd;
+    outputFd = -1;
+    return fd;
+}
+
+void Launcher::setPlacement(const std::vector<int> &cpus, int numaNode) {
+    this->cpus = cpus;
+    this->numaNode = numaNode;
+}
+
+bool Launcher::start() {
+    if (program.empty()) {
+        logger() << "[ERROR] Launcher::start: program is empty." << std::endl;
+        return false;
+    }
+
+    std::vector<std::string> envs = buildEnvironment();
+    auto begin = std::chrono::steady_clock::now();
+
+#if defined(WINDOWS)
+    std::string commandLine = quote(program);
+    for (auto &argument : arguments) {
+        commandLine.append(" ").append(quote(argument));
+    }
+    // batch files can only be run by the command interpreter
+    size_t length = program.length();
+    if (length > 4 && (0 == _stricmp(program.c_str() + length - 4, ".bat") ||
+                       0 == _stricmp(program.c_str() + length - 4, ".cmd"))) {
+        commandLine = "cmd.exe /c \"" + commandLine + "\"";
+    }
+
+    std::string block;
+    for (auto &entry : envs) {
+        block.append(entry).push_back('\0');
+    }
+    block.push_back('\0');
+
+    STARTUPINFOA startupInfo{};
+    startupInfo.cb = sizeof(startupInfo);
+    PROCESS_INFORMATION processInfo{};
+    if (!CreateProcessA(nullptr, &commandLine[0], nullptr, nullptr, TRUE, 0,
+                        &block[0], nullptr, &startupInfo, &processInfo)) {
+        logger() << "[ERROR] Launcher::start: CreateProcess failed(" << GetLastError() << ").[" << program << "]"
+                 << std::endl;
+        return false;
+    }
+    CloseHandle(processInfo.hThread);
+    processHandle = processInfo.hProcess;
+    processId = (long) processInfo.dwProcessId;
+#elif defined(UNIX) || defined(LINUX)
+    std::vector<char *> argv;
+    argv.push_back(const_cast<char *>(program.c_str()));
+    for (auto &argument : arguments) {
+        argv.push_back(const_cast<char *>(argument.c_str()));
+    }
+    argv.push_back(nullptr);
+
+    std::vector<char *> envp;
+    for (auto &entry : envs) {
+        envp.push_back(const_cast<char *>(entry.c_str()));
+    }
+    envp.push_back(nullptr);
+
+    // the child starts with an empty signal mask and default dispositions,
+    // whatever the starter itself blocks or handles
+    posix_spawnattr_t attr;
+    posix_spawnattr_init(&attr);
+    sigset_t signals;
+    sigemptyset(&signals);
+    posix_spawnattr_setsigmask(&attr, &signals);
+    sigaddset(&signals, SIGCHLD);
+    sigaddset(&signals, SIGHUP);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGPIPE);
+    sigaddset(&signals, SIGTERM);
+    posix_spawnattr_setsigdefault(&attr, &signals);
+    posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETSIGMASK | POSIX_SPAWN_SETSIGDEF);
+
+    // stdout and stderr share the write end, the read end is close-on-exec so
+    // later children do not keep it open
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    int pipeFds[2] = {-1, -1};
+    if (capture) {
+        if (0 != pipe2(pipeFds, O_CLOEXEC)) {
+            logger() << "[ERROR] Launcher::start: pipe: " << strerror(errno) << std::endl;
+            posix_spawn_file_actions_destroy(&actions);
+            posix_spawnattr_destroy(&attr);
+            return false;
+        }
+        posix_spawn_file_actions_adddup2(&actions, pipeFds[1], STDOUT_FILENO);
+        posix_spawn_file_actions_adddup2(&actions, pipeFds[1], STDERR_FILENO);
+    }
+
+    // posix_spawn has no attribute for these, the child inherits them from
+    // this thread, so they are set here and restored after the spawn
+    cpu_set_t savedCpus;
+    bool cpusApplied = false;
+    if (!cpus.empty() && 0 == sched_getaffinity(0, sizeof(savedCpus), &savedCpus)) {
+        cpu_set_t cpuSet;
+        CPU_ZERO(&cpuSet);
+        for (int cpu : cpus) {
+            CPU_SET(cpu, &cpuSet);
+        }
+        cpusApplied = 0 == sched_setaffinity(0, sizeof(cpuSet), &cpuSet);
+        if (!cpusApplied) {
+            logger() << "[WARN ] Launcher::start: sched_setaffinity: " << strerror(errno) << std::endl;
+        }
+    }
+    int savedMode = MPOL_DEFAULT;
+    unsigned long savedNodes[1024 / (8 * sizeof(unsigned long))] = {0};
+    const unsigned long maxNode = 8 * sizeof(savedNodes);
+    bool policyApplied = false;
+    if (numaNode >= 0 && numaNode < (int) maxNode &&
+        0 == syscall(SYS_get_mempolicy, &savedMode, savedNodes, maxNode, nullptr, 0)) {
+        unsigned long nodes[1024 / (8 * sizeof(unsigned long))] = {0};
+        nodes[numaNode / (8 * sizeof(unsigned long))] |= 1UL << (numaNode % (8 * sizeof(unsigned long)));
+        // preferred rather than bind, a heap larger than the node must not fail
+        policyApplied = 0 == syscall(SYS_set_mempolicy, MPOL_PREFERRED, nodes, maxNode + 1);
+        if (!policyApplied) {
+            logger() << "[WARN ] Launcher::start: set_mempolicy: " << strerror(errno) << std::endl;
+        }
+    }
+
+    pid_t child;
+    int ret = posix_spawn(&child, program.c_str(), &actions, &attr, argv.data(), envp.data());
+    posix_spawn_file_actions_destroy(&actions);
+    posix_spawnattr_destroy(&attr);
+    if (cpusApplied) {
+        sched_setaffinity(0, sizeof(savedCpus), &savedCpus);
+    }
+    if (policyApplied) {
+        if (savedMode == MPOL_DEFAULT) {
+            syscall(SYS_set_mempolicy, MPOL_DEFAULT, nullptr, 0);
+        } else {
+            syscall(SYS_set_mempolicy, savedMode, savedNodes, maxNode + 1);
+        }
+    }
+    if (capture) {
+        close(pipeFds[1]);
+        if (ret != 0) {
+            close(pipeFds[0]);
+        } else {
+            fcntl(pipeFds[0], F_SETFL, O_NONBLOCK);
+            if (outputFd != -1) {
+                close(outputFd);
+            }
+            outputFd = pipeFds[0];
+        }
+    }
+    if (ret != 0) {
+        logger() << "[ERROR] Launcher::start: posix_spawn failed: " << strerror(ret) << ".[" << program << "]"
+                 << std::endl;
+        return false;
+    }
+    processId = (long) child;
+#endif
+
+    spawnTime = std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - begin).count();
+    status = -1;
+    return true;
+}
+
+int Launcher::wait() {
+    collect(true);
+    return status;
+}
+
+bool Launcher::tryWait() {
+    return collect(false);
+}
+
+bool Launcher::terminate() {
+    if (processId == -1) {
+        return false;
+    }
+#if defined(WINDOWS)
+    return TRUE == TerminateProcess((HANDLE) processHandle, 1);
+#elif defined(UNIX) || defined(LINUX)
+    return 0 == kill((pid_t) processId, SIGTERM);
+#endif
+}
+
+bool Launcher::isRunning() const {
+    return processId != -1;
+}
+
+long Launcher::pid() const {
+    return processId;
+}
+
+int Launcher::exitStatus() const {
+    return status;
+}
+
+long long Launcher::spawnMicros() const {
+    return spawnTime;
+}
+
+std::string Launcher::describe() const {
+    std::string description;
+    for (auto &variable : environment) {
+        description.append(variable.first).append("=").append(quote(variable.second)).append(" ");
+    }
+    description.append(quote(program));
+    for (auto &argument : arguments) {
+        description.append(" ").append(quote(argument));
+    }
+    return description;
+}
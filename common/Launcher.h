@@ -0,0 +1,73 @@
+//
+// Created by arsia on 2026/10/19.
+//
+
+#ifndef APPFRAME_STARTER_LAUNCHER_H
+#define APPFRAME_STARTER_LAUNCHER_H
+
+#include <string>
+#include <utility>
+#include <vector>
+
+/**
+ * Starts a child process from an explicit argv and environment, no shell.
+ *
+ * The child inherits the parent's environment except for the variables set
+ * with setEnvironment(). On Linux posix_spawn returns once the child has
+ * exec'd, so spawnMicros() is the spawn-to-exec latency. tryWait() reaps the
+ * child without blocking and returns true once it has exited.
+ *
+ * With captureOutput(true) the child's stdout and stderr go to a pipe whose
+ * non-blocking read end is handed over by takeOutput() (Linux only).
+ *
+ * setPlacement() pins the child to CPUs and prefers the memory of a NUMA node
+ * (-1 for none). Both are set on the spawning thread around posix_spawn and
+ * restored afterwards, the child inherits them through exec (Linux only).
+ */
+class Launcher
+{
+public:
+    Launcher();
+    ~Launcher();
+
+    Launcher(const Launcher &other) = delete;
+    Launcher &operator=(const Launcher &other) = delete;
+
+    void setProgram(const std::string &path);
+    void addArgument(const std::string &argument);
+    void setEnvironment(const std::string &name, const std::string &value);
+    void clearArguments();
+    void captureOutput(bool capture);
+    int takeOutput();
+    void setPlacement(const std::vector<int> &cpus, int numaNode);
+
+    bool start();
+    int wait();
+    bool tryWait();
+    bool terminate();
+    bool isRunning() const;
+    long pid() const;
+    int exitStatus() const;
+    long long spawnMicros() const;
+    std::string describe() const;
+
+private:
+    std::string program;
+    std::vector<std::string> arguments;
+    std::vector<std::pair<std::string, std::string>> environment;
+    long processId;
+    int status;
+    long long spawnTime;
+    bool capture;
+    int outputFd;
+    std::vector<int> cpus;
+    int numaNode;
+#if defined(WINDOWS)
+    void *processHandle;
+#endif
+
+    std::vector<std::string> buildEnvironment() const;
+    bool collect(bool block);
+};
+
+#endif //APPFRAME_STARTER_LAUNCHER_H
@@ -0,0 +1,509 @@
+#include "LogRetention.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <map>
+#include "Logger.h"
+
+#if defined(UNIX) || defined(LINUX)
+#include <cerrno>
+#include <csignal>
+#include <dirent.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <zlib.h>
+#endif
+
+static const char ARCHIVE_SUFFIX[] = ".gz";
+static const char TEMPORARY_SUFFIX[] = ".gz.tmp";
+
+/* Static */
+#if defined(UNIX) || defined(LINUX)
+struct LogFile {
+    std::string name;
+    long long size;
+    time_t mtime;
+};
+
+static long long monotonicMicros() {
+    struct timespec now{};
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (long long) now.tv_sec * 1000000 + now.tv_nsec / 1000;
+}
+
+static bool endsWith(const std::string &text, const char *suffix) {
+    size_t length = strlen(suffix);
+    return text.size() >= length && 0 == text.compare(text.size() - length, length, suffix);
+}
+
+static bool isLogFile(const std::string &name) {
+    if (endsWith(name, ARCHIVE_SUFFIX) || endsWith(name, TEMPORARY_SUFFIX)) {
+        return false;
+    }
+    return name.find(".log") != std::string::npos || endsWith(name, ".txt") || endsWith(name, ".out");
+}
+
+// the name without its digits, the files of a series only differ in dates and counters
+static std::string seriesOf(const std::string &name) {
+    std::string series;
+    for (char c : name) {
+        if (c < '0' || c > '9') {
+            series.push_back(c);
+        } else if (series.empty() || series.back() != '#') {
+            series.push_back('#');
+        }
+    }
+    return series;
+}
+
+// regular files of a directory
+static bool listFiles(const std::string &directory, std::vector<LogFile> &files) {
+    DIR *dir = opendir(directory.c_str());
+    if (dir == nullptr) {
+        return false;
+    }
+    int dirFd = dirfd(dir);
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != nullptr) {
+        struct stat info{};
+        if (0 != fstatat(dirFd, entry->d_name, &info, AT_SYMLINK_NOFOLLOW) || !S_ISREG(info.st_mode)) {
+            continue;
+        }
+        files.push_back({entry->d_name, (long long) info.st_size, info.st_mtime});
+    }
+    closedir(dir);
+    return true;
+}
+
+// the closed log files: all but the newest of every series
+static void closedFiles(const std::vector<LogFile> &files, std::vector<const LogFile *> &closed,
+                        std::vector<const LogFile *> &open) {
+    std::map<std::string, std::vector<const LogFile *>> series;
+    for (auto &file : files) {
+        if (isLogFile(file.name)) {
+            series[seriesOf(file.name)].push_back(&file);
+        }
+    }
+    for (auto &item : series) {
+        auto newest = std::max_element(item.second.begin(), item.second.end(),
+                                       [](const LogFile *a, const LogFile *b) {
+                                           return a->mtime != b->mtime ? a->mtime < b->mtime : a->name < b->name;
+                                       });
+        for (const LogFile *file : item.second) {
+            (file == *newest ? open : closed).push_back(file);
+        }
+    }
+}
+
+// SCHED_IDLE and the idle IO class for the calling thread
+static void lowerPriority() {
+    struct sched_param param{};
+    if (0 != sched_setscheduler(0, SCHED_IDLE, &param)) {
+        logger() << "[WARN ] LogRetention: sched_setscheduler: " << strerror(errno) << std::endl;
+    }
+    // IOPRIO_WHO_PROCESS, IOPRIO_CLASS_IDLE << IOPRIO_CLASS_SHIFT
+    if (0 != syscall(SYS_ioprio_set, 1, 0, 3 << 13)) {
+        logger() << "[WARN ] LogRetention: ioprio_set: " << strerror(errno) << std::endl;
+    }
+}
+
+static bool writeAll(int fd, const unsigned char *data, size_t size) {
+    while (size > 0) {
+        ssize_t written = write(fd, data, size);
+        if (written == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        data += written;
+        size -= (size_t) written;
+    }
+    return true;
+}
+
+static bool exists(const std::string &path) {
+    struct stat info{};
+    return 0 == lstat(path.c_str(), &info);
+}
+#endif
+
+/* Construct */
+LogRetention::LogRetention(const Policy &policy) : policy(policy), stopping(false) {
+    stopFd = -1;
+    listener = nullptr;
+    listenerContext = nullptr;
+}
+
+LogRetention::~LogRetention() {
+    stop();
+}
+
+/* Private */
+void LogRetention::scan(int channel, std::vector<Job> &jobs) {
+#if defined(UNIX) || defined(LINUX)
+    const Channel &item = *items[channel];
+    std::vector<LogFile> files;
+    if (!listFiles(item.directory, files)) {
+        return;
+    }
+    time_t now = time(nullptr);
+    std::vector<const LogFile *> closed;
+    std::vector<const LogFile *> open;
+    closedFiles(files, closed, open);
+    for (const LogFile *file : closed) {
+        if (now - file->mtime >= policy.maxAgeSeconds) {
+            jobs.push_back({channel, COMPRESS, item.directory + "/" + file->name});
+        }
+    }
+    for (const LogFile *file : open) {
+        if (policy.maxFileSize > 0 && file->size > policy.maxFileSize) {
+            jobs.push_back({channel, ROTATE, item.directory + "/" + file->name});
+        }
+    }
+    // left over by a stopped or crashed compression, nothing runs during a scan
+    for (auto &file : files) {
+        if (endsWith(file.name, TEMPORARY_SUFFIX)) {
+            unlink((item.directory + "/" + file.name).c_str());
+        }
+    }
+#endif
+}
+
+bool LogRetention::compress(const Job &job, Statistics &delta) {
+#if defined(UNIX) || defined(LINUX)
+    int input = open(job.path.c_str(), (job.action == ROTATE ? O_RDWR : O_RDONLY) | O_CLOEXEC);
+    struct stat info{};
+    if (input == -1 || 0 != fstat(input, &info)) {
+        // renamed or deleted by its writer in the meantime
+        if (input != -1) {
+            close(input);
+        }
+        return false;
+    }
+
+    // catalina.2026-10-19.log.gz, a second archive of the same name gets a timestamp
+    std::string target = job.path + ARCHIVE_SUFFIX;
+    if (job.action == ROTATE || exists(target)) {
+        long long stamp = job.action == ROTATE ? (long long) time(nullptr) : (long long) info.st_mtime;
+        target = job.path + "." + std::to_string(stamp) + ARCHIVE_SUFFIX;
+        if (exists(target)) {
+            close(input);
+            return false;
+        }
+    }
+    std::string temporary = target + ".tmp";
+    int output = open(temporary.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (output == -1) {
+        logger() << "[ERROR] LogRetention::compress: create " << temporary << " failed: " << strerror(errno)
+                 << std::endl;
+        close(input);
+        return false;
+    }
+    posix_fadvise(input, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+    z_stream stream{};
+    // 15 + 16: gzip wrapper
+    bool success = Z_OK == deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY);
+    std::unique_ptr<unsigned char[]> in(new unsigned char[BUFFER_SIZE]);
+    std::unique_ptr<unsigned char[]> out(new unsigned char[BUFFER_SIZE]);
+    unsigned long long bytesRead = 0;
+    unsigned long long bytesWritten = 0;
+    long long begin = monotonicMicros();
+    int flush = Z_NO_FLUSH;
+    bool truncated = false;
+    while (success && flush != Z_FINISH) {
+        if (stopping.load(std::memory_order_relaxed)) {
+            success = false;
+            break;
+        }
+        ssize_t readCount = read(input, in.get(), BUFFER_SIZE);
+        if (readCount == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            success = false;
+            break;
+        }
+        // the log is not read again, keep the page cache for the JVMs
+        posix_fadvise(input, (off_t) bytesRead, readCount, POSIX_FADV_DONTNEED);
+        bytesRead += (unsigned long long) readCount;
+        flush = readCount == 0 ? Z_FINISH : Z_NO_FLUSH;
+        // truncate at the end of the data, before the archive is finished and synced: the writers
+        // append, so they continue at the start, and only what they write between the last read
+        // and ftruncate is lost
+        if (readCount == 0 && job.action == ROTATE) {
+            if (0 != ftruncate(input, 0)) {
+                logger() << "[ERROR] LogRetention::compress: truncate " << job.path << " failed: " << strerror(errno)
+                         << std::endl;
+                success = false;
+                break;
+            }
+            truncated = true;
+        }
+        stream.next_in = in.get();
+        stream.avail_in = (uInt) readCount;
+        do {
+            stream.next_out = out.get();
+            stream.avail_out = (uInt) BUFFER_SIZE;
+            if (Z_STREAM_ERROR == deflate(&stream, flush)) {
+                success = false;
+                break;
+            }
+            size_t produced = BUFFER_SIZE - stream.avail_out;
+            if (!writeAll(output, out.get(), produced)) {
+                logger() << "[ERROR] LogRetention::compress: write " << temporary << " failed: " << strerror(errno)
+                         << std::endl;
+                success = false;
+                break;
+            }
+            bytesWritten += produced;
+        } while (stream.avail_out == 0);
+    }
+    deflateEnd(&stream);
+
+    // the archive must be on disk before the log is removed
+    if (success && job.action == COMPRESS) {
+        struct timespec times[2] = {info.st_atim, info.st_mtim};
+        futimens(output, times);
+    }
+    success = success && 0 == fdatasync(output);
+    close(output);
+    // once the log is truncated the archive is all that is left of it, even when incomplete
+    if ((success || truncated) && 0 != rename(temporary.c_str(), target.c_str())) {
+        logger() << "[ERROR] LogRetention::compress: rename " << temporary << " failed: " << strerror(errno)
+                 << std::endl;
+        success = false;
+    }
+    if (!success) {
+        if (!truncated) {
+            unlink(temporary.c_str());
+        }
+        close(input);
+        return false;
+    }
+    if (job.action == ROTATE) {
+        delta.filesRotated++;
+    } else {
+        unlink(job.path.c_str());
+        delta.filesCompressed++;
+    }
+    close(input);
+    delta.bytesRead += bytesRead;
+    delta.bytesWritten += bytesWritten;
+    delta.compressMicros += (unsigned long long) (monotonicMicros() - begin);
+    if (bytesRead > bytesWritten) {
+        delta.bytesReclaimed += bytesRead - bytesWritten;
+    }
+    return true;
+#else
+    return false;
+#endif
+}
+
+void LogRetention::prune(int channel) {
+#if defined(UNIX) || defined(LINUX)
+    if (policy.budgetBytes <= 0) {
+        return;
+    }
+    const Channel &item = *items[channel];
+    std::vector<LogFile> files;
+    if (!listFiles(item.directory, files)) {
+        return;
+    }
+    long long total = 0;
+    for (auto &file : files) {
+        total += file.size;
+    }
+    if (total <= policy.budgetBytes) {
+        return;
+    }
+
+    // archives and closed logs, oldest first; the files being written are never deleted
+    std::vector<const LogFile *> closed;
+    std::vector<const LogFile *> open;
+    closedFiles(files, closed, open);
+    for (auto &file : files) {
+        if (endsWith(file.name, ARCHIVE_SUFFIX)) {
+            closed.push_back(&file);
+        }
+    }
+    std::sort(closed.begin(), closed.end(), [](const LogFile *a, const LogFile *b) {
+        return a->mtime != b->mtime ? a->mtime < b->mtime : a->name < b->name;
+    });
+    Statistics delta{};
+    for (const LogFile *file : closed) {
+        if (total <= policy.budgetBytes) {
+            break;
+        }
+        if (0 == unlink((item.directory + "/" + file->name).c_str())) {
+            total -= file->size;
+            delta.filesDeleted++;
+            delta.bytesReclaimed += (unsigned long long) file->size;
+        }
+    }
+    if (delta.filesDeleted > 0) {
+        record(channel, delta);
+    }
+#endif
+}
+
+void LogRetention::record(int channel, const Statistics &delta) {
+    Channel &item = *items[channel];
+    item.filesCompressed.fetch_add(delta.filesCompressed, std::memory_order_relaxed);
+    item.filesRotated.fetch_add(delta.filesRotated, std::memory_order_relaxed);
+    item.filesDeleted.fetch_add(delta.filesDeleted, std::memory_order_relaxed);
+    item.bytesRead.fetch_add(delta.bytesRead, std::memory_order_relaxed);
+    item.bytesWritten.fetch_add(delta.bytesWritten, std::memory_order_relaxed);
+    item.compressMicros.fetch_add(delta.compressMicros, std::memory_order_relaxed);
+    item.bytesReclaimed.fetch_add(delta.bytesReclaimed, std::memory_order_relaxed);
+    if (listener != nullptr) {
+        listener(channel, delta, listenerContext);
+    }
+}
+
+void LogRetention::loop() {
+#if defined(UNIX) || defined(LINUX)
+    // the pool threads inherit the policy, ioprio_set is per thread on older kernels
+    lowerPriority();
+    struct pollfd descriptor{};
+    descriptor.fd = stopFd;
+    descriptor.events = POLLIN;
+    // the first round right away, the archives of the last run may be due
+    int timeout = 0;
+    while (true) {
+        int ready = poll(&descriptor, 1, timeout);
+        if (ready == -1 && errno != EINTR) {
+            logger() << "[ERROR] LogRetention::loop: poll: " << strerror(errno) << std::endl;
+            break;
+        }
+        if (ready > 0 || stopping.load()) {
+            break;
+        }
+        timeout = policy.intervalSeconds * 1000;
+
+        std::vector<Job> jobs;
+        for (int i = 0; i < (int) items.size(); i++) {
+            scan(i, jobs);
+        }
+        int threads = std::min(policy.threads < 1 ? 1 : policy.threads, (int) jobs.size());
+        std::atomic<size_t> next(0);
+        std::vector<std::thread> workers;
+        for (int i = 0; i < threads; i++) {
+            workers.emplace_back([this, &jobs, &next]() {
+                lowerPriority();
+                size_t index;
+                while ((index = next.fetch_add(1)) < jobs.size() && !stopping.load()) {
+                    Statistics delta{};
+                    if (compress(jobs[index], delta)) {
+                        record(jobs[index].channel, delta);
+                    }
+                }
+            });
+        }
+        for (auto &worker : workers) {
+            worker.join();
+        }
+        if (stopping.load()) {
+            break;
+        }
+        for (int i = 0; i < (int) items.size(); i++) {
+            prune(i);
+        }
+    }
+#endif
+}
+
+/* Public */
+int LogRetention::add(const std::string &name, const std::string &directory) {
+    std::unique_ptr<Channel> channel(new Channel());
+    channel->name = name;
+    channel->directory = directory;
+    channel->filesCompressed.store(0);
+    channel->filesRotated.store(0);
+    channel->filesDeleted.store(0);
+    channel->bytesRead.store(0);
+    channel->bytesWritten.store(0);
+    channel->compressMicros.store(0);
+    channel->bytesReclaimed.store(0);
+    items.push_back(std::move(channel));
+    return (int) items.size() - 1;
+}
+
+void LogRetention::setListener(Listener listener, void *context) {
+    this->listener = listener;
+    this->listenerContext = context;
+}
+
+bool LogRetention::start() {
+#if defined(UNIX) || defined(LINUX)
+    if (policy.intervalSeconds <= 0) {
+        logger() << "[ERROR] LogRetention::start: interval must be positive." << std::endl;
+        return false;
+    }
+    stopFd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (stopFd == -1) {
+        logger() << "[ERROR] LogRetention::start: eventfd: " << strerror(errno) << std::endl;
+        return false;
+    }
+
+    // the thread inherits a fully blocked mask, signals are for the main
+    // thread where a supervisor waits for SIGCHLD
+    sigset_t signals;
+    sigset_t previous;
+    sigfillset(&signals);
+    pthread_sigmask(SIG_BLOCK, &signals, &previous);
+    thread = std::thread(&LogRetention::loop, this);
+    pthread_sigmask(SIG_SETMASK, &previous, nullptr);
+    return true;
+#else
+    logger() << "[ERROR] LogRetention::start: only supported on Linux." << std::endl;
+    return false;
+#endif
+}
+
+void LogRetention::stop() {
+#if defined(UNIX) || defined(LINUX)
+    if (thread.joinable()) {
+        // a compression in progress is abandoned at its next buffer
+        stopping.store(true);
+        uint64_t one = 1;
+        if (write(stopFd, &one, sizeof(one)) != (ssize_t) sizeof(one)) {
+            logger() << "[ERROR] LogRetention::stop: write: " << strerror(errno) << std::endl;
+        }
+        thread.join();
+    }
+    if (stopFd != -1) {
+        close(stopFd);
+        stopFd = -1;
+    }
+#endif
+}
+
+const std::string &LogRetention::name(int channel) const {
+    return items[channel]->name;
+}
+
+LogRetention::Statistics LogRetention::statistics(int channel) const {
+    const Channel &item = *items[channel];
+    Statistics statistics{};
+    statistics.filesCompressed = item.filesCompressed.load();
+    statistics.filesRotated = item.filesRotated.load();
+    statistics.filesDeleted = item.filesDeleted.load();
+    statistics.bytesRead = item.bytesRead.load();
+    statistics.bytesWritten = item.bytesWritten.load();
+    statistics.compressMicros = item.compressMicros.load();
+    statistics.bytesReclaimed = item.bytesReclaimed.load();
+    return statistics;
+}
+
+int LogRetention::channels() const {
+    return (int) items.size();
+}
@@ -0,0 +1,116 @@
+//
+// Created by arsia on 2026/10/19.
+//
+
+#ifndef APPFRAME_STARTER_LOG_RETENTION_H
+#define APPFRAME_STARTER_LOG_RETENTION_H
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * Rotates, compresses and prunes the files of log directories.
+ *
+ * Every interval one thread scans the directories. The *.log* and *.txt
+ * files are grouped into series by their name with the digits left out
+ * (catalina.2026-10-19.log, console.log.3); the newest file of a series is
+ * still being written, the others are closed. Closed files not modified for
+ * maxAgeSeconds are compressed to .gz; a file being written that is larger
+ * than maxFileSize is copied into a .gz and truncated as soon as the copy
+ * reaches its end, before the archive is finished and synced. The writers
+ * must append, as Tomcat does; what they write between the last read and
+ * the truncation, a window of one syscall, is lost.
+ * When a directory is larger than budgetBytes, its oldest archives and
+ * closed files are deleted.
+ *
+ * The files are compressed by a pool of threads under SCHED_IDLE and the
+ * idle IO class, so they only use what the JVMs leave over, streaming
+ * through buffers of BUFFER_SIZE without keeping the logs in the page cache.
+ * Only supported on Linux.
+ */
+class LogRetention
+{
+public:
+    struct Policy {
+        int intervalSeconds;
+        long long maxFileSize;
+        int maxAgeSeconds;
+        long long budgetBytes;
+        int threads;
+    };
+
+    struct Statistics {
+        unsigned long long filesCompressed;
+        unsigned long long filesRotated;
+        unsigned long long filesDeleted;
+        // compression input and output
+        unsigned long long bytesRead;
+        unsigned long long bytesWritten;
+        unsigned long long compressMicros;
+        // compression savings and deleted files
+        unsigned long long bytesReclaimed;
+    };
+
+    // called from the pool after every file with what it changed
+    typedef void (*Listener)(int channel, const Statistics &delta, void *context);
+
+    static const size_t BUFFER_SIZE = 256 * 1024;
+
+    explicit LogRetention(const Policy &policy);
+    ~LogRetention();
+
+    LogRetention(const LogRetention &other) = delete;
+    LogRetention &operator=(const LogRetention &other) = delete;
+
+    // before start()
+    int add(const std::string &name, const std::string &directory);
+    void setListener(Listener listener, void *context);
+    bool start();
+    void stop();
+    const std::string &name(int channel) const;
+    Statistics statistics(int channel) const;
+    int channels() const;
+
+private:
+    enum Action {
+        COMPRESS,
+        ROTATE
+    };
+
+    struct Job {
+        int channel;
+        Action action;
+        std::string path;
+    };
+
+    struct Channel {
+        std::string name;
+        std::string directory;
+        std::atomic<unsigned long long> filesCompressed;
+        std::atomic<unsigned long long> filesRotated;
+        std::atomic<unsigned long long> filesDeleted;
+        std::atomic<unsigned long long> bytesRead;
+        std::atomic<unsigned long long> bytesWritten;
+        std::atomic<unsigned long long> compressMicros;
+        std::atomic<unsigned long long> bytesReclaimed;
+    };
+
+    Policy policy;
+    std::vector<std::unique_ptr<Channel>> items;
+    std::thread thread;
+    std::atomic<bool> stopping;
+    int stopFd;
+    Listener listener;
+    void *listenerContext;
+
+    void scan(int channel, std::vector<Job> &jobs);
+    bool compress(const Job &job, Statistics &delta);
+    void prune(int channel);
+    void record(int channel, const Statistics &delta);
+    void loop();
+};
+
+#endif //APPFRAME_STARTER_LOG_RETENTION_H
@@ -0,0 +1,486 @@
+#include "LogStat.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <climits>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <thread>
+#include "Logger.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#if defined(UNIX) || defined(LINUX)
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+namespace {
+
+// pieces are small enough to balance the workers, large enough to stream
+const size_t MIN_PIECE = 1024 * 1024;
+const char ACCESS_LOG_PREFIX[] = "localhost_access_log";
+const char ACCESS_LOG_SUFFIX[] = ".txt";
+
+struct Piece {
+    const char *begin;
+    const char *end;
+};
+
+struct UrlEntry {
+    uint64_t hash;
+    // nullptr marks a free slot, the URL points into a mapped file
+    const char *url;
+    uint32_t length;
+    unsigned long long requests;
+    unsigned long long bytes;
+};
+
+/**
+ * Open addressing with linear probing, grows at 70% load.
+ */
+class UrlTable
+{
+public:
+    std::vector<UrlEntry> entries;
+    size_t used;
+
+    UrlTable() : entries(1024), used(0) {}
+
+    void add(uint64_t hash, const char *url, uint32_t length,
+             unsigned long long requests, unsigned long long bytes) {
+        if ((used + 1) * 10 > entries.size() * 7) {
+            grow();
+        }
+        size_t mask = entries.size() - 1;
+        size_t index = (size_t) hash & mask;
+        while (true) {
+            UrlEntry &entry = entries[index];
+            if (entry.url == nullptr) {
+                entry = {hash, url, length, requests, bytes};
+                used++;
+                return;
+            }
+            if (entry.hash == hash && entry.length == length && 0 == memcmp(entry.url, url, length)) {
+                entry.requests += requests;
+                entry.bytes += bytes;
+                return;
+            }
+            index = (index + 1) & mask;
+        }
+    }
+
+private:
+    void grow() {
+        std::vector<UrlEntry> previous(entries.size() * 2);
+        previous.swap(entries);
+        used = 0;
+        for (auto &entry : previous) {
+            if (entry.url != nullptr) {
+                add(entry.hash, entry.url, entry.length, entry.requests, entry.bytes);
+            }
+        }
+    }
+};
+
+struct Counts {
+    unsigned long long requests = 0;
+    unsigned long long malformed = 0;
+    unsigned long long bytes = 0;
+    unsigned long long status[600] = {};
+    // requests per second, lines are mostly in time order so runs are counted first
+    std::map<long long, unsigned long long> perSecond;
+    long long runSecond = LLONG_MIN;
+    unsigned long long runRequests = 0;
+    // the last parsed %t, most lines repeat the previous second
+    char timeText[26] = {};
+    long long timeSecond = 0;
+    UrlTable urls;
+
+    void flushRun() {
+        if (runRequests > 0) {
+            perSecond[runSecond] += runRequests;
+        }
+        runRequests = 0;
+    }
+};
+
+uint64_t hashBytes(const char *data, size_t length) {
+    uint64_t hash = 0x9E3779B97F4A7C15ULL ^ length;
+    while (length >= 8) {
+        uint64_t word;
+        memcpy(&word, data, 8);
+        hash = (hash ^ word) * 0xFF51AFD7ED558CCDULL;
+        hash ^= hash >> 32;
+        data += 8;
+        length -= 8;
+    }
+    uint64_t word = 0;
+    memcpy(&word, data, length);
+    hash = (hash ^ word) * 0xC4CEB9FE1A85EC53ULL;
+    return hash ^ (hash >> 29);
+}
+
+inline bool isDigit(char c) {
+    return (unsigned char) (c - '0') < 10;
+}
+
+inline int twoDigits(const char *text) {
+    return (text[0] - '0') * 10 + (text[1] - '0');
+}
+
+int monthIndex(const char *text) {
+    static const char MONTHS[] = "JanFebMarAprMayJunJulAugSepOctNovDec";
+    for (int i = 0; i < 12; i++) {
+        if (0 == memcmp(MONTHS + i * 3, text, 3)) {
+            return i + 1;
+        }
+    }
+    return 0;
+}
+
+// days since 1970-01-01 of a proleptic Gregorian date
+long long daysFromCivil(int year, int month, int day) {
+    year -= month <= 2;
+    long long era = (year >= 0 ? year : year - 399) / 400;
+    long long yearOfEra = year - era * 400;
+    long long dayOfYear = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+    long long dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+    return era * 146097 + dayOfEra - 719468;
+}
+
+// "19/Oct/2026:10:00:00 +0800"
+bool parseTime(const char *text, long long &seconds) {
+    static const int DIGITS[] = {0, 1, 7, 8, 9, 10, 12, 13, 15, 16, 18, 19, 22, 23, 24, 25};
+    for (int position : DIGITS) {
+        if (!isDigit(text[position])) {
+            return false;
+        }
+    }
+    int month = monthIndex(text + 3);
+    if (month == 0) {
+        return false;
+    }
+    int year = twoDigits(text + 7) * 100 + twoDigits(text + 9);
+    long long days = daysFromCivil(year, month, twoDigits(text));
+    long long zone = (twoDigits(text + 22) * 60 + twoDigits(text + 24)) * 60;
+    seconds = days * 86400 + twoDigits(text + 12) * 3600 + twoDigits(text + 15) * 60 + twoDigits(text + 18)
+              - (text[21] == '-' ? -zone : zone);
+    return true;
+}
+
+void countLine(Counts &counts, const char *line, const char *end,
+               const char *bracket, const char *open, const char *close) {
+    if (end > line && end[-1] == '\r') {
+        end--;
+    }
+    if (end == line) {
+        return;
+    }
+    if (bracket == nullptr || open == nullptr || close == nullptr || open < bracket || end - bracket < 28) {
+        counts.malformed++;
+        return;
+    }
+
+    // %t
+    const char *time = bracket + 1;
+    if (0 != memcmp(time, counts.timeText, sizeof(counts.timeText))) {
+        long long second;
+        if (!parseTime(time, second)) {
+            counts.malformed++;
+            return;
+        }
+        memcpy(counts.timeText, time, sizeof(counts.timeText));
+        counts.timeSecond = second;
+    }
+
+    // "%r": method, URL without the query, protocol
+    const char *url = open + 1;
+    const char *space = (const char *) memchr(url, ' ', (size_t) (close - url));
+    if (space != nullptr) {
+        url = space + 1;
+    }
+    const char *urlEnd = (const char *) memchr(url, ' ', (size_t) (close - url));
+    if (urlEnd == nullptr) {
+        urlEnd = close;
+    }
+    const char *query = (const char *) memchr(url, '?', (size_t) (urlEnd - url));
+    if (query != nullptr) {
+        urlEnd = query;
+    }
+
+    // %s %b, %b is "-" for no body
+    const char *field = close + 1;
+    while (field < end && *field == ' ') {
+        field++;
+    }
+    int status = 0;
+    while (field < end && isDigit(*field)) {
+        status = status * 10 + (*field - '0');
+        field++;
+    }
+    while (field < end && *field == ' ') {
+        field++;
+    }
+    unsigned long long bytes = 0;
+    while (field < end && isDigit(*field)) {
+        bytes = bytes * 10 + (unsigned long long) (*field - '0');
+        field++;
+    }
+
+    counts.requests++;
+    counts.bytes += bytes;
+    counts.status[status >= 100 && status < 600 ? status : 0]++;
+    if (counts.timeSecond != counts.runSecond) {
+        counts.flushRun();
+        counts.runSecond = counts.timeSecond;
+    }
+    counts.runRequests++;
+    uint32_t length = (uint32_t) (urlEnd - url);
+    counts.urls.add(hashBytes(url, length), url, length, 1, bytes);
+}
+
+/**
+ * Boundaries of the current line: the first '[' (%t) and the first two '"' (%r).
+ */
+struct LineScanner {
+    Counts &counts;
+    const char *line;
+    const char *bracket;
+    const char *open;
+    const char *close;
+
+    LineScanner(Counts &counts, const char *begin) : counts(counts), line(begin) {
+        bracket = nullptr;
+        open = nullptr;
+        close = nullptr;
+    }
+
+    inline void mark(const char *at) {
+        switch (*at) {
+            case '\n':
+                countLine(counts, line, at, bracket, open, close);
+                line = at + 1;
+                bracket = nullptr;
+                open = nullptr;
+                close = nullptr;
+                break;
+            case '[':
+                if (bracket == nullptr) {
+                    bracket = at;
+                }
+                break;
+            default:
+                if (open == nullptr) {
+                    open = at;
+                } else if (close == nullptr) {
+                    close = at;
+                }
+        }
+    }
+};
+
+void scan(const Piece &piece, Counts &counts) {
+    LineScanner scanner(counts, piece.begin);
+    const char *p = piece.begin;
+#if defined(__SSE2__)
+    const __m128i newline = _mm_set1_epi8('\n');
+    const __m128i bracket = _mm_set1_epi8('[');
+    const __m128i quote = _mm_set1_epi8('"');
+    while (piece.end - p >= 16) {
+        __m128i block = _mm_loadu_si128((const __m128i *) p);
+        __m128i found = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(block, newline), _mm_cmpeq_epi8(block, bracket)),
+                                     _mm_cmpeq_epi8(block, quote));
+        unsigned mask = (unsigned) _mm_movemask_epi8(found);
+        while (mask != 0) {
+            scanner.mark(p + __builtin_ctz(mask));
+            mask &= mask - 1;
+        }
+        p += 16;
+    }
+#endif
+    for (; p < piece.end; p++) {
+        if (*p == '\n' || *p == '[' || *p == '"') {
+            scanner.mark(p);
+        }
+    }
+    // the last line of a file without a trailing newline
+    if (scanner.line < piece.end) {
+        countLine(counts, scanner.line, piece.end, scanner.bracket, scanner.open, scanner.close);
+    }
+    counts.flushRun();
+}
+
+}
+
+/* Public */
+std::vector<std::string> LogStat::accessLogs(const std::string &directory) {
+    std::vector<std::string> files;
+#if defined(UNIX) || defined(LINUX)
+    DIR *dir = opendir(directory.c_str());
+    if (dir == nullptr) {
+        return files;
+    }
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != nullptr) {
+        size_t length = strlen(entry->d_name);
+        size_t suffixLength = sizeof(ACCESS_LOG_SUFFIX) - 1;
+        if (0 == strncmp(entry->d_name, ACCESS_LOG_PREFIX, sizeof(ACCESS_LOG_PREFIX) - 1) &&
+            length > suffixLength && 0 == strcmp(entry->d_name + length - suffixLength, ACCESS_LOG_SUFFIX)) {
+            files.push_back(directory + "/" + entry->d_name);
+        }
+    }
+    closedir(dir);
+    std::sort(files.begin(), files.end());
+#endif
+    return files;
+}
+
+bool LogStat::run(const std::vector<std::string> &files, int threads, size_t top, Result &result) {
+#if defined(UNIX) || defined(LINUX)
+    auto begin = std::chrono::steady_clock::now();
+    memset(result.status, 0, sizeof(result.status));
+    result.files = 0;
+    result.fileBytes = 0;
+    result.top.clear();
+
+    std::vector<std::pair<void *, size_t>> mappings;
+    std::vector<Piece> pieces;
+    for (auto &path : files) {
+        int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        struct stat status{};
+        if (fd == -1 || 0 != fstat(fd, &status)) {
+            logger() << "[ERROR] LogStat::run: open " << path << " failed: " << strerror(errno) << std::endl;
+            if (fd != -1) {
+                close(fd);
+            }
+            continue;
+        }
+        size_t size = (size_t) status.st_size;
+        void *address = size == 0 ? MAP_FAILED : mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        result.files++;
+        if (address == MAP_FAILED) {
+            continue;
+        }
+        madvise(address, size, MADV_SEQUENTIAL);
+        mappings.emplace_back(address, size);
+        result.fileBytes += size;
+    }
+
+    // cut at line boundaries, several pieces per thread so the workers finish together
+    if (threads < 1) {
+        threads = 1;
+    }
+    size_t pieceSize = std::max(MIN_PIECE, (size_t) (result.fileBytes / ((unsigned long long) threads * 8) + 1));
+    for (auto &mapping : mappings) {
+        const char *p = (const char *) mapping.first;
+        const char *end = p + mapping.second;
+        while (p < end) {
+            const char *cut = end - p > (long) pieceSize ? p + pieceSize : end;
+            if (cut < end) {
+                cut = (const char *) memchr(cut, '\n', (size_t) (end - cut));
+                cut = cut == nullptr ? end : cut + 1;
+            }
+            pieces.push_back({p, cut});
+            p = cut;
+        }
+    }
+    if (threads > (int) pieces.size()) {
+        threads = pieces.empty() ? 1 : (int) pieces.size();
+    }
+
+    std::vector<std::unique_ptr<Counts>> counts;
+    for (int i = 0; i < threads; i++) {
+        counts.emplace_back(new Counts());
+    }
+    std::atomic<size_t> next(0);
+    auto work = [&pieces, &next](Counts *own) {
+        size_t index;
+        while ((index = next.fetch_add(1)) < pieces.size()) {
+            scan(pieces[index], *own);
+        }
+    };
+    std::vector<std::thread> workers;
+    for (int i = 1; i < threads; i++) {
+        workers.emplace_back(work, counts[i].get());
+    }
+    work(counts[0].get());
+    for (auto &worker : workers) {
+        worker.join();
+    }
+
+    // merge into the first worker's tables
+    Counts &merged = *counts[0];
+    for (int i = 1; i < threads; i++) {
+        Counts &other = *counts[i];
+        merged.requests += other.requests;
+        merged.malformed += other.malformed;
+        merged.bytes += other.bytes;
+        for (int code = 0; code < 600; code++) {
+            merged.status[code] += other.status[code];
+        }
+        for (auto &second : other.perSecond) {
+            merged.perSecond[second.first] += second.second;
+        }
+        for (auto &entry : other.urls.entries) {
+            if (entry.url != nullptr) {
+                merged.urls.add(entry.hash, entry.url, entry.length, entry.requests, entry.bytes);
+            }
+        }
+    }
+
+    result.requests = merged.requests;
+    result.malformed = merged.malformed;
+    result.bytes = merged.bytes;
+    memcpy(result.status, merged.status, sizeof(result.status));
+    result.firstSecond = merged.perSecond.empty() ? 0 : merged.perSecond.begin()->first;
+    result.lastSecond = merged.perSecond.empty() ? 0 : merged.perSecond.rbegin()->first;
+    result.peakSecond = 0;
+    result.peakRequests = 0;
+    for (auto &second : merged.perSecond) {
+        if (second.second > result.peakRequests) {
+            result.peakSecond = second.first;
+            result.peakRequests = second.second;
+        }
+    }
+
+    std::vector<const UrlEntry *> urls;
+    urls.reserve(merged.urls.used);
+    for (auto &entry : merged.urls.entries) {
+        if (entry.url != nullptr) {
+            urls.push_back(&entry);
+        }
+    }
+    result.urls = urls.size();
+    size_t shown = std::min(top, urls.size());
+    std::partial_sort(urls.begin(), urls.begin() + (long) shown, urls.end(),
+                      [](const UrlEntry *a, const UrlEntry *b) {
+                          return a->requests != b->requests ? a->requests > b->requests : a->bytes > b->bytes;
+                      });
+    for (size_t i = 0; i < shown; i++) {
+        // copied before the files are unmapped
+        result.top.push_back({std::string(urls[i]->url, urls[i]->length), urls[i]->requests, urls[i]->bytes});
+    }
+
+    for (auto &mapping : mappings) {
+        munmap(mapping.first, mapping.second);
+    }
+    result.threads = threads;
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+    return true;
+#else
+    logger() << "[ERROR] LogStat::run: only supported on Linux." << std::endl;
+    return false;
+#endif
+}
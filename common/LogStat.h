@@ -0,0 +1,54 @@
+//
+// Created by arsia on 2026/10/19.
+//
+
+#ifndef APPFRAME_STARTER_LOG_STAT_H
+#define APPFRAME_STARTER_LOG_STAT_H
+
+#include <string>
+#include <vector>
+
+/**
+ * Aggregates access logs written with the pattern %h %l %u %t "%r" %s %b.
+ *
+ * The files are memory-mapped and cut into pieces at line boundaries, the
+ * pieces are taken by worker threads. A worker finds the line, '[' and '"'
+ * boundaries 16 bytes at a time (SSE2, a byte loop elsewhere) and counts into
+ * its own tables; the URL table points into the mapped files, so nothing is
+ * copied until the tables are merged at the end. URLs are counted without
+ * the query string. Only supported on Linux.
+ */
+class LogStat
+{
+public:
+    struct Url {
+        std::string url;
+        unsigned long long requests;
+        unsigned long long bytes;
+    };
+
+    struct Result {
+        unsigned long long files;
+        unsigned long long fileBytes;
+        unsigned long long requests;
+        unsigned long long malformed;
+        unsigned long long bytes;
+        // by status code, 0 for codes outside 100-599
+        unsigned long long status[600];
+        // unix seconds of the first and last request
+        long long firstSecond;
+        long long lastSecond;
+        long long peakSecond;
+        unsigned long long peakRequests;
+        unsigned long long urls;
+        std::vector<Url> top;
+        int threads;
+        double seconds;
+    };
+
+    // localhost_access_log*.txt in a logs directory, sorted by name
+    static std::vector<std::string> accessLogs(const std::string &directory);
+    static bool run(const std::vector<std::string> &files, int threads, size_t top, Result &result);
+};
+
+#endif //APPFRAME_STARTER_LOG_STAT_H
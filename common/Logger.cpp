@@ -0,0 +1,9 @@
+#include "Logger.h"
+
+#include <iostream>
+
+thread_local std::ostream *logStream = &std::cout;
+
+std::ostream &logger() {
+    return *logStream;
+}
@@ -0,0 +1,19 @@
+//
+// Created by arsia on 2026/10/19.
+//
+
+#ifndef APPFRAME_STARTER_LOGGER_H
+#define APPFRAME_STARTER_LOGGER_H
+
+#include <ostream>
+
+/**
+ * Log output of the current thread, std::cout unless the thread redirects
+ * it. Lines start with a level tag ("[INFO ] ", "[WARN ] ", "[ERROR] ",
+ * "[DEBUG] ") and end with std::endl, which flushes them.
+ */
+extern thread_local std::ostream *logStream;
+
+std::ostream &logger();
+
+#endif //APPFRAME_STARTER_LOGGER_H
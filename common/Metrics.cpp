@@ -0,0 +1,308 @@
+#include "Metrics.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include "Logger.h"
+
+#if defined(UNIX) || defined(LINUX)
+#include <cerrno>
+#include <csignal>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+// a scrape is one small request, anything larger is not a scraper
+static const size_t MAX_REQUEST = 8192;
+static const size_t MAX_CONNECTIONS = 64;
+static const long long CONNECTION_TIMEOUT_MICROS = 5000000;
+
+/* Static */
+static std::string httpResponse(const char *status, const char *contentType, const std::string &body, bool head) {
+    std::string response;
+    response.reserve(body.size() + 160);
+    response.append("HTTP/1.1 ").append(status).append("\r\n");
+    response.append("Content-Type: ").append(contentType).append("\r\n");
+    response.append("Content-Length: ").append(std::to_string(body.size())).append("\r\n");
+    response.append("Connection: close\r\n\r\n");
+    if (!head) {
+        response.append(body);
+    }
+    return response;
+}
+
+/* Construct */
+Metrics::Metrics() {
+    listenFd = -1;
+    stopFd = -1;
+    epollFd = -1;
+}
+
+Metrics::~Metrics() {
+    stop();
+}
+
+/* Private */
+void Metrics::serve() {
+#if defined(UNIX) || defined(LINUX)
+    std::map<int, Connection> connections;
+    struct epoll_event events[16];
+    while (true) {
+        int count = epoll_wait(epollFd, events, 16, 1000);
+        if (count == -1 && errno != EINTR) {
+            logger() << "[ERROR] Metrics::serve: epoll_wait: " << strerror(errno) << std::endl;
+            break;
+        }
+        long long current = now();
+        for (int i = 0; i < count; i++) {
+            int fd = events[i].data.fd;
+            if (fd == stopFd) {
+                for (auto &connection : connections) {
+                    close(connection.first);
+                }
+                return;
+            }
+
+            if (fd == listenFd) {
+                int client;
+                while ((client = accept4(listenFd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC)) != -1) {
+                    if (connections.size() >= MAX_CONNECTIONS) {
+                        close(client);
+                        continue;
+                    }
+                    struct epoll_event event{};
+                    event.events = EPOLLIN | EPOLLRDHUP;
+                    event.data.fd = client;
+                    epoll_ctl(epollFd, EPOLL_CTL_ADD, client, &event);
+                    Connection &connection = connections[client];
+                    connection.sent = 0;
+                    connection.acceptedAt = current;
+                }
+                continue;
+            }
+
+            auto found = connections.find(fd);
+            if (found == connections.end()) {
+                continue;
+            }
+            Connection &connection = found->second;
+            bool done = (events[i].events & (EPOLLERR | EPOLLHUP)) != 0;
+            if (!done && connection.response.empty() && (events[i].events & (EPOLLIN | EPOLLRDHUP))) {
+                char buffer[2048];
+                ssize_t readCount;
+                while ((readCount = read(fd, buffer, sizeof(buffer))) > 0) {
+                    connection.request.append(buffer, (size_t) readCount);
+                    if (connection.request.size() > MAX_REQUEST) {
+                        break;
+                    }
+                }
+                if (connection.request.find("\r\n\r\n") != std::string::npos ||
+                    connection.request.size() > MAX_REQUEST) {
+                    connection.response = respond(connection.request);
+                    struct epoll_event event{};
+                    event.events = EPOLLOUT;
+                    event.data.fd = fd;
+                    epoll_ctl(epollFd, EPOLL_CTL_MOD, fd, &event);
+                } else if (readCount == 0 || (readCount == -1 && errno != EAGAIN)) {
+                    // closed before the request was complete
+                    done = true;
+                }
+            }
+            if (!done && !connection.response.empty()) {
+                ssize_t written = send(fd, connection.response.data() + connection.sent,
+                                       connection.response.size() - connection.sent, MSG_NOSIGNAL);
+                if (written > 0) {
+                    connection.sent += (size_t) written;
+                }
+                done = connection.sent == connection.response.size() || (written == -1 && errno != EAGAIN);
+            }
+            if (done) {
+                close(fd);
+                connections.erase(found);
+            }
+        }
+
+        // slow or idle clients must not use up the connections
+        for (auto it = connections.begin(); it != connections.end();) {
+            if (current - it->second.acceptedAt > CONNECTION_TIMEOUT_MICROS) {
+                close(it->first);
+                it = connections.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+#endif
+}
+
+std::string Metrics::respond(const std::string &request) const {
+    // METHOD SP PATH SP VERSION
+    size_t methodEnd = request.find(' ');
+    size_t pathEnd = methodEnd == std::string::npos ? std::string::npos : request.find(' ', methodEnd + 1);
+    if (pathEnd == std::string::npos) {
+        return httpResponse("400 Bad Request", "text/plain", "bad request\n", false);
+    }
+    std::string method = request.substr(0, methodEnd);
+    std::string path = request.substr(methodEnd + 1, pathEnd - methodEnd - 1);
+    path = path.substr(0, path.find('?'));
+    if (method != "GET" && method != "HEAD") {
+        return httpResponse("405 Method Not Allowed", "text/plain", "method not allowed\n", false);
+    }
+    if (path != "/metrics") {
+        return httpResponse("404 Not Found", "text/plain", "not found, see /metrics\n", method == "HEAD");
+    }
+    return httpResponse("200 OK", "text/plain; version=0.0.4; charset=utf-8", render(), method == "HEAD");
+}
+
+/* Public */
+Metrics::Value *Metrics::add(const std::string &name, const std::string &help, Type type,
+                             const std::string &labels, long long divisor) {
+    std::unique_ptr<Series> item(new Series());
+    item->name = name;
+    item->help = help;
+    item->labels = labels;
+    item->type = type;
+    item->divisor = divisor < 1 ? 1 : divisor;
+    item->value.store(0);
+    series.push_back(std::move(item));
+    return &series.back()->value;
+}
+
+bool Metrics::start(const std::string &host, int port) {
+#if defined(UNIX) || defined(LINUX)
+    // families in the order of their first series
+    std::map<std::string, size_t> first;
+    for (size_t i = 0; i < series.size(); i++) {
+        first.emplace(series[i]->name, i);
+        order.push_back(i);
+    }
+    std::stable_sort(order.begin(), order.end(), [this, &first](size_t a, size_t b) {
+        return first[series[a]->name] < first[series[b]->name];
+    });
+
+    struct sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_port = htons((uint16_t) port);
+    if (1 != inet_pton(AF_INET, host.c_str(), &address.sin_addr)) {
+        logger() << "[ERROR] Metrics::start: not an IPv4 address: " << host << std::endl;
+        return false;
+    }
+    listenFd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (listenFd == -1) {
+        logger() << "[ERROR] Metrics::start: socket: " << strerror(errno) << std::endl;
+        return false;
+    }
+    int reuse = 1;
+    setsockopt(listenFd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+    if (0 != bind(listenFd, (struct sockaddr *) &address, sizeof(address)) || 0 != listen(listenFd, 16)) {
+        logger() << "[ERROR] Metrics::start: listen on " << host << ":" << port << " failed: " << strerror(errno)
+                 << std::endl;
+        close(listenFd);
+        listenFd = -1;
+        return false;
+    }
+
+    epollFd = epoll_create1(EPOLL_CLOEXEC);
+    stopFd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (epollFd == -1 || stopFd == -1) {
+        logger() << "[ERROR] Metrics::start: create descriptors: " << strerror(errno) << std::endl;
+        return false;
+    }
+    struct epoll_event event{};
+    event.events = EPOLLIN;
+    event.data.fd = listenFd;
+    epoll_ctl(epollFd, EPOLL_CTL_ADD, listenFd, &event);
+    event.data.fd = stopFd;
+    epoll_ctl(epollFd, EPOLL_CTL_ADD, stopFd, &event);
+
+    // the thread inherits a fully blocked mask, signals are for the main
+    // thread where a supervisor waits for SIGCHLD
+    sigset_t signals;
+    sigset_t previous;
+    sigfillset(&signals);
+    pthread_sigmask(SIG_BLOCK, &signals, &previous);
+    thread = std::thread(&Metrics::serve, this);
+    pthread_sigmask(SIG_SETMASK, &previous, nullptr);
+    return true;
+#else
+    logger() << "[ERROR] Metrics::start: only supported on Linux." << std::endl;
+    return false;
+#endif
+}
+
+void Metrics::stop() {
+#if defined(UNIX) || defined(LINUX)
+    if (thread.joinable()) {
+        uint64_t one = 1;
+        if (write(stopFd, &one, sizeof(one)) != (ssize_t) sizeof(one)) {
+            logger() << "[ERROR] Metrics::stop: write: " << strerror(errno) << std::endl;
+        }
+        thread.join();
+    }
+    for (int *fd : {&listenFd, &stopFd, &epollFd}) {
+        if (*fd != -1) {
+            close(*fd);
+            *fd = -1;
+        }
+    }
+#endif
+}
+
+std::string Metrics::render() const {
+    std::string output;
+    output.reserve(order.size() * 96);
+    long long current = now();
+    const std::string *family = nullptr;
+    char number[64];
+    for (size_t index : order) {
+        const Series &item = *series[index];
+        if (family == nullptr || *family != item.name) {
+            family = &item.name;
+            output.append("# HELP ").append(item.name).append(" ").append(item.help).append("\n");
+            output.append("# TYPE ").append(item.name).append(item.type == COUNTER ? " counter\n" : " gauge\n");
+        }
+        long long value = item.value.load(std::memory_order_relaxed);
+        if (item.type == ELAPSED) {
+            value = value == 0 ? 0 : current - value;
+        }
+        if (item.divisor == 1) {
+            snprintf(number, sizeof(number), "%lld", value);
+        } else {
+            snprintf(number, sizeof(number), "%.6f", (double) value / (double) item.divisor);
+        }
+        output.append(item.name);
+        if (!item.labels.empty()) {
+            output.append("{").append(item.labels).append("}");
+        }
+        output.append(" ").append(number).append("\n");
+    }
+    return output;
+}
+
+std::string Metrics::label(const char *name, const std::string &value) {
+    std::string result = name;
+    result.append("=\"");
+    for (char c : value) {
+        if (c == '\\' || c == '"') {
+            result.push_back('\\');
+            result.push_back(c);
+        } else if (c == '\n') {
+            result.append("\\n");
+        } else {
+            result.push_back(c);
+        }
+    }
+    result.push_back('"');
+    return result;
+}
+
+long long Metrics::now() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+}
@@ -0,0 +1,125 @@
+//
+// Created by arsia on 2026/10/19.
+//
+
+#ifndef APPFRAME_STARTER_METRICS_H
+#define APPFRAME_STARTER_METRICS_H
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * Metrics in the Prometheus text format, served on GET /metrics.
+ *
+ * Every series is registered with add() before start() and is a single
+ * atomic afterwards: the starter updates it with relaxed stores, and a scrape
+ * only loads the atomics, so it never takes a lock the launch path could wait
+ * on. start() serves the endpoint from one thread sleeping in epoll.
+ * A series is rendered as value / divisor; an ELAPSED series holds a now()
+ * timestamp and is rendered as the time since then (0 when the value is 0).
+ * Only supported on Linux.
+ */
+class Metrics
+{
+public:
+    typedef std::atomic<long long> Value;
+
+    enum Type {
+        COUNTER,
+        GAUGE,
+        ELAPSED
+    };
+
+    class Timer;
+
+    Metrics();
+    ~Metrics();
+
+    Metrics(const Metrics &other) = delete;
+    Metrics &operator=(const Metrics &other) = delete;
+
+    // labels in the exposition format, e.g. label("region", name)
+    Value *add(const std::string &name, const std::string &help, Type type,
+               const std::string &labels, long long divisor);
+    bool start(const std::string &host, int port);
+    void stop();
+    std::string render() const;
+
+    static std::string label(const char *name, const std::string &value);
+    // monotonic microseconds
+    static long long now();
+
+    static void count(Value *value, long long delta) {
+        if (value != nullptr) {
+            value->fetch_add(delta, std::memory_order_relaxed);
+        }
+    }
+
+    static void set(Value *value, long long number) {
+        if (value != nullptr) {
+            value->store(number, std::memory_order_relaxed);
+        }
+    }
+
+private:
+    struct Series {
+        std::string name;
+        std::string help;
+        std::string labels;
+        Type type;
+        long long divisor;
+        Value value;
+    };
+
+    struct Connection {
+        std::string request;
+        std::string response;
+        size_t sent;
+        long long acceptedAt;
+    };
+
+    std::vector<std::unique_ptr<Series>> series;
+    // series grouped by name, a family must not be split
+    std::vector<size_t> order;
+    std::thread thread;
+    int listenFd;
+    int stopFd;
+    int epollFd;
+
+    void serve();
+    std::string respond(const std::string &request) const;
+};
+
+/**
+ * Stores the microseconds between construction and destruction, or end().
+ */
+class Metrics::Timer
+{
+public:
+    explicit Timer(Value *value) : value(value) {
+        begin = value != nullptr ? Metrics::now() : -1;
+    }
+
+    ~Timer() {
+        end();
+    }
+
+    void end() {
+        if (begin >= 0) {
+            Metrics::set(value, Metrics::now() - begin);
+            begin = -1;
+        }
+    }
+
+    Timer(const Timer &other) = delete;
+    Timer &operator=(const Timer &other) = delete;
+
+private:
+    Value *value;
+    long long begin;
+};
+
+#endif //APPFRAME_STARTER_METRICS_H
@@ -0,0 +1,136 @@
+#include "Placement.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#if defined(UNIX) || defined(LINUX)
+#include <sched.h>
+#endif
+
+/* Static */
+static bool readLine(const std::string &path, std::string &line) {
+    FILE *file = fopen(path.c_str(), "r");
+    if (file == nullptr) {
+        return false;
+    }
+    char buffer[4096];
+    bool success = fgets(buffer, sizeof(buffer), file) != nullptr;
+    fclose(file);
+    if (success) {
+        line = buffer;
+        while (!line.empty() && (line.back() == '\n' || line.back() == '\r')) {
+            line.pop_back();
+        }
+    }
+    return success;
+}
+
+/* Public */
+std::vector<Placement::Node> Placement::nodes() {
+    std::vector<Node> result;
+#if defined(UNIX) || defined(LINUX)
+    std::vector<int> allowed = allowedCpus();
+    std::string online;
+    std::vector<int> ids;
+    if (!readLine("/sys/devices/system/node/online", online) || !parseCpuList(online, ids)) {
+        Node node;
+        node.id = 0;
+        node.cpus = allowed;
+        result.push_back(node);
+        return result;
+    }
+    for (int id : ids) {
+        std::string list;
+        std::vector<int> cpus;
+        if (!readLine("/sys/devices/system/node/node" + std::to_string(id) + "/cpulist", list)) {
+            continue;
+        }
+        // an empty list is a memory only node
+        parseCpuList(list, cpus);
+        Node node;
+        node.id = id;
+        for (int cpu : cpus) {
+            if (std::binary_search(allowed.begin(), allowed.end(), cpu)) {
+                node.cpus.push_back(cpu);
+            }
+        }
+        if (!node.cpus.empty()) {
+            result.push_back(node);
+        }
+    }
+#endif
+    return result;
+}
+
+std::vector<int> Placement::allowedCpus() {
+    std::vector<int> cpus;
+#if defined(UNIX) || defined(LINUX)
+    cpu_set_t cpuSet;
+    CPU_ZERO(&cpuSet);
+    if (0 == sched_getaffinity(0, sizeof(cpuSet), &cpuSet)) {
+        for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+            if (CPU_ISSET(cpu, &cpuSet)) {
+                cpus.push_back(cpu);
+            }
+        }
+    }
+#endif
+    return cpus;
+}
+
+bool Placement::parseCpuList(const std::string &list, std::vector<int> &cpus) {
+    cpus.clear();
+    const char *current = list.c_str();
+    while (*current != '\0') {
+        char *end = nullptr;
+        long first = strtol(current, &end, 10);
+        if (end == current || first < 0) {
+            return false;
+        }
+        long last = first;
+        if (*end == '-') {
+            current = end + 1;
+            last = strtol(current, &end, 10);
+            if (end == current || last < first) {
+                return false;
+            }
+        }
+        if (last >= 4096) {
+            return false;
+        }
+        for (long cpu = first; cpu <= last; cpu++) {
+            cpus.push_back((int) cpu);
+        }
+        if (*end == ',') {
+            end++;
+        } else if (*end != '\0') {
+            return false;
+        }
+        current = end;
+    }
+    std::sort(cpus.begin(), cpus.end());
+    cpus.erase(std::unique(cpus.begin(), cpus.end()), cpus.end());
+    return !cpus.empty();
+}
+
+std::string Placement::formatCpuList(const std::vector<int> &cpus) {
+    std::string list;
+    size_t i = 0;
+    while (i < cpus.size()) {
+        size_t j = i;
+        while (j + 1 < cpus.size() && cpus[j + 1] == cpus[j] + 1) {
+            j++;
+        }
+        if (!list.empty()) {
+            list.push_back(',');
+        }
+        list.append(std::to_string(cpus[i]));
+        if (j > i) {
+            list.append("-").append(std::to_string(cpus[j]));
+        }
+        i = j + 1;
+    }
+    return list;
+}
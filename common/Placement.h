@@ -0,0 +1,33 @@
+//
+// Created by arsia on 2026/10/19.
+//
+
+#ifndef APPFRAME_STARTER_PLACEMENT_H
+#define APPFRAME_STARTER_PLACEMENT_H
+
+#include <string>
+#include <vector>
+
+/**
+ * NUMA topology and CPU lists for placing regions.
+ *
+ * nodes() reads the online NUMA nodes and their CPUs from sysfs, limited to
+ * the CPUs the starter may run on; a host without NUMA information is one
+ * node 0. CPU lists use the kernel format ("0-3,8,10-11"). Only supported on
+ * Linux, nodes() is empty elsewhere.
+ */
+class Placement
+{
+public:
+    struct Node {
+        int id;
+        std::vector<int> cpus;
+    };
+
+    static std::vector<Node> nodes();
+    static std::vector<int> allowedCpus();
+    static bool parseCpuList(const std::string &list, std::vector<int> &cpus);
+    static std::string formatCpuList(const std::vector<int> &cpus);
+};
+
+#endif //APPFRAME_STARTER_PLACEMENT_H
@@ -0,0 +1,92 @@
+#include "PortPlanner.h"
+
+#include <cstdlib>
+
+#if defined(UNIX) || defined(LINUX)
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+/* Construct */
+PortPlanner::PortPlanner(int first, int last) {
+    this->first = first;
+    this->last = last;
+    next = first;
+}
+
+/* Public */
+bool PortPlanner::reserve(int port, const std::string &owner) {
+    auto found = owners.find(port);
+    if (found != owners.end()) {
+        return found->second == owner;
+    }
+    owners[port] = owner;
+    return true;
+}
+
+const std::string *PortPlanner::owner(int port) const {
+    auto found = owners.find(port);
+    return found == owners.end() ? nullptr : &found->second;
+}
+
+int PortPlanner::allocate(const std::string &owner, bool probe) {
+    if (first <= 0 || last < first) {
+        return -1;
+    }
+    // continue after the last allocation, so one plan does not probe the
+    // same used ports again
+    int count = last - first + 1;
+    for (int i = 0; i < count; i++) {
+        int port = first + (next - first + i) % count;
+        if (owners.find(port) != owners.end()) {
+            continue;
+        }
+        if (probe && !bindable(port)) {
+            continue;
+        }
+        owners[port] = owner;
+        next = port + 1;
+        return port;
+    }
+    return -1;
+}
+
+int PortPlanner::reserved() const {
+    return (int) owners.size();
+}
+
+bool PortPlanner::bindable(int port) {
+#if defined(UNIX) || defined(LINUX)
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd == -1) {
+        return false;
+    }
+    int reuse = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+    struct sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_port = htons((uint16_t) port);
+    address.sin_addr.s_addr = htonl(INADDR_ANY);
+    bool success = 0 == bind(fd, (struct sockaddr *) &address, sizeof(address));
+    close(fd);
+    return success;
+#else
+    // not probed on Windows, Tomcat reports the bind failure
+    return true;
+#endif
+}
+
+bool PortPlanner::parsePort(const std::string &value, int &port) {
+    if (value.empty()) {
+        return false;
+    }
+    char *end = nullptr;
+    long parsed = strtol(value.c_str(), &end, 10);
+    if (*end != '\0' || parsed <= 0 || parsed > 65535) {
+        return false;
+    }
+    port = (int) parsed;
+    return true;
+}
@@ -0,0 +1,40 @@
+//
+// Created by arsia on 2026/10/19.
+//
+
+#ifndef APPFRAME_STARTER_PORTPLANNER_H
+#define APPFRAME_STARTER_PORTPLANNER_H
+
+#include <map>
+#include <string>
+
+/**
+ * Keeps track of which port belongs to whom and hands out free ports.
+ *
+ * reserve() records a port for an owner (e.g. "r1.http.port") and fails when
+ * another owner already has it. allocate() reserves the next port of the
+ * range that nobody owns and, when probing, that can be bound right now.
+ * bindable() binds the wildcard address with SO_REUSEADDR like Tomcat does,
+ * so sockets in TIME_WAIT do not count as used.
+ */
+class PortPlanner
+{
+public:
+    PortPlanner(int first, int last);
+
+    bool reserve(int port, const std::string &owner);
+    const std::string *owner(int port) const;
+    int allocate(const std::string &owner, bool probe);
+    int reserved() const;
+
+    static bool bindable(int port);
+    static bool parsePort(const std::string &value, int &port);
+
+private:
+    int first;
+    int last;
+    int next;
+    std::map<int, std::string> owners;
+};
+
+#endif //APPFRAME_STARTER_PORTPLANNER_H
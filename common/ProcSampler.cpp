@@ -0,0 +1,386 @@
+#include "ProcSampler.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include "Logger.h"
+
+#if defined(UNIX) || defined(LINUX)
+#include <cerrno>
+#include <csignal>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/timerfd.h>
+#endif
+
+static const char SAMPLE_MAGIC[8] = {'A', 'F', 'S', 'A', 'M', 'P', 'L', 'E'};
+static const uint32_t SAMPLE_VERSION = 1;
+
+static_assert(sizeof(ProcSampler::Sample) == 64, "the sample file layout changed");
+static_assert(sizeof(ProcSampler::Header) == 64, "the sample file layout changed");
+
+/* Static */
+#if defined(UNIX) || defined(LINUX)
+static long long monotonicMicros() {
+    struct timespec now{};
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (long long) now.tv_sec * 1000000 + now.tv_nsec / 1000;
+}
+
+static long long realtimeMillis() {
+    struct timespec now{};
+    clock_gettime(CLOCK_REALTIME, &now);
+    return (long long) now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+// the file is regenerated by the kernel on every read at offset 0
+static bool readProcFile(int fd, char *buffer, size_t size) {
+    if (fd == -1) {
+        return false;
+    }
+    ssize_t readCount = pread(fd, buffer, size - 1, 0);
+    if (readCount <= 0) {
+        return false;
+    }
+    buffer[readCount] = '\0';
+    return true;
+}
+
+// value of a "key: value" line, -1 when the key is missing
+static long long lineValue(const char *text, const char *key) {
+    size_t keyLength = strlen(key);
+    const char *line = text;
+    while (line != nullptr && *line != '\0') {
+        if (0 == strncmp(line, key, keyLength)) {
+            return atoll(line + keyLength);
+        }
+        line = strchr(line, '\n');
+        if (line != nullptr) {
+            line++;
+        }
+    }
+    return -1;
+}
+#endif
+
+/* Construct */
+ProcSampler::ProcSampler(int intervalMillis, int capacity) : intervalMillis(intervalMillis), capacity(capacity) {
+    timerFd = -1;
+    stopFd = -1;
+    ticksPerSecond = 100;
+#if defined(UNIX) || defined(LINUX)
+    long ticks = sysconf(_SC_CLK_TCK);
+    if (ticks > 0) {
+        ticksPerSecond = ticks;
+    }
+#endif
+}
+
+ProcSampler::~ProcSampler() {
+    stop();
+}
+
+/* Private */
+bool ProcSampler::map(Channel &channel) {
+#if defined(UNIX) || defined(LINUX)
+    size_t size = sizeof(Header) + (size_t) capacity * sizeof(Sample);
+    int fd = open(channel.path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (fd == -1) {
+        logger() << "[ERROR] ProcSampler::map: open " << channel.path << " failed: " << strerror(errno) << std::endl;
+        return false;
+    }
+    struct stat status{};
+    bool resized = 0 != fstat(fd, &status) || (size_t) status.st_size != size;
+    if (resized && 0 != ftruncate(fd, (off_t) size)) {
+        logger() << "[ERROR] ProcSampler::map: resize " << channel.path << " failed: " << strerror(errno) << std::endl;
+        close(fd);
+        return false;
+    }
+    void *address = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (address == MAP_FAILED) {
+        logger() << "[ERROR] ProcSampler::map: mmap " << channel.path << " failed: " << strerror(errno) << std::endl;
+        return false;
+    }
+    channel.header = (Header *) address;
+    channel.ring = (Sample *) ((char *) address + sizeof(Header));
+    channel.mappedSize = size;
+
+    // the history of the previous run is kept when the layout did not change
+    Header &header = *channel.header;
+    if (resized || 0 != memcmp(header.magic, SAMPLE_MAGIC, sizeof(SAMPLE_MAGIC)) ||
+        header.version != SAMPLE_VERSION || header.sampleSize != sizeof(Sample) ||
+        header.capacity != (uint32_t) capacity) {
+        memset(address, 0, sizeof(Header));
+        memcpy(header.magic, SAMPLE_MAGIC, sizeof(SAMPLE_MAGIC));
+        header.version = SAMPLE_VERSION;
+        header.sampleSize = sizeof(Sample);
+        header.capacity = (uint32_t) capacity;
+    }
+    return true;
+#else
+    return false;
+#endif
+}
+
+void ProcSampler::openProcess(Channel &channel, long pid) {
+#if defined(UNIX) || defined(LINUX)
+    std::string directory = "/proc/" + std::to_string(pid) + "/";
+    channel.statFd = open((directory + "stat").c_str(), O_RDONLY | O_CLOEXEC);
+    channel.ioFd = open((directory + "io").c_str(), O_RDONLY | O_CLOEXEC);
+    channel.statusFd = open((directory + "status").c_str(), O_RDONLY | O_CLOEXEC);
+    // smaps_rollup needs Linux 4.14
+    channel.smapsFd = open((directory + "smaps_rollup").c_str(), O_RDONLY | O_CLOEXEC);
+#endif
+    channel.openPid = pid;
+    channel.lastTime = -1;
+    channel.pssBytes = 0;
+    channel.swapBytes = 0;
+    channel.round = 0;
+}
+
+void ProcSampler::closeProcess(Channel &channel) {
+#if defined(UNIX) || defined(LINUX)
+    for (int *fd : {&channel.statFd, &channel.ioFd, &channel.statusFd, &channel.smapsFd}) {
+        if (*fd != -1) {
+            close(*fd);
+            *fd = -1;
+        }
+    }
+#endif
+    channel.openPid = 0;
+}
+
+void ProcSampler::sample(Channel &channel, long long now) {
+#if defined(UNIX) || defined(LINUX)
+    long pid = channel.pid.load(std::memory_order_relaxed);
+    if (pid != channel.openPid) {
+        closeProcess(channel);
+        if (pid > 0) {
+            openProcess(channel, pid);
+        }
+    }
+    char buffer[4096];
+    if (pid <= 0 || !readProcFile(channel.statFd, buffer, sizeof(buffer))) {
+        return;
+    }
+
+    // the command name may contain spaces and parentheses, the fields start after the last ')'
+    const char *fields = strrchr(buffer, ')');
+    unsigned long long utime = 0;
+    unsigned long long stime = 0;
+    long threads = 0;
+    long rssPages = 0;
+    if (fields == nullptr || 4 != sscanf(fields + 2, "%*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %llu %llu "
+                                                     "%*d %*d %*d %*d %ld %*d %*u %*u %ld",
+                                         &utime, &stime, &threads, &rssPages)) {
+        return;
+    }
+    long long ticks = (long long) (utime + stime);
+    long long readBytes = -1;
+    long long writeBytes = -1;
+    if (readProcFile(channel.ioFd, buffer, sizeof(buffer))) {
+        readBytes = lineValue(buffer, "read_bytes:");
+        writeBytes = lineValue(buffer, "write_bytes:");
+    }
+    if (channel.round % PSS_EVERY == 0) {
+        if (readProcFile(channel.statusFd, buffer, sizeof(buffer))) {
+            long long swap = lineValue(buffer, "VmSwap:");
+            channel.swapBytes = swap < 0 ? 0 : swap * 1024;
+        }
+        if (readProcFile(channel.smapsFd, buffer, sizeof(buffer))) {
+            long long pss = lineValue(buffer, "Pss:");
+            channel.pssBytes = pss < 0 ? 0 : pss * 1024;
+        }
+    }
+    channel.round++;
+
+    Sample item{};
+    item.time = realtimeMillis();
+    item.pid = (int32_t) pid;
+    item.threads = (int32_t) threads;
+    item.rssBytes = (int64_t) rssPages * sysconf(_SC_PAGESIZE);
+    item.pssBytes = channel.pssBytes;
+    item.swapBytes = channel.swapBytes;
+    // rates need the previous sample of the same process
+    if (channel.lastTime >= 0 && now > channel.lastTime) {
+        double seconds = (double) (now - channel.lastTime) / 1000000.0;
+        item.cpuHundredths = (int32_t) ((double) (ticks - channel.lastTicks) * 10000.0 /
+                                        (double) ticksPerSecond / seconds);
+        if (readBytes >= 0 && channel.lastRead >= 0) {
+            item.readBytesPerSecond = (int64_t) ((double) (readBytes - channel.lastRead) / seconds);
+            item.writeBytesPerSecond = (int64_t) ((double) (writeBytes - channel.lastWrite) / seconds);
+        }
+    }
+    channel.lastTicks = ticks;
+    channel.lastRead = readBytes;
+    channel.lastWrite = writeBytes;
+    channel.lastTime = now;
+
+    // the record is complete before a reader can see the new count
+    uint64_t count = channel.header->count;
+    channel.ring[count % (uint64_t) capacity] = item;
+    __atomic_store_n(&channel.header->count, count + 1, __ATOMIC_RELEASE);
+#endif
+}
+
+void ProcSampler::loop() {
+#if defined(UNIX) || defined(LINUX)
+    struct pollfd descriptors[2];
+    descriptors[0].fd = timerFd;
+    descriptors[0].events = POLLIN;
+    descriptors[1].fd = stopFd;
+    descriptors[1].events = POLLIN;
+    while (true) {
+        if (poll(descriptors, 2, -1) == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            logger() << "[ERROR] ProcSampler::loop: poll: " << strerror(errno) << std::endl;
+            break;
+        }
+        if (descriptors[1].revents != 0) {
+            break;
+        }
+        uint64_t expirations;
+        while (::read(timerFd, &expirations, sizeof(expirations)) > 0) {}
+        long long now = monotonicMicros();
+        for (auto &channel : channels) {
+            sample(*channel, now);
+        }
+    }
+    for (auto &channel : channels) {
+        closeProcess(*channel);
+    }
+#endif
+}
+
+/* Public */
+int ProcSampler::add(const std::string &name, const std::string &path) {
+    std::unique_ptr<Channel> channel(new Channel());
+    channel->name = name;
+    channel->path = path;
+    channel->pid.store(0);
+    channel->header = nullptr;
+    channel->ring = nullptr;
+    channel->mappedSize = 0;
+    channel->openPid = 0;
+    channel->statFd = -1;
+    channel->ioFd = -1;
+    channel->statusFd = -1;
+    channel->smapsFd = -1;
+    channel->lastTicks = 0;
+    channel->lastRead = -1;
+    channel->lastWrite = -1;
+    channel->lastTime = -1;
+    channel->pssBytes = 0;
+    channel->swapBytes = 0;
+    channel->round = 0;
+    channels.push_back(std::move(channel));
+    return (int) channels.size() - 1;
+}
+
+bool ProcSampler::start() {
+#if defined(UNIX) || defined(LINUX)
+    if (intervalMillis <= 0 || capacity <= 0) {
+        logger() << "[ERROR] ProcSampler::start: interval and capacity must be positive." << std::endl;
+        return false;
+    }
+    for (auto &channel : channels) {
+        if (!map(*channel)) {
+            return false;
+        }
+    }
+    timerFd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK);
+    stopFd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (timerFd == -1 || stopFd == -1) {
+        logger() << "[ERROR] ProcSampler::start: create descriptors: " << strerror(errno) << std::endl;
+        return false;
+    }
+    struct itimerspec spec{};
+    spec.it_interval.tv_sec = intervalMillis / 1000;
+    spec.it_interval.tv_nsec = (long) (intervalMillis % 1000) * 1000000;
+    spec.it_value = spec.it_interval;
+    timerfd_settime(timerFd, 0, &spec, nullptr);
+
+    // the thread inherits a fully blocked mask, signals are for the main
+    // thread where a supervisor waits for SIGCHLD
+    sigset_t signals;
+    sigset_t previous;
+    sigfillset(&signals);
+    pthread_sigmask(SIG_BLOCK, &signals, &previous);
+    thread = std::thread(&ProcSampler::loop, this);
+    pthread_sigmask(SIG_SETMASK, &previous, nullptr);
+    return true;
+#else
+    logger() << "[ERROR] ProcSampler::start: only supported on Linux." << std::endl;
+    return false;
+#endif
+}
+
+void ProcSampler::setPid(int channel, long pid) {
+    if (channel >= 0 && channel < (int) channels.size()) {
+        channels[channel]->pid.store(pid, std::memory_order_relaxed);
+    }
+}
+
+void ProcSampler::stop() {
+#if defined(UNIX) || defined(LINUX)
+    if (thread.joinable()) {
+        uint64_t one = 1;
+        if (write(stopFd, &one, sizeof(one)) != (ssize_t) sizeof(one)) {
+            logger() << "[ERROR] ProcSampler::stop: write: " << strerror(errno) << std::endl;
+        }
+        thread.join();
+    }
+    for (int *fd : {&timerFd, &stopFd}) {
+        if (*fd != -1) {
+            close(*fd);
+            *fd = -1;
+        }
+    }
+    for (auto &channel : channels) {
+        if (channel->header != nullptr) {
+            munmap(channel->header, channel->mappedSize);
+            channel->header = nullptr;
+            channel->ring = nullptr;
+        }
+    }
+#endif
+}
+
+bool ProcSampler::read(const std::string &path, std::vector<Sample> &samples) {
+    samples.clear();
+    FILE *file = fopen(path.c_str(), "rb");
+    if (file == nullptr) {
+        logger() << "[ERROR] ProcSampler::read: open " << path << " failed." << std::endl;
+        return false;
+    }
+    Header header{};
+    if (1 != fread(&header, sizeof(header), 1, file) ||
+        0 != memcmp(header.magic, SAMPLE_MAGIC, sizeof(SAMPLE_MAGIC)) ||
+        header.version != SAMPLE_VERSION || header.sampleSize != sizeof(Sample) || header.capacity == 0) {
+        logger() << "[ERROR] ProcSampler::read: not a sample file: " << path << std::endl;
+        fclose(file);
+        return false;
+    }
+    std::vector<Sample> ring(header.capacity);
+    size_t readCount = fread(ring.data(), sizeof(Sample), ring.size(), file);
+    fclose(file);
+
+    // count read before the ring, a sample written meanwhile is at most one round newer
+    uint64_t count = header.count;
+    uint64_t available = count < header.capacity ? count : header.capacity;
+    for (uint64_t i = count - available; i < count; i++) {
+        size_t index = (size_t) (i % header.capacity);
+        if (index < readCount) {
+            samples.push_back(ring[index]);
+        }
+    }
+    return true;
+}
@@ -0,0 +1,111 @@
+//
+// Created by arsia on 2026/10/19.
+//
+
+#ifndef APPFRAME_STARTER_PROC_SAMPLER_H
+#define APPFRAME_STARTER_PROC_SAMPLER_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * Samples the resource usage of the started processes from /proc.
+ *
+ * Every channel is a fixed-size ring of Samples in a memory-mapped file, so
+ * another process (the samples command) can read it while the starter runs
+ * and the history survives restarts. One thread wakes up every interval and
+ * reads /proc/<pid>/stat and io through descriptors kept open for the pid;
+ * the costlier status and smaps_rollup are read every PSS_EVERY samples.
+ * CPU and IO are stored as rates over the last interval.
+ * Only supported on Linux.
+ */
+class ProcSampler
+{
+public:
+    // one record of the file, 64 bytes
+    struct Sample {
+        int64_t time;                 // unix milliseconds
+        int32_t pid;
+        int32_t threads;
+        int32_t cpuHundredths;        // CPU% * 100, 100% is one core
+        int32_t reserved;
+        int64_t rssBytes;
+        int64_t pssBytes;
+        int64_t swapBytes;
+        int64_t readBytesPerSecond;   // storage IO, /proc/<pid>/io read_bytes
+        int64_t writeBytesPerSecond;
+    };
+
+    // file header, followed by capacity Samples
+    struct Header {
+        char magic[8];
+        uint32_t version;
+        uint32_t sampleSize;
+        uint32_t capacity;
+        uint32_t reserved;
+        // samples written, the next one goes to count % capacity
+        uint64_t count;
+        char padding[32];
+    };
+
+    static const int PSS_EVERY = 10;
+
+    ProcSampler(int intervalMillis, int capacity);
+    ~ProcSampler();
+
+    ProcSampler(const ProcSampler &other) = delete;
+    ProcSampler &operator=(const ProcSampler &other) = delete;
+
+    // before start()
+    int add(const std::string &name, const std::string &path);
+    bool start();
+    // 0 when the process is not running
+    void setPid(int channel, long pid);
+    void stop();
+
+    // samples of a file, oldest first
+    static bool read(const std::string &path, std::vector<Sample> &samples);
+
+private:
+    struct Channel {
+        std::string name;
+        std::string path;
+        std::atomic<long> pid;
+        Header *header;
+        Sample *ring;
+        size_t mappedSize;
+        // sampler thread only
+        long openPid;
+        int statFd;
+        int ioFd;
+        int statusFd;
+        int smapsFd;
+        long long lastTicks;
+        long long lastRead;
+        long long lastWrite;
+        long long lastTime;
+        int64_t pssBytes;
+        int64_t swapBytes;
+        int round;
+    };
+
+    int intervalMillis;
+    int capacity;
+    std::vector<std::unique_ptr<Channel>> channels;
+    std::thread thread;
+    int timerFd;
+    int stopFd;
+    long ticksPerSecond;
+
+    bool map(Channel &channel);
+    void openProcess(Channel &channel, long pid);
+    void closeProcess(Channel &channel);
+    void sample(Channel &channel, long long now);
+    void loop();
+};
+
+#endif //APPFRAME_STARTER_PROC_SAMPLER_H
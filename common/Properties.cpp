@@ -1,5 +1,17 @@
 #include "Properties.h"
 
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include "Logger.h"
+#include <sys/stat.h>
+
+#if defined(UNIX) || defined(LINUX)
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#endif
+
 /***********************
  *     Properties     *
  ***********************/
@@ -8,25 +20,92 @@
 int Properties::ARRAY_SIZE = 128;
 int Properties::PROPERTY_MAX_SIZE = 512;
 
+/* Snapshot */
+// layout: header | buckets[bucketCount] | entries[entryCount] | string pool
+static const char SNAPSHOT_MAGIC[4] = {'A', 'F', 'P', 'S'};
+static const unsigned int SNAPSHOT_VERSION = 1;
+
+struct Properties::SnapshotHeader {
+    char magic[4];
+    unsigned int version;
+    unsigned long long sourceSize;
+    long long sourceMtime;
+    unsigned long long sourceHash;
+    unsigned int bucketCount;
+    unsigned int entryCount;
+    unsigned int poolSize;
+    unsigned int reserved;
+};
+
+struct Properties::SnapshotEntry {
+    unsigned int hash;
+    // offsets in the string pool
+    unsigned int key;
+    unsigned int value;
+    // index + 1 of the next entry in the same bucket, 0 is the end
+    unsigned int next;
+};
+
+static long long modifyTime(const struct stat &status) {
+#if defined(UNIX) || defined(LINUX)
+    return (long long) status.st_mtim.tv_sec * 1000000000LL + status.st_mtim.tv_nsec;
+#else
+    return (long long) status.st_mtime;
+#endif
+}
+
+/* Layout */
+// replaces [start, end) of the source with text
+struct Patch {
+    long start;
+    long end;
+    const char *text;
+    long textLength;
+};
+
+static int comparePatch(const void *a, const void *b) {
+    long diff = ((const Patch *) a)->start - ((const Patch *) b)->start;
+    return diff < 0 ? -1 : (diff > 0 ? 1 : 0);
+}
+
 /* Construct */
 Properties::Properties() : Properties(nullptr) {}
 
 Properties::Properties(const char *path) {
-    properties = new Node *[ARRAY_SIZE];
+    arraySize = ARRAY_SIZE;
+    properties = new Node *[arraySize];
 
-    for (int i = 0; i < ARRAY_SIZE; i++) {
+    for (int i = 0; i < arraySize; i++) {
         properties[i] = nullptr;
     }
 
     initSuccess = true;
     propertySize = 0;
+    source = nullptr;
+    sourceLength = 0;
+    sourcePath = nullptr;
+    removedLines = nullptr;
+    removedCount = 0;
+    removedCapacity = 0;
+    snapshot = nullptr;
+    snapshotLength = 0;
+    snapshotMapped = false;
     if (path != nullptr && !load(path)) {
         initSuccess = false;
     }
 }
 
+static void copyProperty(const char *key, const char *value, void *context) {
+    ((Properties *) context)->set(key, value);
+}
+
+Properties::Properties(const Properties &other) : Properties(nullptr) {
+    other.forEach(copyProperty, this);
+}
+
 Properties::~Properties() {
     clear();
+    delete[] removedLines;
     delete[] properties;
 }
 
@@ -74,19 +153,31 @@ void Properties::analyze(const char *str) {
         key,
         division,
         value,
-        annotation,
-        error
+        annotation
     };
 
     status state = ready;
     bool isCompleted = false;
     unsigned long count = 0;
     int propertyCount = 0;
-    char *property = new char[PROPERTY_MAX_SIZE + 1];
+    int propertyCapacity = PROPERTY_MAX_SIZE + 1;
+    char *property = new char[propertyCapacity];
+    long lineStart = 0;
+    long valueStart = 0;
     Node node;
+    Node *target;
 
     // start analyze
     while (!isCompleted) {
+        // keep room for the next character and the terminator
+        if (propertyCount + 2 > propertyCapacity) {
+            propertyCapacity *= 2;
+            char *larger = new char[propertyCapacity];
+            memcpy(larger, property, propertyCount);
+            delete[] property;
+            property = larger;
+        }
+
         switch (state) {
             case ready:
                 if (!isBlank(str[count])) {
@@ -98,6 +189,11 @@ void Properties::analyze(const char *str) {
                         state = key;
                         propertyCount = 0;
                         property[propertyCount++] = str[count];
+
+                        lineStart = (long) count;
+                        while (lineStart > 0 && str[lineStart - 1] != '\n') {
+                            lineStart--;
+                        }
                     }
                 }
                 break;
@@ -105,7 +201,10 @@ void Properties::analyze(const char *str) {
             case key:
                 if (str[count] != '=') {
                     if (str[count] == '\0' || str[count] == '\n') {
-                        state = error;
+                        property[propertyCount] = '\0';
+                        logger() << "[WARN ] Properties::analyze: syntax error -> [" << property << "]" << std::endl;
+                        isCompleted = str[count] == '\0';
+                        state = ready;
                     } else {
                         property[propertyCount++] = str[count];
                     }
@@ -124,8 +223,23 @@ void Properties::analyze(const char *str) {
                 break;
 
             case division:
-                if (!isBlank(str[count])) {
+                if (str[count] == '\0' || str[count] == '\n' || str[count] == '#') {
+                    // empty value, a later value is inserted before the line ending
+                    valueStart = (long) count;
+                    if (str[count] == '\n' && count > 0 && str[count - 1] == '\r') {
+                        valueStart--;
+                    }
+                    target = put(node.getKey(), "");
+                    if (target->hasOrigin()) {
+                        target->addDuplicate(target->getLineStart());
+                    }
+                    target->setOrigin(lineStart, valueStart, valueStart);
+                    target->setModified(false);
+                    isCompleted = str[count] == '\0';
+                    state = str[count] == '#' ? annotation : ready;
+                } else if (!isBlank(str[count])) {
                     state = value;
+                    valueStart = (long) count;
                     propertyCount = 0;
                     property[propertyCount++] = str[count];
                 }
@@ -157,12 +271,19 @@ void Properties::analyze(const char *str) {
                         property[propertyCount] = '\0';
                     }
                     node.setValue(property);
-                    set(node.getKey(), node.getValue());
+                    target = put(node.getKey(), node.getValue());
+                    if (target->hasOrigin()) {
+                        target->addDuplicate(target->getLineStart());
+                    }
+                    target->setOrigin(lineStart, valueStart, valueStart + propertyCount + 1);
+                    target->setModified(false);
                 }
                 break;
 
             case annotation:
-                if (str[count] == '\n' || str[count] == '\r') {
+                if (str[count] == '\0') {
+                    isCompleted = true;
+                } else if (str[count] == '\n' || str[count] == '\r') {
                     // CRLF
                     if (str[count] == '\r' && str[count + 1] == '\n') {
                         count++;
@@ -170,12 +291,6 @@ void Properties::analyze(const char *str) {
                     state = ready;
                 }
                 break;
-
-            case error:
-                property[propertyCount] = '\0';
-                printf("Properties::analyze: syntax error -> [%s]\n", property);
-                state = ready;
-                break;
         }
         count++;
     }
@@ -184,7 +299,7 @@ void Properties::analyze(const char *str) {
 }
 
 void Properties::append(Node *node) {
-    int index = node->hashCode() % ARRAY_SIZE;
+    int index = node->hashCode() % arraySize;
     Node *linkRoot = properties[index];
 
     // first node is nullptr
@@ -202,17 +317,251 @@ void Properties::append(Node *node) {
     }
 
     propertySize++;
+
+    // keep the chains short
+    if (propertySize > arraySize * 2) {
+        rehash(arraySize * 2);
+    }
+}
+
+void Properties::rehash(int size) {
+    Node **resized = new Node *[size];
+    Node **tails = new Node *[size];
+    for (int i = 0; i < size; i++) {
+        resized[i] = nullptr;
+        tails[i] = nullptr;
+    }
+
+    Node *node, *next;
+    for (int i = 0; i < arraySize; i++) {
+        for (node = properties[i]; node != nullptr; node = next) {
+            next = node->getNext();
+            int index = node->hashCode() % size;
+            node->setNext(nullptr);
+            node->setPrevious(tails[index]);
+            if (tails[index] == nullptr) {
+                resized[index] = node;
+            } else {
+                tails[index]->setNext(node);
+            }
+            tails[index] = node;
+        }
+    }
+
+    delete[] tails;
+    delete[] properties;
+    properties = resized;
+    arraySize = size;
+}
+
+Properties::Node *Properties::put(const char *key, const char *value) {
+    Node *target = find(key);
+
+    // insert
+    if (target == nullptr) {
+        target = new Node(key, value);
+        append(target);
+    }
+        // alter
+    else {
+        target->setValue(value);
+    }
+    return target;
+}
+
+void Properties::resetSource(char *buffer, long length, const char *path) {
+    delete[] source;
+    delete[] sourcePath;
+    source = buffer;
+    sourceLength = buffer == nullptr ? 0 : length;
+    sourcePath = nullptr;
+    if (path != nullptr) {
+        size_t pathLength = strlen(path);
+        sourcePath = new char[pathLength + 1];
+        memcpy(sourcePath, path, pathLength + 1);
+    }
+    removedCount = 0;
+
+    // positions in the previous source are meaningless now
+    Node *node;
+    for (int i = 0; i < arraySize; i++) {
+        for (node = properties[i]; node != nullptr; node = node->getNext()) {
+            node->setOrigin(-1, -1, -1);
+            node->setModified(false);
+            node->clearDuplicates();
+        }
+    }
+}
+
+void Properties::removeLine(long lineStart) {
+    if (removedCount == removedCapacity) {
+        removedCapacity = removedCapacity == 0 ? 16 : removedCapacity * 2;
+        long *larger = new long[removedCapacity];
+        for (int i = 0; i < removedCount; i++) {
+            larger[i] = removedLines[i];
+        }
+        delete[] removedLines;
+        removedLines = larger;
+    }
+    removedLines[removedCount++] = lineStart;
+}
+
+void Properties::removeDuplicates(Node *node) {
+    for (int i = 0; i < node->getDuplicateCount(); i++) {
+        removeLine(node->getDuplicates()[i]);
+    }
+    node->clearDuplicates();
+}
+
+bool Properties::saveLayout(const char *path) {
+    int patchCount = removedCount;
+    long appendCount = 0;
+    long appendBytes = 0;
+    Node *node;
+    for (int i = 0; i < arraySize; i++) {
+        for (node = properties[i]; node != nullptr; node = node->getNext()) {
+            if (!node->hasOrigin()) {
+                appendCount++;
+                appendBytes += (long) (strlen(node->getKey()) + strlen(node->getValue()) + 1);
+            } else if (node->isModified()) {
+                patchCount++;
+            }
+        }
+    }
+
+    // nothing changed since the file was loaded or saved
+    if (patchCount == 0 && appendCount == 0 && sourcePath != nullptr && 0 == strcmp(path, sourcePath)) {
+        return true;
+    }
+
+    auto *patches = new Patch[patchCount + 1];
+    int index = 0;
+    for (int i = 0; i < removedCount; i++) {
+        long end = removedLines[i];
+        while (end < sourceLength && source[end] != '\n') {
+            end++;
+        }
+        patches[index++] = Patch{removedLines[i], end < sourceLength ? end + 1 : end, "", 0};
+    }
+    for (int i = 0; i < arraySize; i++) {
+        for (node = properties[i]; node != nullptr; node = node->getNext()) {
+            if (node->hasOrigin() && node->isModified()) {
+                patches[index++] = Patch{node->getValueStart(), node->getValueEnd(), node->getValue(),
+                                         (long) strlen(node->getValue())};
+            }
+        }
+    }
+    qsort(patches, (size_t) patchCount, sizeof(Patch), comparePatch);
+
+    // new keys are appended with the line ending the file already uses
+    const char *lineEnd = "\n";
+    const char *firstLineEnd = (const char *) memchr(source, '\n', (size_t) sourceLength);
+    if (firstLineEnd != nullptr && firstLineEnd > source && firstLineEnd[-1] == '\r') {
+        lineEnd = "\r\n";
+    }
+    long lineEndLength = (long) strlen(lineEnd);
+    bool closeLastLine = appendCount > 0 && sourceLength > 0 && source[sourceLength - 1] != '\n';
+
+    // size the output exactly, then fill it in one pass
+    long *shifts = new long[patchCount + 1];
+    long length = sourceLength;
+    shifts[0] = 0;
+    for (int i = 0; i < patchCount; i++) {
+        long delta = patches[i].textLength - (patches[i].end - patches[i].start);
+        length += delta;
+        shifts[i + 1] = shifts[i] + delta;
+    }
+    length += appendBytes + appendCount * lineEndLength + (closeLastLine ? lineEndLength : 0);
+
+    char *output = new char[length + 1];
+    long from = 0;
+    long to = 0;
+    for (int i = 0; i < patchCount; i++) {
+        memcpy(output + to, source + from, (size_t) (patches[i].start - from));
+        to += patches[i].start - from;
+        memcpy(output + to, patches[i].text, (size_t) patches[i].textLength);
+        to += patches[i].textLength;
+        from = patches[i].end;
+    }
+    memcpy(output + to, source + from, (size_t) (sourceLength - from));
+    to += sourceLength - from;
+    if (closeLastLine) {
+        memcpy(output + to, lineEnd, (size_t) lineEndLength);
+        to += lineEndLength;
+    }
+
+    // shift by every patch that starts before the line
+    auto shiftOf = [patches, patchCount, shifts](long lineStart) {
+        int low = 0, high = patchCount;
+        while (low < high) {
+            int middle = (low + high) / 2;
+            if (patches[middle].start < lineStart) {
+                low = middle + 1;
+            } else {
+                high = middle;
+            }
+        }
+        return shifts[low];
+    };
+    for (int i = 0; i < arraySize; i++) {
+        for (node = properties[i]; node != nullptr; node = node->getNext()) {
+            if (node->hasOrigin()) {
+                long shift = shiftOf(node->getLineStart());
+                for (int d = 0; d < node->getDuplicateCount(); d++) {
+                    node->getDuplicates()[d] += shiftOf(node->getDuplicates()[d]);
+                }
+                long valueBegin = node->getValueStart() + shift;
+                node->setOrigin(node->getLineStart() + shift, valueBegin,
+                                node->isModified() ? valueBegin + (long) strlen(node->getValue())
+                                                   : node->getValueEnd() + shift);
+            } else {
+                long keyLength = (long) strlen(node->getKey());
+                long valueLength = (long) strlen(node->getValue());
+                node->setOrigin(to, to + keyLength + 1, to + keyLength + 1 + valueLength);
+                memcpy(output + to, node->getKey(), (size_t) keyLength);
+                to += keyLength;
+                output[to++] = '=';
+                memcpy(output + to, node->getValue(), (size_t) valueLength);
+                to += valueLength;
+                memcpy(output + to, lineEnd, (size_t) lineEndLength);
+                to += lineEndLength;
+            }
+            node->setModified(false);
+        }
+    }
+    output[length] = '\0';
+
+    delete[] shifts;
+    delete[] patches;
+
+    if (!writeFile(path, output, (size_t) length)) {
+        // the nodes keep their values, the next save rewrites the whole file
+        resetSource(nullptr, 0, nullptr);
+        delete[] output;
+        return false;
+    }
+
+    // the written text is the new source
+    delete[] source;
+    delete[] sourcePath;
+    source = output;
+    sourceLength = length;
+    size_t pathLength = strlen(path);
+    sourcePath = new char[pathLength + 1];
+    memcpy(sourcePath, path, pathLength + 1);
+    removedCount = 0;
+    return true;
 }
 
-Properties::Node *Properties::find(const char *key) {
-    Node node(key, nullptr);
-    int index = node.hashCode() % ARRAY_SIZE;
+Properties::Node *Properties::find(const char *key) const {
+    int hashCode = Node::hash(key);
+    int index = hashCode % arraySize;
 
     Node *linkNode = properties[index];
     while (linkNode != nullptr) {
         // find the node
-        if (linkNode->hashCode() == node.hashCode() &&
-            linkNode->keyEquals(node.getKey())) {
+        if (linkNode->hashCode() == hashCode &&
+            linkNode->keyEquals(key)) {
             return linkNode;
         } else {
             linkNode = linkNode->getNext();
@@ -223,16 +572,296 @@ Properties::Node *Properties::find(const char *key) {
     return nullptr;
 }
 
+bool Properties::writeFile(const char *path, const char *data, size_t length) {
+    // write to a temporary file, then replace the target
+    size_t pathLength = strlen(path);
+    char *tempPath = new char[pathLength + 5];
+    memcpy(tempPath, path, pathLength);
+    memcpy(tempPath + pathLength, ".tmp", 5);
+
+    bool success = false;
+    FILE *file = fopen(tempPath, "wb");
+    if (file != nullptr) {
+        success = length == fwrite(data, 1, length, file);
+        success = 0 == fclose(file) && success;
+#if defined(WINDOWS)
+        ::remove(path);
+#endif
+        success = success && 0 == rename(tempPath, path);
+        if (!success) {
+            ::remove(tempPath);
+        }
+    }
+    if (!success) {
+        logger() << "[ERROR] Properties::writeFile: write file failed.[" << path << "]" << std::endl;
+    }
+
+    delete[] tempPath;
+    return success;
+}
+
+unsigned int Properties::snapshotHash(const char *str) {
+    // FNV-1a
+    unsigned int result = 2166136261u;
+    while (*str != '\0') {
+        result ^= (unsigned char) *str++;
+        result *= 16777619u;
+    }
+    return result;
+}
+
+unsigned long long Properties::contentHash(const char *buffer, size_t length) {
+    // FNV-1a 64
+    unsigned long long result = 14695981039346656037ull;
+    for (size_t i = 0; i < length; i++) {
+        result ^= (unsigned char) buffer[i];
+        result *= 1099511628211ull;
+    }
+    return result;
+}
+
+bool Properties::attachSnapshot(const char *path, const char *snapshotPath) {
+    struct stat sourceStatus{};
+    if (0 != stat(path, &sourceStatus)) {
+        return false;
+    }
+
+    const char *data;
+    size_t length;
+#if defined(UNIX) || defined(LINUX)
+    int fd = open(snapshotPath, O_RDONLY | O_CLOEXEC);
+    if (fd == -1) {
+        return false;
+    }
+    struct stat snapshotStatus{};
+    if (0 != fstat(fd, &snapshotStatus) || snapshotStatus.st_size < (off_t) sizeof(SnapshotHeader)) {
+        close(fd);
+        return false;
+    }
+    length = (size_t) snapshotStatus.st_size;
+    void *mapped = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapped == MAP_FAILED) {
+        return false;
+    }
+    data = (const char *) mapped;
+    snapshotMapped = true;
+#else
+    FILE *file = fopen(snapshotPath, "rb");
+    if (file == nullptr) {
+        return false;
+    }
+    length = fileSize(file);
+    if (length < sizeof(SnapshotHeader)) {
+        fclose(file);
+        return false;
+    }
+    char *buffer = new char[length];
+    size_t readCount = fread(buffer, 1, length, file);
+    fclose(file);
+    if (readCount != length) {
+        delete[] buffer;
+        return false;
+    }
+    data = buffer;
+    snapshotMapped = false;
+#endif
+    snapshot = data;
+    snapshotLength = length;
+
+    auto *header = (const SnapshotHeader *) data;
+    unsigned long long expectLength = sizeof(SnapshotHeader) +
+                                      (unsigned long long) header->bucketCount * sizeof(unsigned int) +
+                                      (unsigned long long) header->entryCount * sizeof(SnapshotEntry) +
+                                      header->poolSize;
+    bool valid = 0 == memcmp(header->magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC)) &&
+                 header->version == SNAPSHOT_VERSION &&
+                 header->bucketCount != 0 &&
+                 0 == (header->bucketCount & (header->bucketCount - 1)) &&
+                 expectLength == length &&
+                 header->poolSize > 0 && data[length - 1] == '\0' &&
+                 header->sourceSize == (unsigned long long) sourceStatus.st_size;
+
+    // same size but touched: the content hash decides
+    if (valid && header->sourceMtime != modifyTime(sourceStatus)) {
+        FILE *file = fopen(path, "rb");
+        char *buffer = file == nullptr ? nullptr : readFile(file);
+        if (file != nullptr) {
+            fclose(file);
+        }
+        valid = buffer != nullptr && header->sourceHash == contentHash(buffer, header->sourceSize);
+        delete[] buffer;
+        // the next load takes the fast path again
+        if (valid) {
+            refreshSnapshotMtime(snapshotPath, modifyTime(sourceStatus));
+        }
+    }
+
+    valid = valid && validSnapshotEntries();
+    if (!valid) {
+        detachSnapshot();
+    }
+    return valid;
+}
+
+bool Properties::writeSnapshot(const char *snapshotPath, size_t sourceSize, long long sourceMtime,
+                               unsigned long long sourceHash) {
+    unsigned int entryCount = 0;
+    unsigned long long poolSize = 0;
+    Node *node;
+    for (int i = 0; i < arraySize; i++) {
+        for (node = properties[i]; node != nullptr; node = node->getNext()) {
+            entryCount++;
+            poolSize += strlen(node->getKey()) + strlen(node->getValue()) + 2;
+        }
+    }
+
+    // keep the load factor at or below 0.5
+    unsigned int bucketCount = 16;
+    while (bucketCount < entryCount * 2) {
+        bucketCount <<= 1;
+    }
+    if (poolSize == 0) {
+        poolSize = 1;
+    }
+    if (poolSize > 0xFFFFFFFFull) {
+        logger() << "[ERROR] Properties::writeSnapshot: properties too large." << std::endl;
+        return false;
+    }
+
+    size_t length = sizeof(SnapshotHeader) + bucketCount * sizeof(unsigned int) +
+                    entryCount * sizeof(SnapshotEntry) + poolSize;
+    char *buffer = new char[length];
+    memset(buffer, 0, length);
+
+    auto *header = (SnapshotHeader *) buffer;
+    memcpy(header->magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC));
+    header->version = SNAPSHOT_VERSION;
+    header->sourceSize = sourceSize;
+    header->sourceMtime = sourceMtime;
+    header->sourceHash = sourceHash;
+    header->bucketCount = bucketCount;
+    header->entryCount = entryCount;
+    header->poolSize = (unsigned int) poolSize;
+
+    auto *buckets = (unsigned int *) (buffer + sizeof(SnapshotHeader));
+    auto *entries = (SnapshotEntry *) (buckets + bucketCount);
+    char *pool = (char *) (entries + entryCount);
+
+    unsigned int index = 0;
+    unsigned int poolOffset = 0;
+    for (int i = 0; i < arraySize; i++) {
+        for (node = properties[i]; node != nullptr; node = node->getNext()) {
+            SnapshotEntry &entry = entries[index];
+            entry.hash = snapshotHash(node->getKey());
+
+            size_t keyLength = strlen(node->getKey()) + 1;
+            entry.key = poolOffset;
+            memcpy(pool + poolOffset, node->getKey(), keyLength);
+            poolOffset += keyLength;
+
+            size_t valueLength = strlen(node->getValue()) + 1;
+            entry.value = poolOffset;
+            memcpy(pool + poolOffset, node->getValue(), valueLength);
+            poolOffset += valueLength;
+
+            unsigned int &bucket = buckets[entry.hash & (bucketCount - 1)];
+            entry.next = bucket;
+            bucket = ++index;
+        }
+    }
+
+    bool success = writeFile(snapshotPath, buffer, length);
+    delete[] buffer;
+    return success;
+}
+
+bool Properties::validSnapshotEntries() const {
+    auto *header = (const SnapshotHeader *) snapshot;
+    auto *entries = (const SnapshotEntry *) (snapshot + sizeof(SnapshotHeader) +
+                                             header->bucketCount * sizeof(unsigned int));
+    for (unsigned int i = 0; i < header->entryCount; i++) {
+        if (entries[i].key >= header->poolSize || entries[i].value >= header->poolSize) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void Properties::refreshSnapshotMtime(const char *snapshotPath, long long sourceMtime) {
+    FILE *file = fopen(snapshotPath, "r+b");
+    if (file == nullptr) {
+        return;
+    }
+    if (0 == fseek(file, (long) offsetof(SnapshotHeader, sourceMtime), SEEK_SET)) {
+        fwrite(&sourceMtime, sizeof(sourceMtime), 1, file);
+    }
+    fclose(file);
+}
+
+const Properties::SnapshotEntry *Properties::findSnapshot(const char *key) const {
+    auto *header = (const SnapshotHeader *) snapshot;
+    auto *buckets = (const unsigned int *) (snapshot + sizeof(SnapshotHeader));
+    auto *entries = (const SnapshotEntry *) (buckets + header->bucketCount);
+    const char *pool = (const char *) (entries + header->entryCount);
+
+    unsigned int hash = snapshotHash(key);
+    unsigned int index = buckets[hash & (header->bucketCount - 1)];
+    while (index != 0 && index <= header->entryCount) {
+        const SnapshotEntry *entry = &entries[index - 1];
+        if (entry->hash == hash && entry->key < header->poolSize && 0 == strcmp(pool + entry->key, key)) {
+            return entry->value < header->poolSize ? entry : nullptr;
+        }
+        index = entry->next;
+    }
+    return nullptr;
+}
+
+void Properties::detachSnapshot() {
+    if (snapshot == nullptr) {
+        return;
+    }
+#if defined(UNIX) || defined(LINUX)
+    if (snapshotMapped) {
+        munmap((void *) snapshot, snapshotLength);
+    } else {
+        delete[] snapshot;
+    }
+#else
+    delete[] snapshot;
+#endif
+    snapshot = nullptr;
+    snapshotLength = 0;
+    snapshotMapped = false;
+}
+
+void Properties::materialize() {
+    if (snapshot == nullptr) {
+        return;
+    }
+
+    auto *header = (const SnapshotHeader *) snapshot;
+    auto *entries = (const SnapshotEntry *) (snapshot + sizeof(SnapshotHeader) +
+                                             header->bucketCount * sizeof(unsigned int));
+    const char *pool = (const char *) (entries + header->entryCount);
+    for (unsigned int i = 0; i < header->entryCount; i++) {
+        if (entries[i].key < header->poolSize && entries[i].value < header->poolSize) {
+            append(new Node(pool + entries[i].key, pool + entries[i].value));
+        }
+    }
+    detachSnapshot();
+}
+
 /* Public */
 bool Properties::load(const char *path) {
     if (path == nullptr) {
-        puts("Properties::load: file path is null.");
+        logger() << "[ERROR] Properties::load: file path is null." << std::endl;
         return false;
     }
 
     FILE *file = fopen(path, "rb");
     if (file == nullptr) {
-        printf("Properties::load: open file failed.[%s]\n", path);
+        logger() << "[ERROR] Properties::load: open file failed.[" << path << "]" << std::endl;
         return false;
     }
 
@@ -243,40 +872,97 @@ bool Properties::load(const char *path) {
         return true;
     }
 
+    materialize();
+    resetSource(buffer, (long) strlen(buffer), path);
     analyze(buffer);
     return true;
 }
 
-bool Properties::save(const char *path) {
-    if (path == nullptr) {
-        puts("Properties::save: file path is null pointer.");
+bool Properties::loadSnapshot(const char *path, const char *snapshotPath) {
+    if (path == nullptr || snapshotPath == nullptr) {
+        logger() << "[ERROR] Properties::loadSnapshot: file path is null." << std::endl;
         return false;
     }
 
-    FILE *file = fopen(path, "w+");
+    clear();
+    if (attachSnapshot(path, snapshotPath)) {
+        return true;
+    }
+
+    // snapshot is missing or stale: parse the source and compile a new one
+    FILE *file = fopen(path, "rb");
     if (file == nullptr) {
-        printf("Properties::save: open/create file failed.[%s]\n", path);
+        logger() << "[ERROR] Properties::loadSnapshot: open file failed.[" << path << "]" << std::endl;
         return false;
     }
 
+    struct stat status{};
+    fstat(fileno(file), &status);
+    size_t length = fileSize(file);
+    char *buffer = readFile(file);
+    fclose(file);
+
+    unsigned long long hash = contentHash(buffer == nullptr ? "" : buffer, buffer == nullptr ? 0 : length);
+    if (buffer != nullptr) {
+        resetSource(buffer, (long) length, path);
+        analyze(buffer);
+    }
+
+    // the properties are loaded even if the snapshot can't be written
+    writeSnapshot(snapshotPath, length, modifyTime(status), hash);
+    return true;
+}
+
+bool Properties::save(const char *path, bool keepLayout) {
+    if (path == nullptr) {
+        logger() << "[ERROR] Properties::save: file path is null pointer." << std::endl;
+        return false;
+    }
+
+    if (keepLayout && source != nullptr) {
+        return saveLayout(path);
+    }
+
+    materialize();
+    size_t length = 0;
     Node *node;
-    for (int i = 0; i < ARRAY_SIZE; i++) {
-        node = properties[i];
-        while (node != nullptr) {
-            fprintf(file, "%s=%s\n", node->getKey(), node->getValue());
-            node = node->getNext();
+    for (int i = 0; i < arraySize; i++) {
+        for (node = properties[i]; node != nullptr; node = node->getNext()) {
+            length += strlen(node->getKey()) + strlen(node->getValue()) + 2;
         }
     }
-    fclose(file);
-    return true;
+
+    char *buffer = new char[length + 1];
+    size_t offset = 0;
+    for (int i = 0; i < arraySize; i++) {
+        for (node = properties[i]; node != nullptr; node = node->getNext()) {
+            size_t keyLength = strlen(node->getKey());
+            size_t valueLength = strlen(node->getValue());
+            memcpy(buffer + offset, node->getKey(), keyLength);
+            offset += keyLength;
+            buffer[offset++] = '=';
+            memcpy(buffer + offset, node->getValue(), valueLength);
+            offset += valueLength;
+            buffer[offset++] = '\n';
+        }
+    }
+
+    bool success = writeFile(path, buffer, length);
+    delete[] buffer;
+    return success;
 }
 
 int Properties::size() const {
+    if (snapshot != nullptr) {
+        return (int) ((const SnapshotHeader *) snapshot)->entryCount;
+    }
     return propertySize;
 }
 
 void Properties::clear() {
-    for (int i = 0; i < ARRAY_SIZE; i++) {
+    detachSnapshot();
+    resetSource(nullptr, 0, nullptr);
+    for (int i = 0; i < arraySize; i++) {
         Node *current = properties[i],
                 *next;
 
@@ -285,10 +971,13 @@ void Properties::clear() {
             delete current;
             current = next;
         }
+        properties[i] = nullptr;
     }
+    propertySize = 0;
 }
 
 void Properties::remove(const char *key) {
+    materialize();
     Node *target = find(key);
 
     // not found
@@ -296,16 +985,31 @@ void Properties::remove(const char *key) {
         return;
     }
 
+    Node *previous = target->getPrevious();
+    Node *next = target->getNext();
+
     // first node
-    if (target->getPrevious() == nullptr) {
-        properties[target->hashCode() % ARRAY_SIZE] = target->getNext();
+    if (previous == nullptr) {
+        properties[target->hashCode() % arraySize] = next;
     } else {
-        target->getPrevious()->setNext(target->getNext());
+        previous->setNext(next);
+    }
+    if (next != nullptr) {
+        next->setPrevious(previous);
+    }
+
+    // drop the line and the earlier occurrences on the next layout preserving save
+    if (target->hasOrigin()) {
+        removeLine(target->getLineStart());
+        removeDuplicates(target);
     }
+
     delete target;
+    propertySize--;
 }
 
 void Properties::set(const char *key, const char *value) {
+    materialize();
     Node *target = find(key);
 
     // insert
@@ -313,16 +1017,53 @@ void Properties::set(const char *key, const char *value) {
         append(new Node(key, value));
     }
         // alter
-    else {
+    else if (target->getValue() == nullptr || value == nullptr || 0 != strcmp(target->getValue(), value)) {
         target->setValue(value);
+        target->setModified(true);
+        // only the patched last occurrence stays, the file reads back the new value
+        removeDuplicates(target);
     }
 }
 
-char *Properties::get(const char *key) {
+char *Properties::get(const char *key) const {
+    if (snapshot != nullptr) {
+        const SnapshotEntry *entry = findSnapshot(key);
+        if (entry == nullptr) {
+            return nullptr;
+        }
+        auto *header = (const SnapshotHeader *) snapshot;
+        return (char *) snapshot + sizeof(SnapshotHeader) + header->bucketCount * sizeof(unsigned int) +
+               header->entryCount * sizeof(SnapshotEntry) + entry->value;
+    }
+
     Node *target = find(key);
     return target == nullptr ? nullptr : target->getValue();
 }
 
+void Properties::forEach(Visitor visitor, void *context) const {
+    if (snapshot != nullptr) {
+        auto *header = (const SnapshotHeader *) snapshot;
+        auto *entries = (const SnapshotEntry *) (snapshot + sizeof(SnapshotHeader) +
+                                                 header->bucketCount * sizeof(unsigned int));
+        const char *pool = (const char *) (entries + header->entryCount);
+        for (unsigned int i = 0; i < header->entryCount; i++) {
+            if (entries[i].key < header->poolSize && entries[i].value < header->poolSize) {
+                visitor(pool + entries[i].key, pool + entries[i].value, context);
+            }
+        }
+        return;
+    }
+
+    Node *node;
+    for (int i = 0; i < arraySize; i++) {
+        node = properties[i];
+        while (node != nullptr) {
+            visitor(node->getKey(), node->getValue(), context);
+            node = node->getNext();
+        }
+    }
+}
+
 bool Properties::isInitSuccess() const {
     return initSuccess;
 }
@@ -338,6 +1079,12 @@ Properties::Node::Node() {
     this->value = nullptr;
     this->next = nullptr;
     this->previous = nullptr;
+    this->lineStart = -1;
+    this->valueStart = -1;
+    this->valueEnd = -1;
+    this->modified = false;
+    this->duplicates = nullptr;
+    this->duplicateCount = 0;
 }
 
 Properties::Node::Node(const char *key, const char *value) {
@@ -346,16 +1093,23 @@ Properties::Node::Node(const char *key, const char *value) {
     this->value = stringCopy(value);
     this->next = nullptr;
     this->previous = nullptr;
+    this->lineStart = -1;
+    this->valueStart = -1;
+    this->valueEnd = -1;
+    this->modified = false;
+    this->duplicates = nullptr;
+    this->duplicateCount = 0;
 }
 
 Properties::Node::~Node() {
     delete[] key;
     delete[] value;
+    delete[] duplicates;
 }
 
 /* Private */
 int Properties::Node::hash(const char *value) {
-    int result = 0;
+    unsigned int result = 0;
 
     if (value != nullptr) {
         int count = 0;
@@ -366,7 +1120,8 @@ int Properties::Node::hash(const char *value) {
         }
     }
 
-    return result < 0 ? -result : result;
+    // non-negative, it is used as a bucket index
+    return (int) (result & 0x7FFFFFFFu);
 }
 
 bool Properties::Node::stringCompare(const char *src, const char *dst) {
@@ -416,12 +1171,10 @@ void Properties::Node::setValue(const char *v) {
 }
 
 void Properties::Node::setNext(Properties::Node *node) {
-    delete this->next;
     this->next = node;
 }
 
 void Properties::Node::setPrevious(Properties::Node *node) {
-    delete this->previous;
     this->previous = node;
 }
 
@@ -433,6 +1186,32 @@ char *Properties::Node::getValue() {
     return value;
 }
 
+void Properties::Node::setOrigin(long line, long valueBegin, long valueFinish) {
+    this->lineStart = line;
+    this->valueStart = valueBegin;
+    this->valueEnd = valueFinish;
+}
+
+void Properties::Node::addDuplicate(long line) {
+    long *larger = new long[duplicateCount + 1];
+    for (int i = 0; i < duplicateCount; i++) {
+        larger[i] = duplicates[i];
+    }
+    larger[duplicateCount++] = line;
+    delete[] duplicates;
+    duplicates = larger;
+}
+
+void Properties::Node::clearDuplicates() {
+    delete[] duplicates;
+    duplicates = nullptr;
+    duplicateCount = 0;
+}
+
+void Properties::Node::setModified(bool m) {
+    this->modified = m;
+}
+
 Properties::Node *Properties::Node::getNext() {
     return next;
 }
@@ -441,6 +1220,34 @@ Properties::Node *Properties::Node::getPrevious() {
     return previous;
 }
 
+long Properties::Node::getLineStart() const {
+    return lineStart;
+}
+
+long Properties::Node::getValueStart() const {
+    return valueStart;
+}
+
+long Properties::Node::getValueEnd() const {
+    return valueEnd;
+}
+
+bool Properties::Node::hasOrigin() const {
+    return lineStart >= 0;
+}
+
+int Properties::Node::getDuplicateCount() const {
+    return duplicateCount;
+}
+
+long *Properties::Node::getDuplicates() {
+    return duplicates;
+}
+
+bool Properties::Node::isModified() const {
+    return modified;
+}
+
 int Properties::Node::hashCode() const {
     return keyHashCode;
 }
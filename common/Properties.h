@@ -9,35 +9,75 @@
 class Properties
 {
 public:
+    typedef void (*Visitor)(const char *key, const char *value, void *context);
+
     static int ARRAY_SIZE;
     static int PROPERTY_MAX_SIZE;
 
     Properties();
     explicit Properties(const char *path);
+    Properties(const Properties &other);
     ~Properties();
 
+    Properties &operator=(const Properties &other) = delete;
+
     bool load(const char *path);
-    bool save(const char *path);
+    bool loadSnapshot(const char *path, const char *snapshotPath);
+    bool save(const char *path, bool keepLayout = false);
     int size() const;
     void clear();
     void remove(const char *key);
     void set(const char *key, const char *value);
-    char *get(const char *key);
+    char *get(const char *key) const;
+    void forEach(Visitor visitor, void *context) const;
     bool isInitSuccess() const;
 
 private:
     class Node;
+    struct SnapshotHeader;
+    struct SnapshotEntry;
 
     Node **properties;
+    int arraySize;
     int propertySize;
     bool initSuccess;
 
+    // text of the last loaded file, kept to save with the original layout
+    char *source;
+    long sourceLength;
+    char *sourcePath;
+    long *removedLines;
+    int removedCount;
+    int removedCapacity;
+
+    // read-only binary snapshot, served until the first modification
+    const char *snapshot;
+    size_t snapshotLength;
+    bool snapshotMapped;
+
     static size_t fileSize(FILE *file);
     static char *readFile(FILE *file);
     static bool isBlank(char c);
+    static bool writeFile(const char *path, const char *data, size_t length);
+    static unsigned int snapshotHash(const char *str);
+    static unsigned long long contentHash(const char *buffer, size_t length);
     void analyze(const char *str);
     void append(Node *node);
-    Node *find(const char *key);
+    Node *put(const char *key, const char *value);
+    void resetSource(char *buffer, long length, const char *path);
+    void removeLine(long lineStart);
+    void removeDuplicates(Node *node);
+    bool saveLayout(const char *path);
+    void rehash(int size);
+    Node *find(const char *key) const;
+    bool attachSnapshot(const char *path, const char *snapshotPath);
+    bool writeSnapshot(const char *snapshotPath, size_t sourceSize, long long sourceMtime,
+                       unsigned long long sourceHash);
+    const SnapshotEntry *findSnapshot(const char *key) const;
+    bool validSnapshotEntries() const;
+    static void refreshSnapshotMtime(const char *snapshotPath, long long sourceMtime);
+    void detachSnapshot();
+    void materialize();
 };
 
 class Properties::Node
@@ -51,24 +91,44 @@ public:
     void setValue(const char *v);
     void setNext(Node *next);
     void setPrevious(Node *previous);
+    void setOrigin(long line, long valueBegin, long valueFinish);
+    void setModified(bool m);
+    void addDuplicate(long line);
+    void clearDuplicates();
 
     char *getKey();
     char *getValue();
     Node *getNext();
     Node *getPrevious();
+    long getLineStart() const;
+    long getValueStart() const;
+    long getValueEnd() const;
+    bool hasOrigin() const;
+    bool isModified() const;
+    int getDuplicateCount() const;
+    long *getDuplicates();
 
     int hashCode() const;
     bool equals(Node *other);
     bool keyEquals(const char *k);
 
+    static int hash(const char *value);
+
 private:
     int keyHashCode;
     char *key;
     char *value;
     Node *next;
     Node *previous;
+    // position in Properties::source, -1 if the node was not loaded from it
+    long lineStart;
+    long valueStart;
+    long valueEnd;
+    bool modified;
+    // line starts of earlier occurrences of the key, shadowed by this one
+    long *duplicates;
+    int duplicateCount;
 
-    static int hash(const char *value);
     static bool stringCompare(const char *src, const char *dst);
     static char *stringCopy(const char *src);
 };
@@ -0,0 +1,386 @@
+#include "ReadinessProbe.h"
+
+#include <cstdlib>
+#include <cstring>
+#include "Logger.h"
+
+#if defined(UNIX) || defined(LINUX)
+#include <cerrno>
+#include <ctime>
+#include <dirent.h>
+#include <fcntl.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/epoll.h>
+#include <sys/inotify.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+#endif
+
+static const char STARTUP_LINE[] = "Server startup in";
+
+/* Static */
+static long long monotonicMillis() {
+#if defined(UNIX) || defined(LINUX)
+    struct timespec now{};
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (long long) now.tv_sec * 1000 + now.tv_nsec / 1000000;
+#else
+    return 0;
+#endif
+}
+
+static bool isCatalinaLog(const char *fileName) {
+    return 0 == strncmp(fileName, "catalina.", 9);
+}
+
+/* Construct */
+ReadinessProbe::ReadinessProbe() {
+    epollFd = -1;
+    inotifyFd = -1;
+    timerFd = -1;
+#if defined(UNIX) || defined(LINUX)
+    epollFd = epoll_create1(EPOLL_CLOEXEC);
+    inotifyFd = inotify_init1(IN_CLOEXEC | IN_NONBLOCK);
+    timerFd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK);
+
+    struct epoll_event event{};
+    event.events = EPOLLIN;
+    event.data.fd = inotifyFd;
+    epoll_ctl(epollFd, EPOLL_CTL_ADD, inotifyFd, &event);
+    event.data.fd = timerFd;
+    epoll_ctl(epollFd, EPOLL_CTL_ADD, timerFd, &event);
+#endif
+}
+
+ReadinessProbe::~ReadinessProbe() {
+#if defined(UNIX) || defined(LINUX)
+    for (auto &connection : connections) {
+        close(connection.first);
+    }
+    if (timerFd != -1) {
+        close(timerFd);
+    }
+    if (inotifyFd != -1) {
+        close(inotifyFd);
+    }
+    if (epollFd != -1) {
+        close(epollFd);
+    }
+#endif
+}
+
+/* Private */
+bool ReadinessProbe::finished() const {
+    for (auto &target : items) {
+        if (target.readyMillis < 0 && !target.timedOut) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool ReadinessProbe::pending(size_t target) const {
+    for (auto &connection : connections) {
+        if (connection.second.target == target) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void ReadinessProbe::tick(long long now) {
+    for (size_t i = 0; i < items.size(); i++) {
+        Target &target = items[i];
+        if (target.readyMillis >= 0 || target.timedOut) {
+            continue;
+        }
+        if (now >= target.deadline) {
+            target.timedOut = true;
+            continue;
+        }
+        if (pending(i)) {
+            continue;
+        }
+        if (target.listenMillis < 0) {
+            connectTarget(i, false, now);
+        } else if (!target.path.empty() && target.httpMillis < 0) {
+            connectTarget(i, true, now);
+        }
+    }
+}
+
+void ReadinessProbe::connectTarget(size_t target, bool http, long long now) {
+#if defined(UNIX) || defined(LINUX)
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd == -1) {
+        return;
+    }
+    struct sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_port = htons((uint16_t) items[target].port);
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    // refused connections fail right away and are retried on the next tick
+    int ret = connect(fd, (struct sockaddr *) &address, sizeof(address));
+    if (ret == -1 && errno != EINPROGRESS) {
+        close(fd);
+        return;
+    }
+
+    Connection connection;
+    connection.target = target;
+    connection.http = http;
+    connection.sent = false;
+    connections[fd] = connection;
+
+    struct epoll_event event{};
+    event.events = EPOLLOUT;
+    event.data.fd = fd;
+    epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &event);
+    if (ret == 0) {
+        onConnection(fd, now);
+    }
+#endif
+}
+
+void ReadinessProbe::onConnection(int fd, long long now) {
+#if defined(UNIX) || defined(LINUX)
+    auto found = connections.find(fd);
+    if (found == connections.end()) {
+        return;
+    }
+    Connection &connection = found->second;
+    Target &target = items[connection.target];
+
+    if (!connection.sent) {
+        int error = 0;
+        socklen_t length = sizeof(error);
+        if (0 != getsockopt(fd, SOL_SOCKET, SO_ERROR, &error, &length) || error != 0) {
+            closeConnection(fd);
+            return;
+        }
+        if (!connection.http) {
+            if (target.listenMillis < 0) {
+                target.listenMillis = now - target.addedAt;
+            }
+            size_t index = connection.target;
+            closeConnection(fd);
+            checkReady(index, now);
+            return;
+        }
+
+        std::string request = "GET " + target.path + " HTTP/1.0\r\nHost: 127.0.0.1\r\nConnection: close\r\n\r\n";
+        if (write(fd, request.c_str(), request.length()) != (ssize_t) request.length()) {
+            closeConnection(fd);
+            return;
+        }
+        connection.sent = true;
+        struct epoll_event event{};
+        event.events = EPOLLIN;
+        event.data.fd = fd;
+        epoll_ctl(epollFd, EPOLL_CTL_MOD, fd, &event);
+        return;
+    }
+
+    char buffer[512];
+    ssize_t count;
+    while ((count = read(fd, buffer, sizeof(buffer))) > 0 && connection.response.length() < 256) {
+        connection.response.append(buffer, (size_t) count);
+    }
+    bool closed = count == 0 || (count == -1 && errno != EAGAIN && errno != EWOULDBLOCK);
+    size_t lineEnd = connection.response.find("\r\n");
+    if (lineEnd == std::string::npos && !closed && connection.response.length() < 256) {
+        return;
+    }
+
+    // HTTP/1.x NNN
+    int status = 0;
+    if (connection.response.length() >= 12 && 0 == connection.response.compare(0, 5, "HTTP/")) {
+        status = atoi(connection.response.c_str() + 9);
+    }
+    target.httpStatus = status;
+    if (status >= 200 && status < 400) {
+        target.httpMillis = now - target.addedAt;
+    }
+    size_t index = connection.target;
+    closeConnection(fd);
+    checkReady(index, now);
+#endif
+}
+
+void ReadinessProbe::closeConnection(int fd) {
+#if defined(UNIX) || defined(LINUX)
+    epoll_ctl(epollFd, EPOLL_CTL_DEL, fd, nullptr);
+    close(fd);
+#endif
+    connections.erase(fd);
+}
+
+void ReadinessProbe::onLogChanged(long long now) {
+#if defined(UNIX) || defined(LINUX)
+    char buffer[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    ssize_t length;
+    while ((length = read(inotifyFd, buffer, sizeof(buffer))) > 0) {
+        for (char *pointer = buffer; pointer < buffer + length;) {
+            auto *event = (struct inotify_event *) pointer;
+            pointer += sizeof(struct inotify_event) + event->len;
+
+            auto found = followers.find(event->wd);
+            if (event->len == 0 || found == followers.end() || !isCatalinaLog(event->name)) {
+                continue;
+            }
+            readLog(found->second, event->name, now);
+        }
+    }
+#endif
+}
+
+void ReadinessProbe::readLog(LogFollower &follower, const std::string &fileName, long long now) {
+#if defined(UNIX) || defined(LINUX)
+    Target &target = items[follower.target];
+    if (target.startupMillis >= 0) {
+        return;
+    }
+
+    std::string path = target.logDirectory + "/" + fileName;
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd == -1) {
+        return;
+    }
+    long long &offset = follower.offsets[fileName];
+    struct stat status{};
+    if (0 == fstat(fd, &status) && status.st_size < offset) {
+        // truncated or replaced
+        offset = 0;
+    }
+
+    char buffer[8192];
+    ssize_t count;
+    while ((count = pread(fd, buffer, sizeof(buffer), (off_t) offset)) > 0) {
+        offset += count;
+        // keep the end of the previous chunk in case the line was split
+        follower.tail.append(buffer, (size_t) count);
+        if (follower.tail.find(STARTUP_LINE) != std::string::npos) {
+            target.startupMillis = now - target.addedAt;
+            break;
+        }
+        if (follower.tail.length() >= sizeof(STARTUP_LINE)) {
+            follower.tail.erase(0, follower.tail.length() - (sizeof(STARTUP_LINE) - 1));
+        }
+    }
+    close(fd);
+    checkReady(follower.target, now);
+#endif
+}
+
+void ReadinessProbe::checkReady(size_t target, long long now) {
+    Target &item = items[target];
+    if (item.readyMillis >= 0 || item.listenMillis < 0 || item.startupMillis < 0) {
+        return;
+    }
+    if (!item.path.empty() && item.httpMillis < 0) {
+        return;
+    }
+    item.readyMillis = now - item.addedAt;
+}
+
+/* Public */
+void ReadinessProbe::add(const std::string &name, int port, const std::string &path,
+                         const std::string &logDirectory, int timeoutMillis) {
+    Target target;
+    target.name = name;
+    target.port = port;
+    target.path = path;
+    target.logDirectory = logDirectory;
+    target.addedAt = monotonicMillis();
+    target.deadline = target.addedAt + timeoutMillis;
+    target.listenMillis = -1;
+    target.startupMillis = -1;
+    target.httpMillis = -1;
+    target.readyMillis = -1;
+    target.httpStatus = 0;
+    target.timedOut = false;
+    items.push_back(target);
+
+#if defined(UNIX) || defined(LINUX)
+    int wd = inotify_add_watch(inotifyFd, logDirectory.c_str(), IN_CREATE | IN_MODIFY | IN_MOVED_TO);
+    if (wd == -1) {
+        logger() << "[ERROR] ReadinessProbe::add: watch directory failed.[" << logDirectory << "]" << std::endl;
+        return;
+    }
+    LogFollower &follower = followers[wd];
+    follower.target = items.size() - 1;
+
+    // only lines written from now on count, catalina.<date>.log is appended
+    // by every start on the same day
+    DIR *directory = opendir(logDirectory.c_str());
+    if (directory != nullptr) {
+        struct dirent *entry;
+        while ((entry = readdir(directory)) != nullptr) {
+            struct stat status{};
+            std::string filePath = logDirectory + "/" + entry->d_name;
+            if (isCatalinaLog(entry->d_name) && 0 == stat(filePath.c_str(), &status)) {
+                follower.offsets[entry->d_name] = (long long) status.st_size;
+            }
+        }
+        closedir(directory);
+    }
+#endif
+}
+
+bool ReadinessProbe::run(long long waitMillis) {
+#if defined(UNIX) || defined(LINUX)
+    long long until = waitMillis < 0 ? -1 : monotonicMillis() + waitMillis;
+
+    struct itimerspec spec{};
+    spec.it_value.tv_nsec = 1;
+    spec.it_interval.tv_sec = INTERVAL_MILLIS / 1000;
+    spec.it_interval.tv_nsec = (long) (INTERVAL_MILLIS % 1000) * 1000000;
+    timerfd_settime(timerFd, 0, &spec, nullptr);
+
+    long long now = monotonicMillis();
+    while (!finished() && (until < 0 || now < until)) {
+        struct epoll_event events[16];
+        int timeout = until < 0 ? -1 : (int) (until - now);
+        int count = epoll_wait(epollFd, events, 16, timeout);
+        if (count == -1 && errno != EINTR) {
+            logger() << "[ERROR] ReadinessProbe::run: epoll_wait: " << strerror(errno) << std::endl;
+            break;
+        }
+
+        now = monotonicMillis();
+        for (int i = 0; i < count; i++) {
+            int fd = events[i].data.fd;
+            if (fd == timerFd) {
+                uint64_t expirations;
+                while (read(timerFd, &expirations, sizeof(expirations)) > 0) {}
+                tick(now);
+            } else if (fd == inotifyFd) {
+                onLogChanged(now);
+            } else {
+                onConnection(fd, now);
+            }
+        }
+    }
+
+    struct itimerspec disarm{};
+    timerfd_settime(timerFd, 0, &disarm, nullptr);
+
+    for (auto &target : items) {
+        if (target.readyMillis < 0) {
+            return false;
+        }
+    }
+    return true;
+#else
+    logger() << "[ERROR] ReadinessProbe::run: only supported on Linux." << std::endl;
+    return false;
+#endif
+}
+
+const std::vector<ReadinessProbe::Target> &ReadinessProbe::targets() const {
+    return items;
+}
@@ -0,0 +1,85 @@
+//
+// Created by arsia on 2026/10/19.
+//
+
+#ifndef APPFRAME_STARTER_READINESSPROBE_H
+#define APPFRAME_STARTER_READINESSPROBE_H
+
+#include <map>
+#include <string>
+#include <vector>
+
+/**
+ * Waits until Tomcat instances are actually serving.
+ *
+ * A target is listening once a non-blocking connect to its port on the
+ * loopback address succeeds. It is ready once it is listening, the
+ * "Server startup in" line has been appended to logs/catalina.* (followed
+ * with inotify, lines written before add() are ignored) and, when a path is
+ * given, an HTTP GET of that path answered with a 2xx or 3xx status.
+ * All times are milliseconds since add(). Only supported on Linux.
+ */
+class ReadinessProbe
+{
+public:
+    static const int INTERVAL_MILLIS = 100;
+
+    struct Target {
+        std::string name;
+        int port;
+        std::string path;
+        std::string logDirectory;
+        long long addedAt;
+        long long deadline;
+        long long listenMillis;
+        long long startupMillis;
+        long long httpMillis;
+        long long readyMillis;
+        int httpStatus;
+        bool timedOut;
+    };
+
+    ReadinessProbe();
+    ~ReadinessProbe();
+
+    ReadinessProbe(const ReadinessProbe &other) = delete;
+    ReadinessProbe &operator=(const ReadinessProbe &other) = delete;
+
+    void add(const std::string &name, int port, const std::string &path,
+             const std::string &logDirectory, int timeoutMillis);
+    bool run(long long waitMillis);
+    const std::vector<Target> &targets() const;
+
+private:
+    struct Connection {
+        size_t target;
+        bool http;
+        bool sent;
+        std::string response;
+    };
+
+    struct LogFollower {
+        size_t target;
+        std::map<std::string, long long> offsets;
+        std::string tail;
+    };
+
+    std::vector<Target> items;
+    std::map<int, Connection> connections;
+    std::map<int, LogFollower> followers;
+    int epollFd;
+    int inotifyFd;
+    int timerFd;
+
+    bool finished() const;
+    bool pending(size_t target) const;
+    void tick(long long now);
+    void connectTarget(size_t target, bool http, long long now);
+    void onConnection(int fd, long long now);
+    void closeConnection(int fd);
+    void onLogChanged(long long now);
+    void readLog(LogFollower &follower, const std::string &fileName, long long now);
+    void checkReady(size_t target, long long now);
+};
+
+#endif //APPFRAME_STARTER_READINESSPROBE_H
@@ -0,0 +1,395 @@
+#include "Supervisor.h"
+
+#include <cstring>
+#include "Logger.h"
+
+#if defined(UNIX) || defined(LINUX)
+#include <cerrno>
+#include <csignal>
+#include <ctime>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/epoll.h>
+#include <sys/signalfd.h>
+#include <sys/socket.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+#endif
+
+/* Static */
+static long long monotonicMillis() {
+#if defined(UNIX) || defined(LINUX)
+    struct timespec now{};
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (long long) now.tv_sec * 1000 + now.tv_nsec / 1000000;
+#else
+    return 0;
+#endif
+}
+
+#if defined(UNIX) || defined(LINUX)
+static void armTimer(int timerFd, long long deadline) {
+    struct itimerspec spec{};
+    // zero disarms the timer
+    if (deadline >= 0) {
+        spec.it_value.tv_sec = (time_t) (deadline / 1000);
+        spec.it_value.tv_nsec = (long) (deadline % 1000) * 1000000;
+        if (spec.it_value.tv_sec == 0 && spec.it_value.tv_nsec == 0) {
+            spec.it_value.tv_nsec = 1;
+        }
+    }
+    timerfd_settime(timerFd, TFD_TIMER_ABSTIME, &spec, nullptr);
+}
+#endif
+
+/* Construct */
+Supervisor::Supervisor(const Policy &policy) : policy(policy) {
+    stopping = false;
+    listener = nullptr;
+    listenerContext = nullptr;
+    exitListener = nullptr;
+    exitListenerContext = nullptr;
+    watchFd = -1;
+    watchListener = nullptr;
+    watchListenerContext = nullptr;
+}
+
+/* Private */
+void Supervisor::startService(Service &service, long long now) {
+    service.startedAt = now;
+    service.nextStart = -1;
+    if (service.launcher->start()) {
+        service.state = RUNNING;
+        logger() << "[INFO ] supervisor: " << service.name << " started, PID: " << service.launcher->pid() << std::endl;
+        if (listener != nullptr) {
+            listener((size_t) (&service - services.data()), service.launcher, listenerContext);
+        }
+    } else {
+        // a failed spawn is handled like a crash
+        onExit(service, -1, now);
+    }
+}
+
+void Supervisor::onExit(Service &service, int status, long long now) {
+    service.lastStatus = status;
+    service.killAt = -1;
+    if (exitListener != nullptr) {
+        exitListener((size_t) (&service - services.data()), status, exitListenerContext);
+    }
+    if (!stopping && service.nextLauncher != nullptr) {
+        service.launcher = service.nextLauncher;
+        service.shutdownPort = service.nextShutdownPort;
+        service.nextLauncher = nullptr;
+        service.crashes = 0;
+        service.state = WAITING;
+        service.nextStart = now;
+        logger() << "[INFO ] supervisor: " << service.name << " exited with status " << status
+                 << ", restart with the new launcher" << std::endl;
+        return;
+    }
+    if (stopping) {
+        service.state = STOPPED;
+        logger() << "[INFO ] supervisor: " << service.name << " stopped with status " << status << std::endl;
+        return;
+    }
+    if (status == 0) {
+        service.state = STOPPED;
+        logger() << "[INFO ] supervisor: " << service.name << " exited with status 0, not restarted" << std::endl;
+        return;
+    }
+
+    if (now - service.startedAt >= policy.maxBackoffMillis) {
+        service.crashes = 0;
+    }
+    service.crashes++;
+    if (service.crashes > policy.restartLimit) {
+        service.state = FAILED;
+        logger() << "[ERROR] supervisor: " << service.name << " exited with status " << status << ", crashed "
+                 << service.crashes << " times in a row, give up" << std::endl;
+        return;
+    }
+
+    long long delay = policy.backoffMillis;
+    for (int i = 1; i < service.crashes && delay < policy.maxBackoffMillis; i++) {
+        delay *= 2;
+    }
+    if (delay > policy.maxBackoffMillis) {
+        delay = policy.maxBackoffMillis;
+    }
+    service.state = WAITING;
+    service.nextStart = now + delay;
+    logger() << "[WARN ] supervisor: " << service.name << " exited with status " << status << ", restart in "
+             << delay << "ms (" << service.crashes << "/" << policy.restartLimit << ")" << std::endl;
+}
+
+void Supervisor::requestStop(Service &service) {
+#if defined(UNIX) || defined(LINUX)
+    if (service.state == WAITING) {
+        service.state = STOPPED;
+        return;
+    }
+    if (service.state != RUNNING) {
+        return;
+    }
+    if (sendShutdown(service.shutdownPort)) {
+        logger() << "[INFO ] supervisor: shutdown sent to " << service.name << " (port " << service.shutdownPort << ")"
+                 << std::endl;
+    } else {
+        logger() << "[INFO ] supervisor: shutdown port of " << service.name << " is closed, send SIGTERM" << std::endl;
+        kill((pid_t) service.launcher->pid(), SIGTERM);
+    }
+#endif
+}
+
+long long Supervisor::nextDeadline(long long stopDeadline) const {
+    long long deadline = stopping ? stopDeadline : -1;
+    for (auto &service : services) {
+        if (service.state == WAITING && (deadline < 0 || service.nextStart < deadline)) {
+            deadline = service.nextStart;
+        }
+        if (service.state == RUNNING && service.killAt >= 0 && (deadline < 0 || service.killAt < deadline)) {
+            deadline = service.killAt;
+        }
+    }
+    return deadline;
+}
+
+bool Supervisor::finished() const {
+    for (auto &service : services) {
+        if (service.state == RUNNING || service.state == WAITING) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/* Public */
+void Supervisor::setListener(Listener listener, void *context) {
+    this->listener = listener;
+    listenerContext = context;
+}
+
+void Supervisor::setExitListener(ExitListener listener, void *context) {
+    exitListener = listener;
+    exitListenerContext = context;
+}
+
+void Supervisor::watch(int fd, WatchListener listener, void *context) {
+    watchFd = fd;
+    watchListener = listener;
+    watchListenerContext = context;
+}
+
+void Supervisor::restart(size_t index, Launcher *launcher, int shutdownPort) {
+    if (stopping || index >= services.size()) {
+        return;
+    }
+    Service &service = services[index];
+    if (service.state == RUNNING) {
+        // started by onExit() once the running process is gone
+        if (service.nextLauncher == nullptr) {
+            requestStop(service);
+            service.killAt = monotonicMillis() + policy.shutdownTimeoutMillis;
+        }
+        service.nextLauncher = launcher;
+        service.nextShutdownPort = shutdownPort;
+        return;
+    }
+    // waiting for a backoff, stopped or given up: start at once
+    service.launcher = launcher;
+    service.shutdownPort = shutdownPort;
+    service.crashes = 0;
+    service.state = WAITING;
+    service.nextStart = monotonicMillis();
+}
+
+void Supervisor::add(const std::string &name, Launcher *launcher, int shutdownPort) {
+    Service service;
+    service.name = name;
+    service.launcher = launcher;
+    service.shutdownPort = shutdownPort;
+    service.state = WAITING;
+    service.crashes = 0;
+    service.lastStatus = 0;
+    service.startedAt = 0;
+    service.nextStart = 0;
+    service.nextLauncher = nullptr;
+    service.nextShutdownPort = 0;
+    service.killAt = -1;
+    services.push_back(service);
+}
+
+int Supervisor::run() {
+#if defined(UNIX) || defined(LINUX)
+    // blocked before the first spawn so no SIGCHLD is lost, the children get
+    // an empty mask from the Launcher
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGCHLD);
+    sigaddset(&signals, SIGTERM);
+    sigaddset(&signals, SIGINT);
+    sigset_t previous;
+    if (0 != sigprocmask(SIG_BLOCK, &signals, &previous)) {
+        logger() << "[ERROR] Supervisor::run: sigprocmask: " << strerror(errno) << std::endl;
+        return 1;
+    }
+
+    int signalFd = signalfd(-1, &signals, SFD_CLOEXEC | SFD_NONBLOCK);
+    int timerFd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK);
+    int epollFd = epoll_create1(EPOLL_CLOEXEC);
+    if (signalFd == -1 || timerFd == -1 || epollFd == -1) {
+        logger() << "[ERROR] Supervisor::run: create descriptors: " << strerror(errno) << std::endl;
+        return 1;
+    }
+    struct epoll_event event{};
+    event.events = EPOLLIN;
+    event.data.fd = signalFd;
+    epoll_ctl(epollFd, EPOLL_CTL_ADD, signalFd, &event);
+    event.data.fd = timerFd;
+    epoll_ctl(epollFd, EPOLL_CTL_ADD, timerFd, &event);
+    if (watchFd != -1 && watchListener != nullptr) {
+        event.data.fd = watchFd;
+        epoll_ctl(epollFd, EPOLL_CTL_ADD, watchFd, &event);
+    }
+
+    long long now = monotonicMillis();
+    for (size_t i = 0; i < services.size(); i++) {
+        services[i].nextStart = now + (long long) i * policy.staggerMillis;
+    }
+
+    long long stopDeadline = -1;
+    while (true) {
+        // start everything that is due before going to sleep
+        now = monotonicMillis();
+        for (auto &service : services) {
+            if (!stopping && service.state == WAITING && service.nextStart <= now) {
+                startService(service, now);
+            }
+        }
+        if (finished()) {
+            break;
+        }
+        armTimer(timerFd, nextDeadline(stopDeadline));
+
+        struct epoll_event events[3];
+        int count = epoll_wait(epollFd, events, 3, -1);
+        if (count == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            logger() << "[ERROR] Supervisor::run: epoll_wait: " << strerror(errno) << std::endl;
+            break;
+        }
+
+        now = monotonicMillis();
+        for (int i = 0; i < count; i++) {
+            if (events[i].data.fd == timerFd) {
+                uint64_t expirations;
+                while (read(timerFd, &expirations, sizeof(expirations)) > 0) {}
+                if (stopping && stopDeadline >= 0 && now >= stopDeadline) {
+                    for (auto &service : services) {
+                        if (service.state == RUNNING) {
+                            logger() << "[WARN ] supervisor: " << service.name << " did not stop in time, kill it"
+                                     << std::endl;
+                            kill((pid_t) service.launcher->pid(), SIGKILL);
+                        }
+                    }
+                    stopDeadline = -1;
+                }
+                for (auto &service : services) {
+                    if (service.state == RUNNING && service.killAt >= 0 && now >= service.killAt) {
+                        logger() << "[WARN ] supervisor: " << service.name
+                                 << " did not stop in time for the restart, kill it" << std::endl;
+                        kill((pid_t) service.launcher->pid(), SIGKILL);
+                        service.killAt = -1;
+                    }
+                }
+                continue;
+            }
+            if (events[i].data.fd == watchFd) {
+                if (stopping) {
+                    // level triggered, stop watching instead of spinning
+                    epoll_ctl(epollFd, EPOLL_CTL_DEL, watchFd, nullptr);
+                } else {
+                    watchListener(watchListenerContext);
+                }
+                continue;
+            }
+
+            struct signalfd_siginfo info{};
+            bool childExited = false;
+            while (read(signalFd, &info, sizeof(info)) == (ssize_t) sizeof(info)) {
+                if (info.ssi_signo == SIGCHLD) {
+                    childExited = true;
+                } else if (!stopping) {
+                    logger() << "[INFO ] supervisor: received " << strsignal((int) info.ssi_signo)
+                             << ", stopping all regions" << std::endl;
+                    stopping = true;
+                    stopDeadline = now + policy.shutdownTimeoutMillis;
+                    for (auto &service : services) {
+                        requestStop(service);
+                    }
+                } else {
+                    // a second signal does not wait for the timeout
+                    for (auto &service : services) {
+                        if (service.state == RUNNING) {
+                            kill((pid_t) service.launcher->pid(), SIGKILL);
+                        }
+                    }
+                }
+            }
+
+            // SIGCHLD coalesces, so check every running child
+            if (childExited) {
+                for (auto &service : services) {
+                    if (service.state == RUNNING && service.launcher->tryWait()) {
+                        onExit(service, service.launcher->exitStatus(), now);
+                    }
+                }
+            }
+        }
+    }
+
+    close(epollFd);
+    close(timerFd);
+    close(signalFd);
+    sigprocmask(SIG_SETMASK, &previous, nullptr);
+
+    int result = 0;
+    for (auto &service : services) {
+        if (service.state == FAILED && result == 0) {
+            result = service.lastStatus > 0 ? service.lastStatus : 1;
+        }
+    }
+    return result;
+#else
+    logger() << "[ERROR] Supervisor::run: only supported on Linux." << std::endl;
+    return 1;
+#endif
+}
+
+bool Supervisor::sendShutdown(int port) {
+#if defined(UNIX) || defined(LINUX)
+    if (port <= 0) {
+        return false;
+    }
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd == -1) {
+        return false;
+    }
+    struct sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_port = htons((uint16_t) port);
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    bool sent = false;
+    if (0 == connect(fd, (struct sockaddr *) &address, sizeof(address))) {
+        const char command[] = "SHUTDOWN";
+        sent = write(fd, command, sizeof(command) - 1) == (ssize_t) (sizeof(command) - 1);
+    }
+    close(fd);
+    return sent;
+#else
+    return false;
+#endif
+}
@@ -0,0 +1,109 @@
+//
+// Created by arsia on 2026/10/19.
+//
+
+#ifndef APPFRAME_STARTER_SUPERVISOR_H
+#define APPFRAME_STARTER_SUPERVISOR_H
+
+#include <string>
+#include <vector>
+#include "Launcher.h"
+
+/**
+ * Keeps a set of processes running.
+ *
+ * run() starts every service (staggered), then sleeps in epoll on a signalfd
+ * and a one-shot timerfd, so an idle supervisor never wakes up. A service
+ * that exits with a non-zero status is restarted after an exponential
+ * backoff; after restartLimit crashes in a row it is given up. A run longer
+ * than maxBackoffMillis counts as stable and resets the crash counter, an
+ * exit status of 0 stops the service without restart.
+ *
+ * SIGTERM/SIGINT stop all services: "SHUTDOWN" is sent to the shutdown port
+ * (SIGTERM to the process when nothing listens), and services still running
+ * after shutdownTimeoutMillis, or on a second signal, are killed. run()
+ * returns 0, or the last status of a service that was given up.
+ *
+ * restart() stops a service the same way and starts it again with a new
+ * launcher as soon as it exited, without backoff. watch() adds a descriptor
+ * to the epoll set; its listener runs on the supervisor thread whenever the
+ * descriptor is readable, so it may call restart() directly.
+ * Only supported on Linux.
+ */
+class Supervisor
+{
+public:
+    struct Policy {
+        int staggerMillis;
+        int backoffMillis;
+        int maxBackoffMillis;
+        int restartLimit;
+        int shutdownTimeoutMillis;
+    };
+
+    // called after every successful start of the service at index
+    typedef void (*Listener)(size_t index, Launcher *launcher, void *context);
+    // called after every exit of the service at index, -1 when the spawn failed
+    typedef void (*ExitListener)(size_t index, int status, void *context);
+    // called on the supervisor thread when the watched descriptor is readable
+    typedef void (*WatchListener)(void *context);
+
+    explicit Supervisor(const Policy &policy);
+
+    Supervisor(const Supervisor &other) = delete;
+    Supervisor &operator=(const Supervisor &other) = delete;
+
+    void add(const std::string &name, Launcher *launcher, int shutdownPort);
+    void setListener(Listener listener, void *context);
+    void setExitListener(ExitListener listener, void *context);
+    // before run()
+    void watch(int fd, WatchListener listener, void *context);
+    // from a listener during run(), the launcher must outlive the supervisor
+    void restart(size_t index, Launcher *launcher, int shutdownPort);
+    int run();
+
+    // sends "SHUTDOWN" to a Tomcat shutdown port on localhost
+    static bool sendShutdown(int port);
+
+private:
+    enum State {
+        WAITING,
+        RUNNING,
+        STOPPED,
+        FAILED
+    };
+
+    struct Service {
+        std::string name;
+        Launcher *launcher;
+        int shutdownPort;
+        State state;
+        int crashes;
+        int lastStatus;
+        long long startedAt;
+        long long nextStart;
+        // set by restart() until the running process exited
+        Launcher *nextLauncher;
+        int nextShutdownPort;
+        long long killAt;
+    };
+
+    Policy policy;
+    std::vector<Service> services;
+    bool stopping;
+    Listener listener;
+    void *listenerContext;
+    ExitListener exitListener;
+    void *exitListenerContext;
+    int watchFd;
+    WatchListener watchListener;
+    void *watchListenerContext;
+
+    void startService(Service &service, long long now);
+    void onExit(Service &service, int status, long long now);
+    void requestStop(Service &service);
+    long long nextDeadline(long long stopDeadline) const;
+    bool finished() const;
+};
+
+#endif //APPFRAME_STARTER_SUPERVISOR_H
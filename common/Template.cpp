@@ -0,0 +1,120 @@
+#include "Template.h"
+
+#include <cstring>
+#include "Logger.h"
+
+/* Construct */
+Template::Template() {
+    compiled = false;
+}
+
+/* Private */
+size_t Template::walk(const std::string *values, std::string *output) const {
+    size_t size = 0;
+    size_t i = 0;
+    while (i < segments.size()) {
+        const Segment &segment = segments[i];
+        switch (segment.kind) {
+            case LITERAL:
+                size += segment.length;
+                if (output != nullptr) {
+                    output->append(text, segment.offset, segment.length);
+                }
+                break;
+            case VALUE:
+                size += values[segment.value].size();
+                if (output != nullptr) {
+                    output->append(values[segment.value]);
+                }
+                break;
+            case SECTION:
+            case INVERTED:
+                // skip to the END, the loop steps over it
+                if (values[segment.value].empty() == (segment.kind == SECTION)) {
+                    i = segment.end;
+                }
+                break;
+            case END:
+                break;
+        }
+        i++;
+    }
+    return size;
+}
+
+/* Public */
+bool Template::compile(const std::string &text, const char *const *names, size_t count) {
+    this->text = text;
+    segments.clear();
+    compiled = false;
+
+    std::vector<size_t> open;
+    size_t position = 0;
+    while (position < text.size()) {
+        size_t begin = text.find("${", position);
+        if (begin == std::string::npos) {
+            begin = text.size();
+        }
+        if (begin > position) {
+            segments.push_back({LITERAL, position, begin - position, -1, 0});
+        }
+        if (begin == text.size()) {
+            break;
+        }
+        size_t finish = text.find('}', begin);
+        if (finish == std::string::npos) {
+            logger() << "[ERROR] Template::compile: unclosed ${ at " << begin << "." << std::endl;
+            return false;
+        }
+
+        Kind kind = VALUE;
+        size_t nameBegin = begin + 2;
+        if (text[nameBegin] == '#' || text[nameBegin] == '^' || text[nameBegin] == '/') {
+            kind = text[nameBegin] == '#' ? SECTION : text[nameBegin] == '^' ? INVERTED : END;
+            nameBegin++;
+        }
+        std::string name = text.substr(nameBegin, finish - nameBegin);
+        int value = -1;
+        for (size_t i = 0; i < count; i++) {
+            if (name == names[i]) {
+                value = (int) i;
+                break;
+            }
+        }
+        if (value == -1) {
+            logger() << "[ERROR] Template::compile: unknown value ${" << name << "}." << std::endl;
+            return false;
+        }
+
+        if (kind == END) {
+            if (open.empty() || segments[open.back()].value != value) {
+                logger() << "[ERROR] Template::compile: ${/" << name << "} does not close a section." << std::endl;
+                return false;
+            }
+            segments[open.back()].end = segments.size();
+            open.pop_back();
+        } else if (kind != VALUE) {
+            open.push_back(segments.size());
+        }
+        segments.push_back({kind, 0, 0, value, 0});
+        position = finish + 1;
+    }
+    if (!open.empty()) {
+        logger() << "[ERROR] Template::compile: section ${#" << names[segments[open.back()].value] << "} is not closed."
+                 << std::endl;
+        return false;
+    }
+    compiled = true;
+    return true;
+}
+
+bool Template::isCompiled() const {
+    return compiled;
+}
+
+std::string Template::render(const std::string *values) const {
+    std::string output;
+    output.reserve(walk(values, nullptr));
+    walk(values, &output);
+    return output;
+}
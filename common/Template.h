@@ -0,0 +1,56 @@
+//
+// Created by arsia on 2026/10/19.
+//
+
+#ifndef APPFRAME_STARTER_TEMPLATE_H
+#define APPFRAME_STARTER_TEMPLATE_H
+
+#include <string>
+#include <vector>
+
+/**
+ * A text template compiled once into literal and value segments.
+ *
+ * ${name} is replaced by a value; ${#name}...${/name} is only emitted when the
+ * value is not empty, ${^name}...${/name} only when it is empty. compile()
+ * resolves every name to its index in the list of known names, so render()
+ * takes the values as an array and does no lookups. render() measures the
+ * output first and builds it with a single allocation.
+ */
+class Template
+{
+public:
+    Template();
+
+    bool compile(const std::string &text, const char *const *names, size_t count);
+    bool isCompiled() const;
+    std::string render(const std::string *values) const;
+
+private:
+    enum Kind {
+        LITERAL,
+        VALUE,
+        SECTION,
+        INVERTED,
+        END
+    };
+
+    struct Segment {
+        Kind kind;
+        // LITERAL: offset and length in text
+        size_t offset;
+        size_t length;
+        // index of the value
+        int value;
+        // SECTION/INVERTED: index of the matching END
+        size_t end;
+    };
+
+    std::string text;
+    std::vector<Segment> segments;
+    bool compiled;
+
+    size_t walk(const std::string *values, std::string *output) const;
+};
+
+#endif //APPFRAME_STARTER_TEMPLATE_H
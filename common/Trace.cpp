@@ -0,0 +1,155 @@
+#include "Trace.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <map>
+#include <mutex>
+#include <utility>
+#include <vector>
+#include "Logger.h"
+
+namespace {
+
+struct Event {
+    char phase;
+    const char *name;
+    std::string track;
+    int tid;
+    long long timestamp;
+    long long duration;
+};
+
+struct Recorder {
+    std::mutex mutex;
+    std::vector<Event> events;
+    std::map<std::pair<std::string, std::string>, long long> counters;
+    std::chrono::steady_clock::time_point origin = std::chrono::steady_clock::now();
+    int mainThread = 0;
+};
+
+Recorder &recorder() {
+    static Recorder instance;
+    return instance;
+}
+
+thread_local std::string currentTrack;
+
+int threadId() {
+    static std::atomic<int> next(1);
+    thread_local int id = next.fetch_add(1);
+    return id;
+}
+
+void appendEscaped(std::string &out, const std::string &value) {
+    for (char c : value) {
+        if (c == '"' || c == '\\') {
+            out.push_back('\\');
+            out.push_back(c);
+        } else if ((unsigned char) c < 0x20) {
+            char escaped[8];
+            snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+            out.append(escaped);
+        } else {
+            out.push_back(c);
+        }
+    }
+}
+
+}
+
+bool Trace::active = false;
+
+/* Private */
+long long Trace::now() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - recorder().origin).count();
+}
+
+void Trace::complete(const char *name, long long begin, long long end) {
+    Recorder &instance = recorder();
+    Event event{'X', name, currentTrack, threadId(), begin, end - begin};
+    std::lock_guard<std::mutex> lock(instance.mutex);
+    instance.events.push_back(event);
+}
+
+/* Public */
+void Trace::enable() {
+    // start the clock before the first event
+    recorder().mainThread = threadId();
+    active = true;
+}
+
+const std::string &Trace::getTrack() {
+    return currentTrack;
+}
+
+void Trace::setTrack(const std::string &track) {
+    currentTrack = track;
+}
+
+void Trace::count(const char *name, long long delta) {
+    if (!active) {
+        return;
+    }
+    Recorder &instance = recorder();
+    long long timestamp = now();
+    std::lock_guard<std::mutex> lock(instance.mutex);
+    long long &total = instance.counters[std::make_pair(currentTrack, std::string(name))];
+    total += delta;
+    // the value of a counter event is carried in the duration field
+    instance.events.push_back(Event{'C', name, currentTrack, threadId(), timestamp, total});
+}
+
+bool Trace::write(const std::string &path, const std::string &track) {
+    if (!active) {
+        return true;
+    }
+
+    std::string json = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    std::map<int, std::string> threads;
+    char number[64];
+    {
+        Recorder &instance = recorder();
+        std::lock_guard<std::mutex> lock(instance.mutex);
+        for (auto &event : instance.events) {
+            if (!event.track.empty() && event.track != track) {
+                continue;
+            }
+            if (threads.find(event.tid) == threads.end()) {
+                snprintf(number, sizeof(number), "worker %d", event.tid);
+                threads[event.tid] = event.tid == instance.mainThread ? "main" : number;
+            }
+
+            json.append("{\"name\":\"");
+            appendEscaped(json, event.track.empty() || event.phase != 'C' ? event.name
+                                                                         : event.track + " " + event.name);
+            json.append("\",\"cat\":\"appframe\",\"ph\":\"").push_back(event.phase);
+            snprintf(number, sizeof(number), "\",\"pid\":1,\"tid\":%d,\"ts\":%lld", event.tid, event.timestamp);
+            json.append(number);
+            if (event.phase == 'X') {
+                snprintf(number, sizeof(number), ",\"dur\":%lld", event.duration);
+            } else {
+                snprintf(number, sizeof(number), ",\"args\":{\"value\":%lld}", event.duration);
+            }
+            json.append(number).append("},\n");
+        }
+    }
+    for (auto &thread : threads) {
+        snprintf(number, sizeof(number), "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,",
+                 thread.first);
+        json.append(number).append("\"args\":{\"name\":\"");
+        appendEscaped(json, thread.second);
+        json.append("\"}},\n");
+    }
+    json.append("{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"appframe-starter\"}}\n]}\n");
+
+    FILE *file = fopen(path.c_str(), "wb");
+    if (file == nullptr) {
+        logger() << "[ERROR] Trace::write: open file failed.[" << path << "]" << std::endl;
+        return false;
+    }
+    bool success = fwrite(json.data(), 1, json.length(), file) == json.length();
+    fclose(file);
+    return success;
+}
@@ -0,0 +1,105 @@
+//
+// Created by arsia on 2026/10/19.
+//
+
+#ifndef APPFRAME_STARTER_TRACE_H
+#define APPFRAME_STARTER_TRACE_H
+
+#include <string>
+
+/**
+ * Startup tracing in the Chrome trace event format (Perfetto, chrome://tracing).
+ *
+ * Scopes become complete ("X") events, counters become "C" events carrying the
+ * running total of the counter. Every event is tagged with the track of the
+ * calling thread (a region name, or empty for work shared by all regions), so
+ * write() can put one region's events next to the shared ones.
+ *
+ * Tracing is off until enable() is called; a disabled Scope or count() is a
+ * single load of a bool. Names must be string literals, they are not copied.
+ */
+class Trace
+{
+public:
+    class Scope;
+    class TrackScope;
+
+    static void enable();
+    static bool enabled() {
+        return active;
+    }
+
+    static const std::string &getTrack();
+    static void setTrack(const std::string &track);
+    static void count(const char *name, long long delta);
+    static bool write(const std::string &path, const std::string &track);
+
+private:
+    static bool active;
+
+    static long long now();
+    static void complete(const char *name, long long begin, long long end);
+};
+
+/**
+ * Records the time between construction and destruction, or end().
+ */
+class Trace::Scope
+{
+public:
+    explicit Scope(const char *name) : name(name) {
+        begin = Trace::active ? Trace::now() : -1;
+    }
+
+    ~Scope() {
+        end();
+    }
+
+    void end() {
+        if (begin >= 0) {
+            Trace::complete(name, begin, Trace::now());
+            begin = -1;
+        }
+    }
+
+    Scope(const Scope &other) = delete;
+    Scope &operator=(const Scope &other) = delete;
+
+private:
+    const char *name;
+    long long begin;
+};
+
+/**
+ * Sets the track of the calling thread and restores the previous one.
+ */
+class Trace::TrackScope
+{
+public:
+    explicit TrackScope(const std::string &track) : active(Trace::active) {
+        if (active) {
+            previous = Trace::getTrack();
+            Trace::setTrack(track);
+        }
+    }
+
+    ~TrackScope() {
+        if (active) {
+            Trace::setTrack(previous);
+        }
+    }
+
+    TrackScope(const TrackScope &other) = delete;
+    TrackScope &operator=(const TrackScope &other) = delete;
+
+private:
+    bool active;
+    std::string previous;
+};
+
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+#define TRACE_SCOPE(name) Trace::Scope TRACE_CONCAT(traceScope, __LINE__)(name)
+#define TRACE_COUNT(name, delta) do { if (Trace::enabled()) Trace::count(name, delta); } while (0)
+
+#endif //APPFRAME_STARTER_TRACE_H
@@ -1,8 +1,30 @@
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
 #include <iostream>
+#include <memory>
+#include <sstream>
 #include <string>
+#include <thread>
+#include <vector>
 #include "afdef.h"
 #include "common.h"
 #include "Properties.h"
+#include "ConfigWatcher.h"
+#include "ConsoleCapture.h"
+#include "JvmSizing.h"
+#include "Launcher.h"
+#include "LogRetention.h"
+#include "LogStat.h"
+#include "Metrics.h"
+#include "Placement.h"
+#include "PortPlanner.h"
+#include "ProcSampler.h"
+#include "ReadinessProbe.h"
+#include "Supervisor.h"
+#include "Trace.h"
 
 #if defined(WINDOWS)
 
@@ -10,7 +32,7 @@
 #include <cstring>
 
 #elif defined(UNIX) || defined(LINUX)
-#include <io.h>
+#include <unistd.h>
 #endif
 
 #define MAX_PATH_LENGTH 1024
@@ -19,15 +41,179 @@ std::string programDirectory;
 std::string tomcatLocation;
 std::string javaHome;
 std::string javaOptions;
-std::string warFile;
-std::string bsHomeDirectory;
-std::string targetDirectory;
+std::string launchMode;
+bool consoleCapture = false;
+bool classDataSharing = false;
+bool jvmSizing = false;
+int sizingHeapPercent = 70;
+std::string numaPlacement;
+bool slotsEnabled = false;
+int slotPortOffset = 1000;
+Template serverXmlTemplate;
+int samplerInterval = 0;
+int samplerCapacity = 3600;
+LogRetention::Policy logsPolicy{};
+std::string metricsAddress;
+int metricsPort = 0;
+Metrics metrics;
+std::vector<RegionMetrics> regionMetrics;
+long long programStart = Metrics::now();
+ConsoleCapture::Policy consolePolicy{};
 
-std::string tomcatShutdownPort;
-std::string tomcatHttpPort;
-std::string tomcatHttpsPort;
-std::string tomcatJmxPort;
-std::string tomcatAjpPort;
+/**
+ * 区域配置
+ */
+struct Region {
+    std::string name;
+    // blue | green, 空表示不使用槽位
+    std::string slot;
+    // --redeploy 时被替换的槽位
+    std::string previousSlot;
+    std::string warFile;
+    std::string bsHomeDirectory;
+    std::string targetDirectory;
+
+    std::string shutdownPort;
+    std::string httpPort;
+    std::string httpsPort;
+    std::string jmxPort;
+    std::string ajpPort;
+    std::string httpsKeystore;
+    std::string httpsKeystorePassword;
+
+    // JMX 认证, jmx.port 设置时有效
+    bool jmxAuthenticate;
+    std::string jmxPasswordFile;
+    std::string jmxAccessFile;
+
+    // 连接器和线程池配置, 未设置时为空 (使用 Tomcat 默认值)
+    std::string connectorProtocol;
+    std::string maxThreads;
+    std::string minSpareThreads;
+    std::string acceptCount;
+    std::string maxConnections;
+    std::string keepAliveTimeout;
+    std::string maxKeepAliveRequests;
+    std::string compression;
+
+    // dev | production
+    std::string profile;
+
+    std::string readyPath;
+
+    // AppCDS 参数, 未启用时为空
+    std::string cdsOption;
+
+    // 按 cgroup 限制生成的 JVM 参数, 未启用时为空
+    double sizingWeight;
+    std::vector<std::string> sizingOptions;
+
+    // CPU 和 NUMA 节点, 未设置时为空
+    std::string cpuSet;
+    std::string numaNode;
+    std::vector<int> placementCpus;
+    int placementNode;
+
+    // common.metrics.listen 未设置时为 nullptr
+    RegionMetrics *metrics;
+};
+
+/**
+ * 区域端口配置项
+ */
+struct PortKey {
+    const char *suffix;
+    std::string Region::*field;
+};
+
+const PortKey REGION_PORTS[] = {
+        {APPDRAME_SHUTDOWN_PORT, &Region::shutdownPort},
+        {APPFRAME_HTTP_PORT,     &Region::httpPort},
+        {APPFRAME_HTTPS_PORT,    &Region::httpsPort},
+        {APPFRAME_AJP_PORT,      &Region::ajpPort},
+        {APPFRAME_JMX_PORT,      &Region::jmxPort}
+};
+
+/**
+ * 区域连接器整数配置项, 值不能小于 min
+ */
+struct ConnectorKey {
+    const char *suffix;
+    std::string Region::*field;
+    long min;
+};
+
+const ConnectorKey CONNECTOR_KEYS[] = {
+        {APPFRAME_CONNECTOR_MAX_THREADS,             &Region::maxThreads,           1},
+        {APPFRAME_CONNECTOR_MIN_SPARE_THREADS,       &Region::minSpareThreads,      0},
+        {APPFRAME_CONNECTOR_ACCEPT_COUNT,            &Region::acceptCount,          1},
+        {APPFRAME_CONNECTOR_MAX_CONNECTIONS,         &Region::maxConnections,       -1},
+        {APPFRAME_CONNECTOR_KEEP_ALIVE_TIMEOUT,      &Region::keepAliveTimeout,     -1},
+        {APPFRAME_CONNECTOR_MAX_KEEP_ALIVE_REQUESTS, &Region::maxKeepAliveRequests, -1}
+};
+
+/**
+ * 连接器协议对应的 HTTP 和 HTTPS 连接器 protocol 属性
+ */
+struct ConnectorProtocol {
+    const char *name;
+    const char *http;
+    const char *https;
+};
+
+const ConnectorProtocol CONNECTOR_PROTOCOLS[] = {
+        {"HTTP/1.1", "HTTP/1.1",                                    "org.apache.coyote.http11.Http11NioProtocol"},
+        {"nio",      "org.apache.coyote.http11.Http11NioProtocol",  "org.apache.coyote.http11.Http11NioProtocol"},
+        {"nio2",     "org.apache.coyote.http11.Http11Nio2Protocol", "org.apache.coyote.http11.Http11Nio2Protocol"},
+        {"apr",      "org.apache.coyote.http11.Http11AprProtocol",  "org.apache.coyote.http11.Http11AprProtocol"}
+};
+
+/**
+ * 解析整数配置
+ *
+ * @param value 配置值
+ * @param min 最小值
+ * @param number 解析结果
+ * @return 是否为不小于 min 的整数
+ */
+bool parseInteger(const std::string &value, long min, long &number) {
+    if (value.empty()) {
+        return false;
+    }
+    char *end = nullptr;
+    errno = 0;
+    number = strtol(value.c_str(), &end, 10);
+    return errno == 0 && *end == '\0' && number >= min && number <= INT32_MAX;
+}
+
+/**
+ * 区域的 logs 目录
+ *
+ * @param targetDirectory 区域 CATALINA_BASE
+ * @return logs 目录, 不带结尾分隔符
+ */
+std::string logsDirectory(const std::string &targetDirectory) {
+#if defined(WINDOWS)
+    return targetDirectory + "\\logs";
+#elif defined(UNIX) || defined(LINUX)
+    return targetDirectory + "/logs";
+#endif
+}
+
+/**
+ * 查找连接器协议
+ *
+ * @param name 协议名称
+ * @return 协议, 不支持时为 nullptr
+ */
+const ConnectorProtocol *findConnectorProtocol(const std::string &name) {
+    for (auto &protocol : CONNECTOR_PROTOCOLS) {
+        if (name == protocol.name) {
+            return &protocol;
+        }
+    }
+    return nullptr;
+}
 
 /**
  * 确认可以使用环境变量配置的必须项
@@ -43,12 +229,12 @@ bool checkEnv(const char *name, Properties *properties, const char *key, std::st
     value = convent2string(properties->get(key));
     if (isBlank(value)) {
         if (enableDebug) {
-            std::cout << "[DEBUG] " << key << " not found." << std::endl;
+            logger() << "[DEBUG] " << key << " not found." << std::endl;
         }
         // check environment variable
         value = convent2string(getenv(name));
         if (isBlank(value)) {
-            std::cout << key << " is \"\", please set " << name << " or " << key << std::endl;
+            logger() << key << " is \"\", please set " << name << " or " << key << std::endl;
             return false;
         } else {
             printKeyValue(name, value);
@@ -71,11 +257,11 @@ bool checkEnv(const char *name, Properties *properties, const char *key, std::st
 void checkNoRequired(Properties *properties, const char *key, std::string &value, const char *defaultValue) {
     value = convent2string(properties->get(key));
     if (isBlank(value)) {
-        std::cout << "[INFO ] " << key << " not found, use default value: "
-                  << defaultValue << std::endl;
+        logger() << "[INFO ] " << key << " not found, use default value: "
+                 << defaultValue << std::endl;
         value = defaultValue;
     } else {
-        std::cout << "[INFO ] " << key << ": " << value << std::endl;
+        logger() << "[INFO ] " << key << ": " << value << std::endl;
     }
 }
 
@@ -86,6 +272,7 @@ void checkNoRequired(Properties *properties, const char *key, std::string &value
  * @return 是否配置正确
  */
 bool checkCommonConfiguration(Properties *properties) {
+    TRACE_SCOPE("checkCommonConfiguration");
     // debug
     std::string enableDebugStr;
     checkNoRequired(properties, COMMON_DEBUG_ENABLE, enableDebugStr, "true");
@@ -94,9 +281,9 @@ bool checkCommonConfiguration(Properties *properties) {
     } else if (enableDebugStr == "false") {
         enableDebug = false;
     } else {
-        std::cout << "[ERROR] " << COMMON_DEBUG_ENABLE
-                  << " cannot be " << enableDebugStr
-                  << "." << std::endl;
+        logger() << "[ERROR] " << COMMON_DEBUG_ENABLE
+                 << " cannot be " << enableDebugStr
+                 << "." << std::endl;
         return false;
     }
 
@@ -107,7 +294,7 @@ bool checkCommonConfiguration(Properties *properties) {
     }
 
     if (!fileExist(tomcatLocation + TOMCAT_SERVER_XML)) {
-        std::cout << "[ERROR] it's not a tomcat home directory: " << tomcatLocation << std::endl;
+        logger() << "[ERROR] it's not a tomcat home directory: " << tomcatLocation << std::endl;
         return false;
     }
 
@@ -121,24 +308,24 @@ bool checkCommonConfiguration(Properties *properties) {
     std::string jreHome = convent2string(getenv("JRE_HOME"));
     if (!isBlank(jreHome)) {
         printKeyValue("JRE_HOME", jreHome);
-        std::cout << "[WARN ] Tomcat uses the JRE_HOME in preference."
-                  << "If you want to change Java version, please remove the JRE_HOME environment variable."
-                  << std::endl;
+        logger() << "[WARN ] Tomcat uses the JRE_HOME in preference."
+                 << "If you want to change Java version, please remove the JRE_HOME environment variable."
+                 << std::endl;
     }
 
     // JAVA_OPTS + common.java.options
     javaOptions = convent2string(getenv("JAVA_OPTS"));
     if (isBlank(javaOptions)) {
         if (enableDebug) {
-            std::cout << "[DEBUG] environment variable JAVA_OPTS not found." << std::endl;
+            logger() << "[DEBUG] environment variable JAVA_OPTS not found." << std::endl;
         }
         checkNoRequired(properties, COMMON_JVM_OPTIONS, javaOptions, "");
         if (isBlank(javaOptions)) {
             if (enableDebug) {
-                std::cout << "[DEBUG] " << COMMON_JVM_OPTIONS << " not found." << std::endl;
+                logger() << "[DEBUG] " << COMMON_JVM_OPTIONS << " not found." << std::endl;
             }
-            std::cout << "[Warn] JVM options is empty, you can set it by environment variable JAVA_OPTS or "
-                      << COMMON_JVM_OPTIONS << std::endl;
+            logger() << "[Warn] JVM options is empty, you can set it by environment variable JAVA_OPTS or "
+                     << COMMON_JVM_OPTIONS << std::endl;
         }
     } else {
         std::string javaOptionsConf = convent2string(properties->get(COMMON_JVM_OPTIONS));
@@ -146,276 +333,2680 @@ bool checkCommonConfiguration(Properties *properties) {
             javaOptions.append(" ").append(javaOptionsConf);
         } else {
             if (enableDebug) {
-                std::cout << "[DEBUG] " << COMMON_JVM_OPTIONS << " not found." << std::endl;
+                logger() << "[DEBUG] " << COMMON_JVM_OPTIONS << " not found." << std::endl;
             }
         }
     }
     printKeyValue("JAVA_OPTS", javaOptions);
 
+    // 启动方式: catalina 脚本或直接启动 JVM
+    checkNoRequired(properties, COMMON_LAUNCH_MODE, launchMode, "catalina");
+    if (launchMode != "catalina" && launchMode != "java") {
+        logger() << "[ERROR] " << COMMON_LAUNCH_MODE
+                 << " cannot be " << launchMode
+                 << "." << std::endl;
+        return false;
+    }
+
+    // 捕获 Tomcat 控制台输出
+    std::string consoleCaptureStr;
+    checkNoRequired(properties, COMMON_CONSOLE_CAPTURE, consoleCaptureStr, "false");
+    if (consoleCaptureStr != "true" && consoleCaptureStr != "false") {
+        logger() << "[ERROR] " << COMMON_CONSOLE_CAPTURE
+                 << " cannot be " << consoleCaptureStr
+                 << "." << std::endl;
+        return false;
+    }
+    consoleCapture = consoleCaptureStr == "true";
+    if (consoleCapture) {
+        std::string bufferStr;
+        std::string maxSizeStr;
+        std::string maxFilesStr;
+        std::string overflowStr;
+        checkNoRequired(properties, COMMON_CONSOLE_BUFFER, bufferStr, "1048576");
+        checkNoRequired(properties, COMMON_CONSOLE_MAX_SIZE, maxSizeStr, "10485760");
+        checkNoRequired(properties, COMMON_CONSOLE_MAX_FILES, maxFilesStr, "5");
+        checkNoRequired(properties, COMMON_CONSOLE_OVERFLOW, overflowStr, "block");
+        if (overflowStr != "block" && overflowStr != "drop") {
+            logger() << "[ERROR] " << COMMON_CONSOLE_OVERFLOW
+                     << " cannot be " << overflowStr
+                     << "." << std::endl;
+            return false;
+        }
+        long buffer;
+        if (!parseInteger(bufferStr, 1, buffer)) {
+            logger() << "[ERROR] " << COMMON_CONSOLE_BUFFER
+                     << " cannot be " << bufferStr
+                     << "." << std::endl;
+            return false;
+        }
+        long maxSize;
+        if (!parseInteger(maxSizeStr, 1, maxSize)) {
+            logger() << "[ERROR] " << COMMON_CONSOLE_MAX_SIZE
+                     << " cannot be " << maxSizeStr
+                     << "." << std::endl;
+            return false;
+        }
+        // 0: 到达上限时直接删除
+        long maxFiles;
+        if (!parseInteger(maxFilesStr, 0, maxFiles)) {
+            logger() << "[ERROR] " << COMMON_CONSOLE_MAX_FILES
+                     << " cannot be " << maxFilesStr
+                     << "." << std::endl;
+            return false;
+        }
+        consolePolicy.bufferSize = (size_t) buffer;
+        consolePolicy.maxFileSize = maxSize;
+        consolePolicy.maxFiles = (int) maxFiles;
+        consolePolicy.overflow = overflowStr == "drop" ? ConsoleCapture::DROP : ConsoleCapture::BLOCK;
+    }
+
+    // AppCDS
+    std::string cdsEnableStr;
+    checkNoRequired(properties, COMMON_CDS_ENABLE, cdsEnableStr, "false");
+    if (cdsEnableStr != "true" && cdsEnableStr != "false") {
+        logger() << "[ERROR] " << COMMON_CDS_ENABLE
+                 << " cannot be " << cdsEnableStr
+                 << "." << std::endl;
+        return false;
+    }
+    classDataSharing = cdsEnableStr == "true";
+
+    // server.xml 模板
+    std::string templatePath;
+    std::string templateText = SERVER_XML_TEMPLATE;
+    checkNoRequired(properties, COMMON_SERVER_XML_TEMPLATE, templatePath, "");
+    if (!isBlank(templatePath) && !readTextFile(templatePath, templateText)) {
+        return false;
+    }
+    if (!serverXmlTemplate.compile(templateText, SERVER_XML_VALUES, SERVER_XML_VALUE_NUMBER)) {
+        logger() << "[ERROR] invalid server.xml template: "
+                 << (isBlank(templatePath) ? "built-in" : templatePath) << std::endl;
+        return false;
+    }
+
+    // 蓝绿槽位
+    std::string slotsEnableStr;
+    checkNoRequired(properties, COMMON_SLOTS_ENABLE, slotsEnableStr, "false");
+    if (slotsEnableStr != "true" && slotsEnableStr != "false") {
+        logger() << "[ERROR] " << COMMON_SLOTS_ENABLE
+                 << " cannot be " << slotsEnableStr
+                 << "." << std::endl;
+        return false;
+    }
+    slotsEnabled = slotsEnableStr == "true";
+    if (slotsEnabled) {
+        std::string portOffsetStr;
+        checkNoRequired(properties, COMMON_SLOTS_PORT_OFFSET, portOffsetStr, "1000");
+        slotPortOffset = atoi(portOffsetStr.c_str());
+        if (slotPortOffset <= 0 || slotPortOffset > 65535) {
+            logger() << "[ERROR] " << COMMON_SLOTS_PORT_OFFSET
+                     << " cannot be " << portOffsetStr
+                     << "." << std::endl;
+            return false;
+        }
+    }
+
+    // NUMA 节点分配
+    checkNoRequired(properties, COMMON_NUMA_PLACEMENT, numaPlacement, "none");
+    if (numaPlacement != "none" && numaPlacement != "auto") {
+        logger() << "[ERROR] " << COMMON_NUMA_PLACEMENT
+                 << " cannot be " << numaPlacement
+                 << "." << std::endl;
+        return false;
+    }
+
+    // 按 cgroup 限制分配 JVM 资源
+    std::string sizingEnableStr;
+    checkNoRequired(properties, COMMON_SIZING_ENABLE, sizingEnableStr, "false");
+    if (sizingEnableStr != "true" && sizingEnableStr != "false") {
+        logger() << "[ERROR] " << COMMON_SIZING_ENABLE
+                 << " cannot be " << sizingEnableStr
+                 << "." << std::endl;
+        return false;
+    }
+    jvmSizing = sizingEnableStr == "true";
+    if (jvmSizing) {
+        std::string heapPercentStr;
+        checkNoRequired(properties, COMMON_SIZING_HEAP_PERCENT, heapPercentStr, "70");
+        sizingHeapPercent = atoi(heapPercentStr.c_str());
+        if (sizingHeapPercent <= 0 || sizingHeapPercent > 100) {
+            logger() << "[ERROR] " << COMMON_SIZING_HEAP_PERCENT
+                     << " cannot be " << heapPercentStr
+                     << "." << std::endl;
+            return false;
+        }
+    }
+
+    // /proc 采样
+    std::string samplerIntervalStr;
+    checkNoRequired(properties, COMMON_SAMPLER_INTERVAL, samplerIntervalStr, "0");
+    samplerInterval = atoi(samplerIntervalStr.c_str());
+    if (samplerInterval < 0) {
+        logger() << "[ERROR] " << COMMON_SAMPLER_INTERVAL
+                 << " cannot be " << samplerIntervalStr
+                 << "." << std::endl;
+        return false;
+    }
+    if (samplerInterval > 0) {
+        std::string samplerCapacityStr;
+        checkNoRequired(properties, COMMON_SAMPLER_CAPACITY, samplerCapacityStr, "3600");
+        samplerCapacity = atoi(samplerCapacityStr.c_str());
+        if (samplerCapacity <= 0) {
+            logger() << "[ERROR] " << COMMON_SAMPLER_CAPACITY
+                     << " cannot be " << samplerCapacityStr
+                     << "." << std::endl;
+            return false;
+        }
+    }
+
+    // 日志轮转和压缩
+    std::string logsIntervalStr;
+    long logsInterval;
+    checkNoRequired(properties, COMMON_LOGS_INTERVAL, logsIntervalStr, "0");
+    if (!parseInteger(logsIntervalStr, 0, logsInterval)) {
+        logger() << "[ERROR] " << COMMON_LOGS_INTERVAL
+                 << " cannot be " << logsIntervalStr
+                 << "." << std::endl;
+        return false;
+    }
+    logsPolicy.intervalSeconds = (int) logsInterval;
+    if (logsInterval > 0) {
+        std::string maxAgeStr;
+        std::string threadsStr;
+        std::string maxSizeStr;
+        std::string budgetStr;
+        long maxAge;
+        long threads;
+        checkNoRequired(properties, COMMON_LOGS_MAX_AGE, maxAgeStr, "3600");
+        checkNoRequired(properties, COMMON_LOGS_THREADS, threadsStr, "2");
+        checkNoRequired(properties, COMMON_LOGS_MAX_SIZE, maxSizeStr, "0");
+        checkNoRequired(properties, COMMON_LOGS_BUDGET, budgetStr, "0");
+        if (!parseInteger(maxAgeStr, 0, maxAge)) {
+            logger() << "[ERROR] " << COMMON_LOGS_MAX_AGE
+                     << " cannot be " << maxAgeStr
+                     << "." << std::endl;
+            return false;
+        }
+        if (!parseInteger(threadsStr, 1, threads)) {
+            logger() << "[ERROR] " << COMMON_LOGS_THREADS
+                     << " cannot be " << threadsStr
+                     << "." << std::endl;
+            return false;
+        }
+        logsPolicy.maxAgeSeconds = (int) maxAge;
+        logsPolicy.threads = (int) threads;
+        logsPolicy.maxFileSize = atoll(maxSizeStr.c_str());
+        logsPolicy.budgetBytes = atoll(budgetStr.c_str());
+        if (logsPolicy.maxFileSize < 0 || logsPolicy.budgetBytes < 0) {
+            logger() << "[ERROR] " << COMMON_LOGS_MAX_SIZE << " and " << COMMON_LOGS_BUDGET
+                     << " cannot be negative." << std::endl;
+            return false;
+        }
+    }
+
+    // /metrics
+    std::string metricsListen;
+    checkNoRequired(properties, COMMON_METRICS_LISTEN, metricsListen, "");
+    metricsAddress = "127.0.0.1";
+    metricsPort = 0;
+    if (!isBlank(metricsListen)) {
+        size_t colon = metricsListen.rfind(':');
+        if (colon != std::string::npos) {
+            metricsAddress = metricsListen.substr(0, colon);
+        }
+        if (!PortPlanner::parsePort(metricsListen.substr(colon == std::string::npos ? 0 : colon + 1), metricsPort)) {
+            logger() << "[ERROR] " << COMMON_METRICS_LISTEN
+                     << " cannot be " << metricsListen
+                     << "." << std::endl;
+            return false;
+        }
+    }
+
     return true;
 }
 
 /**
- * 检查命令行参数
+ * 检查区域配置
  *
- * @param argc 参数数量
- * @param argv 参数列表
+ * @param regionName 区域名称
+ * @param properties 配置信息
+ * @param region 区域配置
  * @return 是否符合要求
  */
-bool checkArguments(int argc, char *argv[], Properties *properties) {
-    // key prefix
-    std::string regionName = argv[1];
+bool checkArguments(const std::string &regionName, Properties *properties, Region &region) {
+    Trace::TrackScope track(regionName);
+    TRACE_SCOPE("checkArguments");
+    region.name = regionName;
     if (enableDebug) {
-        std::cout << "[DEBUG] region: " << regionName << std::endl;
+        logger() << "[DEBUG] region: " << regionName << std::endl;
     }
     // appframe.war
     std::string warKey = regionName + APPFRAME_WAR_LOCATION;
-    warFile = convent2string(properties->get(warKey.c_str()));
-    if (isBlank(warFile)) {
-        std::cout << "[ERROR] .war file path is empty, it can be set by " << warKey << std::endl;
+    region.warFile = convent2string(properties->get(warKey.c_str()));
+    if (isBlank(region.warFile)) {
+        logger() << "[ERROR] .war file path is empty, it can be set by " << warKey << std::endl;
         return false;
     }
-    if (!fileExist(warFile)) {
-        std::cout << "[ERROR] file or directory not exist["
-                  << warFile << "], please check " << warKey << std::endl;
+    if (!fileExist(region.warFile)) {
+        logger() << "[ERROR] file or directory not exist["
+                 << region.warFile << "], please check " << warKey << std::endl;
         return false;
     }
-    if (isDirectory(warFile)) {
-        std::cout << "[ERROR] it's a directory: " << warFile << std::endl;
+    if (isDirectory(region.warFile)) {
+        logger() << "[ERROR] it's a directory: " << region.warFile << std::endl;
         return false;
     }
 
-    printKeyValue("APPFRAME-WEB", warFile);
+    printKeyValue("APPFRAME-WEB", region.warFile);
 
     // BossSoft Home
     std::string bsHomeKey = regionName + APPFRAME_BSHOME_LOCATION;
-    bsHomeDirectory = convent2string(properties->get(bsHomeKey.c_str()));
-    if (isBlank(bsHomeDirectory)) {
-        std::cout << "[ERROR] BOSSSOFT_HOME not found, it can be set by " << bsHomeKey << "." << std::endl;
+    region.bsHomeDirectory = convent2string(properties->get(bsHomeKey.c_str()));
+    if (isBlank(region.bsHomeDirectory)) {
+        logger() << "[ERROR] BOSSSOFT_HOME not found, it can be set by " << bsHomeKey << "." << std::endl;
         return false;
     }
-    if (!fileExist(bsHomeDirectory)) {
-        std::cout << "[ERROR] file or directory not exist["
-                  << bsHomeDirectory << "], please check " << bsHomeKey << std::endl;
+    if (!fileExist(region.bsHomeDirectory)) {
+        logger() << "[ERROR] file or directory not exist["
+                 << region.bsHomeDirectory << "], please check " << bsHomeKey << std::endl;
         return false;
     }
-    if (!isDirectory(bsHomeDirectory)) {
-        std::cout << "[ERROR] it's not a directory: " << bsHomeDirectory << std::endl;
+    if (!isDirectory(region.bsHomeDirectory)) {
+        logger() << "[ERROR] it's not a directory: " << region.bsHomeDirectory << std::endl;
         return false;
     }
 
-    printKeyValue("BOSSSOFT_HOME", bsHomeDirectory);
+    printKeyValue("BOSSSOFT_HOME", region.bsHomeDirectory);
 
     // shutdown port
-    checkNoRequired(properties, (regionName + APPDRAME_SHUTDOWN_PORT).c_str(), tomcatShutdownPort, "8005");
+    checkNoRequired(properties, (regionName + APPDRAME_SHUTDOWN_PORT).c_str(), region.shutdownPort, "8005");
+    // 切换槽位时通过 shutdown.port 停止旧槽位
+    int shutdownPort;
+    if (slotsEnabled && region.shutdownPort != "auto" && !PortPlanner::parsePort(region.shutdownPort, shutdownPort)) {
+        logger() << "[ERROR] " << regionName << APPDRAME_SHUTDOWN_PORT << " cannot be " << region.shutdownPort
+                 << " when " << COMMON_SLOTS_ENABLE << "=true, the old slot could not be stopped." << std::endl;
+        return false;
+    }
 
     // http port
-    checkNoRequired(properties, (regionName + APPFRAME_HTTP_PORT).c_str(), tomcatHttpPort, "8080");
+    checkNoRequired(properties, (regionName + APPFRAME_HTTP_PORT).c_str(), region.httpPort, "8080");
 
     // https port
-    checkNoRequired(properties, (regionName + APPFRAME_HTTPS_PORT).c_str(), tomcatHttpsPort, "");
+    checkNoRequired(properties, (regionName + APPFRAME_HTTPS_PORT).c_str(), region.httpsPort, "");
 
     // AJP port
-    checkNoRequired(properties, (regionName + APPFRAME_AJP_PORT).c_str(), tomcatAjpPort, "");
+    checkNoRequired(properties, (regionName + APPFRAME_AJP_PORT).c_str(), region.ajpPort, "");
 
     // JMX port
-    checkNoRequired(properties, (regionName + APPFRAME_JMX_PORT).c_str(), tomcatJmxPort, "");
-    return true;
-}
+    checkNoRequired(properties, (regionName + APPFRAME_JMX_PORT).c_str(), region.jmxPort, "");
+    region.jmxAuthenticate = true;
+    if (!isBlank(region.jmxPort)) {
+        std::string authenticateStr;
+        checkNoRequired(properties, (regionName + APPFRAME_JMX_AUTHENTICATE).c_str(), authenticateStr, "true");
+        if (authenticateStr != "true" && authenticateStr != "false") {
+            logger() << "[ERROR] " << regionName << APPFRAME_JMX_AUTHENTICATE
+                     << " cannot be " << authenticateStr
+                     << "." << std::endl;
+            return false;
+        }
+        region.jmxAuthenticate = authenticateStr == "true";
+        checkNoRequired(properties, (regionName + APPFRAME_JMX_PASSWORD_FILE).c_str(), region.jmxPasswordFile, "");
+        checkNoRequired(properties, (regionName + APPFRAME_JMX_ACCESS_FILE).c_str(), region.jmxAccessFile, "");
+        if (region.jmxAuthenticate) {
+            // JMX 不认证时任何能连接端口的人都能在 JVM 中执行代码
+            if (isBlank(region.jmxPasswordFile)) {
+                logger() << "[ERROR] " << regionName << APPFRAME_JMX_PASSWORD_FILE << " is required by "
+                         << regionName << APPFRAME_JMX_PORT << ", or set " << regionName
+                         << APPFRAME_JMX_AUTHENTICATE << "=false." << std::endl;
+                return false;
+            }
+            for (auto file : {&region.jmxPasswordFile, &region.jmxAccessFile}) {
+                if (!isBlank(*file) && !fileExist(*file)) {
+                    logger() << "[ERROR] file not exist: " << *file << std::endl;
+                    return false;
+                }
+            }
+        } else {
+            logger() << "[WARN ] JMX authentication of " << regionName << " is disabled, everyone who reaches port "
+                     << region.jmxPort << " can run code in the JVM." << std::endl;
+        }
+    }
 
-bool generateVirtualTomcat(const std::string &region) {
-    targetDirectory = programDirectory + region + "_appframe";
-    printKeyValue("CATALINA_BASE", targetDirectory);
+    // https keystore
+    if (!isBlank(region.httpsPort)) {
+        checkNoRequired(properties, (regionName + APPFRAME_HTTPS_KEYSTORE).c_str(), region.httpsKeystore, "");
+        region.httpsKeystorePassword = convent2string(
+                properties->get((regionName + APPFRAME_HTTPS_KEYSTORE_PASSWORD).c_str()));
+    }
 
-    // check targetDirectory
-    if (!checkDirectory(targetDirectory)) {
+    // connector and executor
+    checkNoRequired(properties, (regionName + APPFRAME_CONNECTOR_PROTOCOL).c_str(),
+                    region.connectorProtocol, "HTTP/1.1");
+    if (findConnectorProtocol(region.connectorProtocol) == nullptr) {
+        logger() << "[ERROR] " << regionName << APPFRAME_CONNECTOR_PROTOCOL
+                 << " must be HTTP/1.1, nio, nio2 or apr: " << region.connectorProtocol << std::endl;
         return false;
     }
-
-    // check targetDirectory/conf
-#if defined(WINDOWS)
-    std::string targetConf = targetDirectory + "\\conf\\";
-#elif defined(UNIX) || defined(LINUX)
-    std::string targetConf = targetDirectory + "/conf/";
-#endif
-    if (!checkDirectory(targetConf)) {
+    long number;
+    for (auto &key : CONNECTOR_KEYS) {
+        std::string &value = region.*key.field;
+        checkNoRequired(properties, (regionName + key.suffix).c_str(), value, "");
+        if (!isBlank(value) && !parseInteger(value, key.min, number)) {
+            logger() << "[ERROR] " << regionName << key.suffix << " must be an integer not less than "
+                     << key.min << ": " << value << std::endl;
+            return false;
+        }
+    }
+    long maxThreads;
+    long minSpareThreads;
+    if (parseInteger(region.maxThreads, 1, maxThreads) &&
+        parseInteger(region.minSpareThreads, 0, minSpareThreads) && minSpareThreads > maxThreads) {
+        logger() << "[ERROR] " << regionName << APPFRAME_CONNECTOR_MIN_SPARE_THREADS << " (" << minSpareThreads
+                 << ") is greater than " << regionName << APPFRAME_CONNECTOR_MAX_THREADS
+                 << " (" << maxThreads << ")." << std::endl;
+        return false;
+    }
+    checkNoRequired(properties, (regionName + APPFRAME_CONNECTOR_COMPRESSION).c_str(), region.compression, "");
+    if (!isBlank(region.compression) && region.compression != "on" && region.compression != "off" &&
+        region.compression != "force" && !parseInteger(region.compression, 0, number)) {
+        logger() << "[ERROR] " << regionName << APPFRAME_CONNECTOR_COMPRESSION
+                 << " must be on, off, force or a size in bytes: " << region.compression << std::endl;
         return false;
     }
 
-    // check targetDirectory/logs
-#if defined(WINDOWS)
-    std::string targetLogs = targetDirectory + "\\logs\\";
-#elif defined(UNIX) || defined(LINUX)
-    std::string targetLogs = targetDirectory + "/logs/";
-#endif
-    if (!checkDirectory(targetLogs)) {
+    // profile
+    checkNoRequired(properties, (regionName + APPFRAME_PROFILE).c_str(), region.profile, PROFILE_DEV);
+    if (region.profile != PROFILE_DEV && region.profile != PROFILE_PRODUCTION) {
+        logger() << "[ERROR] " << regionName << APPFRAME_PROFILE << " must be "
+                 << PROFILE_DEV << " or " << PROFILE_PRODUCTION << ": " << region.profile << std::endl;
         return false;
     }
 
-    // check targetDirectory/work
-#if defined(WINDOWS)
-    std::string targetWork = targetDirectory + "\\work\\";
-#elif defined(UNIX) || defined(LINUX)
-    std::string targetWork = targetDirectory + "/work/";
-#endif
-    if (!checkDirectory(targetWork)) {
+    // readiness check path
+    checkNoRequired(properties, (regionName + APPFRAME_READY_PATH).c_str(), region.readyPath, "");
+
+    // CPU affinity and NUMA node
+    std::vector<int> cpus;
+    checkNoRequired(properties, (regionName + APPFRAME_CPU_SET).c_str(), region.cpuSet, "");
+    if (!isBlank(region.cpuSet) && !Placement::parseCpuList(region.cpuSet, cpus)) {
+        logger() << "[ERROR] " << regionName << APPFRAME_CPU_SET
+                 << " is not a cpu list: " << region.cpuSet << std::endl;
+        return false;
+    }
+    checkNoRequired(properties, (regionName + APPFRAME_NUMA_NODE).c_str(), region.numaNode, "");
+    if (!isBlank(region.numaNode) &&
+        (region.numaNode.find_first_not_of("0123456789") != std::string::npos)) {
+        logger() << "[ERROR] " << regionName << APPFRAME_NUMA_NODE
+                 << " is not a node: " << region.numaNode << std::endl;
         return false;
     }
+    region.placementNode = -1;
 
-    // check targetDirectory/webapps
-#if defined(WINDOWS)
-    std::string targetWebapps = targetDirectory + "\\webapps\\";
-#elif defined(UNIX) || defined(LINUX)
-    std::string targetWebapps = targetDirectory + "/webapps/";
-#endif
-    if (!checkDirectory(targetWebapps)) {
+    // sizing weight
+    region.sizingWeight = 1;
+    if (jvmSizing) {
+        std::string weightStr;
+        checkNoRequired(properties, (regionName + APPFRAME_SIZING_WEIGHT).c_str(), weightStr, "1");
+        region.sizingWeight = atof(weightStr.c_str());
+        if (region.sizingWeight <= 0) {
+            logger() << "[ERROR] " << regionName << APPFRAME_SIZING_WEIGHT
+                     << " cannot be " << weightStr << "." << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+static void collectRegionName(const char *key, const char *, void *context) {
+    auto *names = (std::vector<std::string> *) context;
+    size_t keyLength = strlen(key);
+    size_t suffixLength = strlen(APPFRAME_WAR_LOCATION);
+    if (keyLength > suffixLength && 0 == strcmp(key + keyLength - suffixLength, APPFRAME_WAR_LOCATION)) {
+        names->emplace_back(key, keyLength - suffixLength);
+    }
+}
+
+/**
+ * 找出配置文件中的所有区域 (配置了 [region].war.location 的区域)
+ *
+ * @param properties 配置信息
+ * @param regionNames 区域名称
+ */
+void findRegions(Properties *properties, std::vector<std::string> &regionNames) {
+    std::vector<std::string> found;
+    properties->forEach(collectRegionName, &found);
+    std::sort(found.begin(), found.end());
+    for (auto &name : found) {
+        if (std::find(regionNames.begin(), regionNames.end(), name) == regionNames.end()) {
+            regionNames.push_back(name);
+        }
+    }
+}
+
+/**
+ * 检查所有区域的端口是否重复配置, 要启动的区域的端口是否已被占用, 并为 auto 分配端口
+ *
+ * @param regions 要启动的区域
+ * @param properties 配置信息
+ * @param probe 是否检查端口能否绑定
+ * @return 是否成功
+ */
+bool planPorts(std::vector<Region> &regions, Properties *properties, bool probe) {
+    TRACE_SCOPE("planPorts");
+    auto begin = std::chrono::steady_clock::now();
+
+    // auto 端口的范围
+    int first = 0;
+    int last = -1;
+    std::string range = convent2string(properties->get(COMMON_PORT_RANGE));
+    if (isBlank(range)) {
+        range = "20000-29999";
+    }
+    size_t dash = range.find('-');
+    if (dash == std::string::npos ||
+        !PortPlanner::parsePort(range.substr(0, dash), first) ||
+        !PortPlanner::parsePort(range.substr(dash + 1), last) || last < first) {
+        logger() << "[ERROR] " << COMMON_PORT_RANGE << " cannot be " << range << "." << std::endl;
         return false;
     }
 
-    // 确认/conf下的配置文件
-#if defined(WINDOWS)
-    std::string tomcatConf = tomcatLocation + "\\conf\\";
-#elif defined(UNIX) || defined(LINUX)
-    std::string tomcatConf = tomcatLocation + "/webapps/";
-#endif
-    for (auto &confFileName : CONF_COPY_FILE) {
-        std::string sourceConfFile = tomcatConf + confFileName;
-        std::string targetConfFile = targetConf + confFileName;
+    std::string portsPath = programDirectory + PORTS_FILE;
+    Properties allocations;
+    bool allocationsLoaded = fileExist(portsPath) && allocations.load(portsPath.c_str());
+    bool allocationsChanged = false;
 
-        if (enableDebug) {
-            std::cout << "[DEBUG] check file: " << targetConfFile << std::endl;
+    // 配置文件中所有区域的固定端口, 端口 <= 0 表示不使用
+    PortPlanner planner(first, last);
+    std::vector<std::string> allRegions;
+    findRegions(properties, allRegions);
+    for (auto &region : regions) {
+        if (std::find(allRegions.begin(), allRegions.end(), region.name) == allRegions.end()) {
+            allRegions.push_back(region.name);
         }
-        // 文件不存在或文件不一致
-        if (!fileExist(targetConfFile)) {
-            if (enableDebug) {
-                std::cout << "[DEBUG] file not exist: " << targetConfFile << std::endl;
+    }
+
+    bool success = true;
+    std::vector<std::string> autoKeys;
+    for (auto &regionName : allRegions) {
+        Region configured;
+        for (auto &region : regions) {
+            if (region.name == regionName) {
+                configured = region;
             }
-            // 复制文件
-            if (!copyFile(sourceConfFile, targetConfFile)) {
-                std::cout << "[ERROR] copy file failed: " << confFileName;
-                return false;
+        }
+        for (auto &portKey : REGION_PORTS) {
+            std::string key = regionName + portKey.suffix;
+            std::string value = configured.name.empty() ? convent2string(properties->get(key.c_str()))
+                                                        : configured.*(portKey.field);
+            if (configured.name.empty() && isBlank(value)) {
+                value = portKey.field == &Region::shutdownPort ? "8005" :
+                        portKey.field == &Region::httpPort ? "8080" : "";
             }
-        } else if (!sameFile(sourceConfFile, targetConfFile)) {
-            if (enableDebug) {
-                std::cout << "[DEBUG] file was changed: " << sourceConfFile << std::endl;
+            if (value == "auto") {
+                autoKeys.push_back(key);
+                continue;
             }
-            // 复制文件
-            if (!copyFile(sourceConfFile, targetConfFile)) {
-                std::cout << "[ERROR] copy file failed: " << confFileName;
-                return false;
+
+            int port;
+            if (!PortPlanner::parsePort(value, port)) {
+                if (!isBlank(value) && atoi(value.c_str()) > 0) {
+                    logger() << "[ERROR] " << key << " is not a port: " << value << std::endl;
+                    success = false;
+                }
+                continue;
+            }
+            if (!planner.reserve(port, key)) {
+                logger() << "[ERROR] port " << port << " of " << key << " is already used by "
+                         << *planner.owner(port) << std::endl;
+                success = false;
             }
         }
     }
+    if (!success) {
+        return false;
+    }
 
-    // 检查war包
-    char aMd5[MD5_STRING_SIZE + 1];
-    char bMd5[MD5_STRING_SIZE + 1];
-    std::string targetWarPath = targetWebapps + "appframe.war";
-    // war包不存在
-    if (!fileExist(targetWarPath)) {
-        if (enableDebug) {
-            std::cout << "[DEBUG] appframe package not exist: " << targetWebapps << std::endl;
-        }
-        if (!copyFile(warFile, targetWebapps + "appframe.war")) {
-            std::cout << "[ERROR] copy appframe package failed: " << warFile;
-            return false;
+    // 之前分配的端口, 与固定端口冲突时重新分配
+    for (auto &key : autoKeys) {
+        int port;
+        if (PortPlanner::parsePort(convent2string(allocations.get(key.c_str())), port) &&
+            !planner.reserve(port, key)) {
+            allocations.remove(key.c_str());
+            allocationsChanged = true;
         }
     }
-        // war包存在但不相同
-    else if (!sameFile(warFile, targetWarPath, aMd5, bMd5)) {
-        std::cout << "[INFO ] appframe package was changed: " << warFile << std::endl;
-        printKeyValue("\tSource War MD5", aMd5);
-        printKeyValue("\tTarget War MD5", bMd5);
-        if (!copyFile(warFile, targetWebapps + "appframe.war")) {
-            std::cout << "[ERROR] copy appframe package failed: " << warFile;
-            return false;
+
+    // 要启动的区域
+    int checked = 0;
+    for (auto &region : regions) {
+        // 绿色槽位使用偏移后的端口, 原端口可能正被蓝色槽位使用, 不检查能否绑定
+        int offset = region.slot == SLOT_GREEN ? slotPortOffset : 0;
+        for (auto &portKey : REGION_PORTS) {
+            std::string &value = region.*(portKey.field);
+            std::string key = region.name + portKey.suffix;
+            int port;
+            // 分配端口时已检查能否绑定
+            bool probed = false;
+            if (value == "auto") {
+                const std::string *owner;
+                bool keep = PortPlanner::parsePort(convent2string(allocations.get(key.c_str())), port) &&
+                            (owner = planner.owner(port)) != nullptr && *owner == key &&
+                            (!probe || offset != 0 || PortPlanner::bindable(port));
+                if (!keep) {
+                    port = planner.allocate(key, probe);
+                    if (port == -1) {
+                        logger() << "[ERROR] no free port left in " << range << " for " << key << std::endl;
+                        success = false;
+                        continue;
+                    }
+                    allocations.set(key.c_str(), std::to_string(port).c_str());
+                    allocationsChanged = true;
+                }
+                value = std::to_string(port);
+                printKeyValue(key.c_str(), value);
+                probed = offset == 0;
+            } else if (!PortPlanner::parsePort(value, port)) {
+                continue;
+            }
+            checked++;
+
+            if (offset != 0) {
+                std::string slotKey = key + "@" + region.slot;
+                port += offset;
+                if (port > 65535) {
+                    logger() << "[ERROR] port " << port << " of " << slotKey << " is out of range." << std::endl;
+                    success = false;
+                    continue;
+                }
+                if (!planner.reserve(port, slotKey)) {
+                    logger() << "[ERROR] port " << port << " of " << slotKey << " is already used by "
+                             << *planner.owner(port) << std::endl;
+                    success = false;
+                    continue;
+                }
+                value = std::to_string(port);
+                printKeyValue(slotKey.c_str(), value);
+                key = slotKey;
+            }
+            if (probe && !probed && !PortPlanner::bindable(port)) {
+                logger() << "[ERROR] port " << port << " of " << key << " is already in use." << std::endl;
+                success = false;
+            }
         }
     }
 
-    // create server.xml
-    std::string targetServerXmlPath = targetDirectory + TOMCAT_SERVER_XML;
-    if (enableDebug) {
-        std::cout << "[DEBUG] create server.xml: " << targetServerXmlPath << std::endl;
-    }
-    std::string serverXml = generateServerXml(targetWebapps, tomcatShutdownPort, tomcatHttpPort);
-    FILE *serverXmlFile = fopen(targetServerXmlPath.c_str(), "wb");
-    if (serverXmlFile == nullptr) {
-        std::cout << "[ERROR] create server.xml failed." << std::endl;
+    if (allocationsChanged && planOnly) {
+        logger() << "[PLAN ] write " << portsPath << std::endl;
+    } else if (allocationsChanged && !allocations.save(portsPath.c_str(), allocationsLoaded)) {
+        logger() << "[WARN ] save allocated ports failed: " << portsPath << std::endl;
     }
-    fwrite(serverXml.c_str(), 1, serverXml.length(), serverXmlFile);
-    fclose(serverXmlFile);
-    return true;
+
+    auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - begin).count();
+    logger() << "[INFO ] checked " << checked << " port(s) of " << allRegions.size() << " region(s) in "
+             << elapsed << "us" << std::endl;
+    return success;
 }
 
-int main(int argc, char *argv[]) {
-    if (argc == 1) {
-        std::cout << "[ERROR] please enter the region of appframe." << std::endl;
-        return 1;
+/**
+ * 按 cgroup 限制和区域权重生成每个区域的 JVM 资源参数, 用户的 java options 优先
+ *
+ * @param regions 启动的区域
+ */
+void sizeRegions(std::vector<Region> &regions) {
+    if (!jvmSizing) {
+        return;
     }
-
-    if (argc > 2) {
-        std::cout << "[ERROR] too much arguments." << std::endl;
-        return 1;
+    TRACE_SCOPE("sizeRegions");
+    JvmSizing::Resources resources{};
+    if (!JvmSizing::detect(resources)) {
+        logger() << "[WARN ] detect cpu and memory failed, JVM options are not generated." << std::endl;
+        return;
     }
+    logger() << "[INFO ] SIZING: cpus " << resources.cpus << (resources.cpuLimited ? " (cgroup)" : "")
+             << ", memory " << resources.memoryBytes / (1024 * 1024) << "m"
+             << (resources.memoryLimited ? " (cgroup)" : "") << std::endl;
 
-    char *cwdDir = new char[MAX_PATH_LENGTH];
+    std::vector<double> weights;
+    for (auto &region : regions) {
+        weights.push_back(region.sizingWeight);
+    }
+    std::vector<JvmSizing::Share> shares = JvmSizing::divide(resources, weights, sizingHeapPercent);
 
-#if defined(WINDOWS)
-    GetModuleFileNameA(nullptr, cwdDir, MAX_PATH_LENGTH);
+    std::vector<std::string> userOptions;
+    splitArguments(javaOptions, userOptions);
+    for (size_t i = 0; i < regions.size(); i++) {
+        std::vector<std::string> generated;
+        JvmSizing::options(shares[i], generated);
+        regions[i].sizingOptions.clear();
+        JvmSizing::merge(generated, userOptions, regions[i].sizingOptions);
 
-    // remove *.exe
-    size_t len = strlen(cwdDir);
-    for (size_t i = len - 1; i > 0; i--) {
-        if (cwdDir[i] == '\\') {
-            cwdDir[i] = '\0';
-            break;
+        std::string joined;
+        for (auto &option : regions[i].sizingOptions) {
+            joined.append(" ").append(option);
         }
+        logger() << "[INFO ] SIZING(" << regions[i].name << "): cpus " << shares[i].cpus
+                 << ", memory " << shares[i].memoryBytes / (1024 * 1024) << "m ->" << joined << std::endl;
     }
-#elif defined(UNIX) || defined(LINUX)
-    getcwd(cwdDir, MAX_PATH_LENGTH);
-#endif
-
-    programDirectory = std::string(cwdDir);
-
-    // 释放使用完的路径缓存
-    delete[] cwdDir;
-
-    printKeyValue("PROGRAM_HOME", programDirectory);
+}
 
+/**
+ * 确定每个区域的 CPU 和 NUMA 节点, auto 模式下未配置的区域依次分配到各个节点
+ *
+ * @param regions 启动的区域
+ * @return 配置是否正确
+ */
+bool placeRegions(std::vector<Region> &regions) {
+    bool configured = numaPlacement == "auto";
+    for (auto &region : regions) {
+        configured = configured || !isBlank(region.cpuSet) || !isBlank(region.numaNode);
+    }
+    if (!configured) {
+        return true;
+    }
 #if defined(WINDOWS)
-    programDirectory.append("\\");
+    logger() << "[WARN ] cpu and NUMA placement is only supported on Linux." << std::endl;
+    return true;
 #elif defined(UNIX) || defined(LINUX)
-    programDirectory.append("/");
-#endif
+    TRACE_SCOPE("placeRegions");
+    std::vector<Placement::Node> nodes = Placement::nodes();
+    std::vector<int> allowed = Placement::allowedCpus();
+    logger() << "[INFO ] PLACEMENT: " << nodes.size() << " NUMA node(s), cpus "
+             << Placement::formatCpuList(allowed) << std::endl;
 
-    std::string configFilePath = programDirectory + CONFIG_FILE;
-    printKeyValue("CONFIG_FILE", configFilePath);
-    auto *properties = new Properties(configFilePath.c_str());
+    bool success = true;
+    size_t nextNode = 0;
+    for (auto &region : regions) {
+        region.placementCpus.clear();
+        region.placementNode = -1;
+        if (!isBlank(region.numaNode)) {
+            int id = atoi(region.numaNode.c_str());
+            for (auto &node : nodes) {
+                if (node.id == id) {
+                    region.placementNode = id;
+                    region.placementCpus = node.cpus;
+                }
+            }
+            if (region.placementNode == -1) {
+                logger() << "[ERROR] " << region.name << APPFRAME_NUMA_NODE << ": node " << id
+                         << " has no usable cpu." << std::endl;
+                success = false;
+                continue;
+            }
+        }
+        if (!isBlank(region.cpuSet)) {
+            Placement::parseCpuList(region.cpuSet, region.placementCpus);
+            for (int cpu : region.placementCpus) {
+                if (!std::binary_search(allowed.begin(), allowed.end(), cpu)) {
+                    logger() << "[ERROR] " << region.name << APPFRAME_CPU_SET << ": cpu " << cpu
+                             << " is not available." << std::endl;
+                    success = false;
+                    break;
+                }
+            }
+        } else if (isBlank(region.numaNode) && numaPlacement == "auto") {
+            // 只有一个节点时不绑定, 由内核调度
+            if (nodes.size() < 2) {
+                continue;
+            }
+            Placement::Node &node = nodes[nextNode++ % nodes.size()];
+            region.placementNode = node.id;
+            region.placementCpus = node.cpus;
+        }
 
-    if (!properties->isInitSuccess()) {
-        return 1;
+        if (!region.placementCpus.empty() || region.placementNode != -1) {
+            logger() << "[INFO ] PLACEMENT(" << region.name << "): node "
+                     << (region.placementNode == -1 ? std::string("-") : std::to_string(region.placementNode))
+                     << ", cpus " << Placement::formatCpuList(region.placementCpus) << std::endl;
+        }
     }
+    return success;
+#endif
+}
 
-    if (!checkCommonConfiguration(properties)) {
-        return 2;
+/**
+ * 读取区域当前使用的槽位
+ *
+ * @param regionName 区域名称
+ * @return blue | green, 没有记录时为空
+ */
+std::string readActiveSlot(const std::string &regionName) {
+    std::string slotPath = programDirectory + regionName + SLOT_FILE_SUFFIX;
+    FILE *slotFile = fopen(slotPath.c_str(), "rb");
+    if (slotFile == nullptr) {
+        return "";
     }
+    char buffer[16] = {0};
+    fread(buffer, 1, sizeof(buffer) - 1, slotFile);
+    fclose(slotFile);
+    std::string slot(buffer);
+    slot.erase(slot.find_last_not_of(" \r\n") + 1);
+    return slot == SLOT_BLUE || slot == SLOT_GREEN ? slot : "";
+}
+
+/**
+ * 记录区域当前使用的槽位, 先写临时文件再改名, 不会读到写了一半的文件
+ *
+ * @param region 区域配置
+ * @return 是否成功
+ */
+bool writeActiveSlot(const Region &region) {
+    std::string slotPath = programDirectory + region.name + SLOT_FILE_SUFFIX;
+    std::string tempPath = slotPath + ".tmp";
+    FILE *slotFile = fopen(tempPath.c_str(), "wb");
+    if (slotFile == nullptr) {
+        logger() << "[ERROR] create " << tempPath << " failed." << std::endl;
+        return false;
+    }
+    std::string content = region.slot + "\n";
+    fwrite(content.c_str(), 1, content.length(), slotFile);
+    fclose(slotFile);
+#if defined(WINDOWS)
+    bool renamed = TRUE == MoveFileExA(tempPath.c_str(), slotPath.c_str(), MOVEFILE_REPLACE_EXISTING);
+#elif defined(UNIX) || defined(LINUX)
+    bool renamed = 0 == rename(tempPath.c_str(), slotPath.c_str());
+#endif
+    if (!renamed) {
+        logger() << "[ERROR] write " << slotPath << " failed." << std::endl;
+    }
+    return renamed;
+}
+
+/**
+ * 选择区域使用的槽位, --redeploy 时使用空闲的槽位
+ *
+ * @param regions 启动的区域
+ * @param redeploy 是否重新部署
+ */
+void selectSlots(std::vector<Region> &regions, bool redeploy) {
+    if (!slotsEnabled) {
+        return;
+    }
+    for (auto &region : regions) {
+        std::string active = readActiveSlot(region.name);
+        if (redeploy) {
+            region.previousSlot = active;
+            region.slot = active == SLOT_BLUE ? SLOT_GREEN : SLOT_BLUE;
+        } else {
+            region.slot = active.empty() ? SLOT_BLUE : active;
+        }
+        logger() << "[INFO ] SLOT(" << region.name << "): " << region.slot
+                 << (active.empty() ? ", no active slot" : ", active: " + active) << std::endl;
+    }
+}
+
+/**
+ * 新的槽位就绪后停止区域旧槽位的 Tomcat 并切换当前槽位
+ *
+ * @param region 启动的区域
+ * @return 是否切换成功
+ */
+bool activateSlot(const Region &region) {
+    if (!slotsEnabled) {
+        return true;
+    }
+    if (!region.previousSlot.empty() && region.previousSlot != region.slot) {
+        // 旧槽位的端口与当前槽位相差 slotPortOffset
+        int shutdownPort = atoi(region.shutdownPort.c_str());
+        shutdownPort += region.previousSlot == SLOT_GREEN ? slotPortOffset : -slotPortOffset;
+        if (planOnly) {
+            logger() << "[PLAN ] stop " << region.name << " " << region.previousSlot
+                     << " through port " << shutdownPort << std::endl;
+        } else if (Supervisor::sendShutdown(shutdownPort)) {
+            logger() << "[INFO ] SLOT(" << region.name << "): " << region.previousSlot
+                     << " stopped through port " << shutdownPort << std::endl;
+        } else {
+            logger() << "[INFO ] SLOT(" << region.name << "): " << region.previousSlot
+                     << " was not running (port " << shutdownPort << ")" << std::endl;
+        }
+    }
+    if (readActiveSlot(region.name) != region.slot) {
+        if (planOnly) {
+            logger() << "[PLAN ] activate " << region.name << " " << region.slot << std::endl;
+            return true;
+        }
+        if (!writeActiveSlot(region)) {
+            return false;
+        }
+        logger() << "[INFO ] SLOT(" << region.name << "): " << region.slot << " is active" << std::endl;
+    }
+    return true;
+}
+
+/**
+ * 切换所有区域的槽位
+ *
+ * @param regions 启动的区域
+ * @return 是否全部切换成功
+ */
+bool activateSlots(const std::vector<Region> &regions) {
+    bool success = true;
+    for (auto &region : regions) {
+        if (!activateSlot(region)) {
+            success = false;
+        }
+    }
+    return success;
+}
+
+/**
+ * 区域的 server.xml 内容
+ *
+ * @param region 区域配置
+ * @return server.xml
+ */
+std::string serverXmlContent(const Region &region) {
+#if defined(WINDOWS)
+    std::string targetWebapps = region.targetDirectory + "\\webapps\\";
+#elif defined(UNIX) || defined(LINUX)
+    std::string targetWebapps = region.targetDirectory + "/webapps/";
+#endif
+    std::string values[SERVER_XML_VALUE_NUMBER];
+    // shutdown.port 为 -1 时不监听, 原样写入
+    values[XML_SHUTDOWN_PORT] = xmlEscape(region.shutdownPort);
+    values[XML_HTTP_PORT] = xmlEscape(region.httpPort);
+    // 未使用的端口为空, 模板中对应的连接器不生成
+    int port;
+    if (PortPlanner::parsePort(region.httpsPort, port)) {
+        values[XML_HTTPS_PORT] = region.httpsPort;
+    }
+    if (PortPlanner::parsePort(region.ajpPort, port)) {
+        values[XML_AJP_PORT] = region.ajpPort;
+    }
+    if (PortPlanner::parsePort(region.jmxPort, port)) {
+        values[XML_JMX_PORT] = region.jmxPort;
+    }
+    values[XML_HTTPS_KEYSTORE] = xmlEscape(region.httpsKeystore);
+    values[XML_HTTPS_KEYSTORE_PASSWORD] = xmlEscape(region.httpsKeystorePassword);
+    values[XML_APP_BASE] = xmlEscape(targetWebapps);
+    values[XML_WAR_PATH] = xmlEscape(targetWebapps + "appframe.war");
+
+    // 已在 checkArguments 中校验, 不需要转义
+    const ConnectorProtocol *protocol = findConnectorProtocol(region.connectorProtocol);
+    values[XML_PROTOCOL] = protocol->http;
+    values[XML_HTTPS_PROTOCOL] = protocol->https;
+    // 设置了线程数时所有连接器共享一个线程池
+    if (!isBlank(region.maxThreads) || !isBlank(region.minSpareThreads)) {
+        values[XML_EXECUTOR] = "tomcatThreadPool";
+    }
+    values[XML_MAX_THREADS] = region.maxThreads;
+    values[XML_MIN_SPARE_THREADS] = region.minSpareThreads;
+    values[XML_ACCEPT_COUNT] = region.acceptCount;
+    values[XML_MAX_CONNECTIONS] = region.maxConnections;
+    values[XML_KEEP_ALIVE_TIMEOUT] = region.keepAliveTimeout;
+    values[XML_MAX_KEEP_ALIVE_REQUESTS] = region.maxKeepAliveRequests;
+    values[XML_COMPRESSION] = region.compression;
+    // production: 不扫描 webapps 和 class 变化, 静态资源缓存更久
+    if (region.profile == PROFILE_PRODUCTION) {
+        values[XML_PRODUCTION] = "true";
+    }
+    return generateServerXml(serverXmlTemplate, values);
+}
+
+/**
+ * 生成 CATALINA_BASE/conf/server.xml
+ *
+ * @param region 区域配置
+ * @return 是否成功
+ */
+bool writeServerXml(const Region &region) {
+    TRACE_SCOPE("write server.xml");
+    std::string targetServerXmlPath = region.targetDirectory + TOMCAT_SERVER_XML;
+    std::string serverXml = serverXmlContent(region);
+    // 内容相同时不重写, 保留文件的修改时间
+    std::string current;
+    if (fileExist(targetServerXmlPath) && readTextFile(targetServerXmlPath, current) && current == serverXml) {
+        if (enableDebug) {
+            logger() << "[DEBUG] server.xml unchanged: " << targetServerXmlPath << std::endl;
+        }
+        return true;
+    }
+    if (planOnly) {
+        logger() << "[PLAN ] write " << targetServerXmlPath << std::endl;
+        return true;
+    }
+    if (enableDebug) {
+        logger() << "[DEBUG] create server.xml: " << targetServerXmlPath << std::endl;
+    }
+    FILE *serverXmlFile = fopen(targetServerXmlPath.c_str(), "wb");
+    if (serverXmlFile == nullptr) {
+        logger() << "[ERROR] create server.xml failed." << std::endl;
+        return false;
+    }
+    fwrite(serverXml.c_str(), 1, serverXml.length(), serverXmlFile);
+    fclose(serverXmlFile);
+    return true;
+}
+
+/**
+ * 准备区域的 AppCDS 归档
+ *
+ * 第一次启动使用 -XX:ArchiveClassesAtExit, JVM 正常退出时生成归档, 之后使用 -XX:SharedArchiveFile.
+ * war 包, javaHome 或 Tomcat 的 jar 包变化后删除归档重新生成.
+ *
+ * @param region 区域配置
+ * @return 是否成功
+ */
+bool prepareClassDataSharing(Region &region) {
+    region.cdsOption.clear();
+    if (!classDataSharing) {
+        return true;
+    }
+    TRACE_SCOPE("prepare cds");
+    Metrics::Timer cdsTimer(preparePhaseMetric(PREPARE_CDS));
+    // java options 中已有 CDS 参数时以用户配置为准
+    if (javaOptions.find("-XX:SharedArchiveFile") != std::string::npos ||
+        javaOptions.find("-XX:ArchiveClassesAtExit") != std::string::npos ||
+        javaOptions.find("-Xshare:") != std::string::npos) {
+        logger() << "[INFO ] AppCDS: configured by " << COMMON_JVM_OPTIONS << std::endl;
+        return true;
+    }
+
+#if defined(WINDOWS)
+    std::string separator = "\\";
+#elif defined(UNIX) || defined(LINUX)
+    std::string separator = "/";
+#endif
+    char warMd5[MD5_STRING_SIZE + 1];
+    char binMd5[MD5_STRING_SIZE + 1];
+    char libMd5[MD5_STRING_SIZE + 1];
+    if (!cachedFileMd5(region.warFile, warMd5) ||
+        !directoryStamp(tomcatLocation + separator + "bin" + separator, ".jar", binMd5) ||
+        !directoryStamp(tomcatLocation + separator + "lib" + separator, ".jar", libMd5)) {
+        return false;
+    }
+    // 同一 javaHome 下升级 JDK 时 lib/modules 会变化
+    std::string modulesStamp;
+    fileStamp(javaHome + separator + "lib" + separator + "modules", modulesStamp);
+
+    Properties expected;
+    expected.set("war.md5", warMd5);
+    expected.set("java.home", javaHome.c_str());
+    expected.set("java.modules", modulesStamp.c_str());
+    expected.set("tomcat.bin", binMd5);
+    expected.set("tomcat.lib", libMd5);
+
+    std::string archivePath = region.targetDirectory + APPCDS_ARCHIVE;
+    std::string stampPath = region.targetDirectory + APPCDS_STAMP;
+    Properties recorded;
+    bool valid = fileExist(archivePath) && fileExist(stampPath) && recorded.load(stampPath.c_str());
+    const char *keys[] = {"war.md5", "java.home", "java.modules", "tomcat.bin", "tomcat.lib"};
+    for (auto key : keys) {
+        if (!valid) {
+            break;
+        }
+        const char *value = recorded.get(key);
+        if (value == nullptr || 0 != strcmp(value, expected.get(key))) {
+            logger() << "[INFO ] AppCDS: " << key << " changed, archive is regenerated." << std::endl;
+            valid = false;
+        }
+    }
+
+    if (valid) {
+        logger() << "[INFO ] AppCDS: use " << archivePath << std::endl;
+        region.cdsOption = "-XX:SharedArchiveFile=" + archivePath;
+        return true;
+    }
+
+    // 归档在 JVM 退出时才生成, 被强制结束时下次启动再生成
+    region.cdsOption = "-XX:ArchiveClassesAtExit=" + archivePath;
+    if (planOnly) {
+        logger() << "[PLAN ] remove " << archivePath << ", write " << stampPath << std::endl;
+        return true;
+    }
+    remove(archivePath.c_str());
+    if (!expected.save(stampPath.c_str())) {
+        logger() << "[ERROR] AppCDS: write " << stampPath << " failed." << std::endl;
+        return false;
+    }
+    logger() << "[INFO ] AppCDS: " << archivePath << " is created when the region stops." << std::endl;
+    return true;
+}
+
+/**
+ * manifest 中记录的源文件和目标文件, 第一个是 Tomcat conf 或 war 包, 第二个是 CATALINA_BASE 中的副本
+ *
+ * @param region 区域配置
+ * @param files 文件名, 源文件, 目标文件
+ */
+void manifestFiles(const Region &region, std::vector<std::vector<std::string>> &files) {
+#if defined(WINDOWS)
+    std::string tomcatConf = tomcatLocation + "\\conf\\";
+    std::string targetConf = region.targetDirectory + "\\conf\\";
+    std::string targetWar = region.targetDirectory + "\\webapps\\appframe.war";
+#elif defined(UNIX) || defined(LINUX)
+    std::string tomcatConf = tomcatLocation + "/conf/";
+    std::string targetConf = region.targetDirectory + "/conf/";
+    std::string targetWar = region.targetDirectory + "/webapps/appframe.war";
+#endif
+    for (auto &confFileName : CONF_COPY_FILE) {
+        files.push_back({confFileName, tomcatConf + confFileName, targetConf + confFileName});
+    }
+    files.push_back({"appframe.war", region.warFile, targetWar});
+}
+
+/**
+ * CATALINA_BASE 是否与 manifest 记录的一致: 配置相同, 源文件和目标文件的大小和修改时间都没有变化,
+ * server.xml 的内容相同. 只读取 manifest 和 stat 文件, 不计算文件摘要
+ *
+ * @param region 区域配置
+ * @param serverXmlMd5 要生成的 server.xml 的MD5
+ * @param reason 不一致的原因
+ * @return 是否一致
+ */
+bool manifestMatches(const Region &region, const char *serverXmlMd5, std::string &reason) {
+    TRACE_SCOPE("check manifest");
+    std::string manifestPath = region.targetDirectory + APPFRAME_MANIFEST;
+    Properties manifest;
+    if (!fileExist(manifestPath) || !manifest.load(manifestPath.c_str())) {
+        reason = "no manifest";
+        return false;
+    }
+    if (convent2string(manifest.get("config.tomcat.location")) != tomcatLocation ||
+        convent2string(manifest.get("config.war.location")) != region.warFile) {
+        reason = "configuration changed";
+        return false;
+    }
+
+    std::vector<std::vector<std::string>> files;
+    manifestFiles(region, files);
+    std::string stamp;
+    for (auto &file : files) {
+        fileStamp(file[1], stamp);
+        if (stamp.empty() || stamp != convent2string(manifest.get(("source." + file[0]).c_str()))) {
+            reason = file[1] + " changed";
+            return false;
+        }
+        fileStamp(file[2], stamp);
+        if (stamp.empty() || stamp != convent2string(manifest.get(("target." + file[0]).c_str()))) {
+            reason = file[2] + " changed";
+            return false;
+        }
+    }
+
+    std::string serverXmlPath = region.targetDirectory + TOMCAT_SERVER_XML;
+    fileStamp(serverXmlPath, stamp);
+    if (stamp.empty() || stamp != convent2string(manifest.get("target.server.xml")) ||
+        0 != strcmp(serverXmlMd5, convent2string(manifest.get("target.server.xml.md5")).c_str())) {
+        reason = "server.xml changed";
+        return false;
+    }
+#if defined(WINDOWS)
+    const char *directories[] = {"\\logs", "\\work", "\\temp"};
+#elif defined(UNIX) || defined(LINUX)
+    const char *directories[] = {"/logs", "/work", "/temp"};
+#endif
+    for (auto directory : directories) {
+        if (!isDirectory(region.targetDirectory + directory)) {
+            reason = region.targetDirectory + directory + " is missing";
+            return false;
+        }
+    }
+
+    // 源文件没有变化, 摘要沿用 manifest 中的记录
+    for (auto &file : files) {
+        std::string recorded = convent2string(manifest.get(("source." + file[0]).c_str()));
+        std::string recordedMd5 = convent2string(manifest.get(("source." + file[0] + ".md5").c_str()));
+        rememberFileMd5(file[1], recorded, recordedMd5.c_str());
+    }
+    return true;
+}
+
+/**
+ * 记录 CATALINA_BASE 的 manifest: 配置, 源文件的大小, 修改时间和MD5, 目标文件的大小和修改时间
+ * (内容与源文件相同), server.xml 的大小, 修改时间和MD5
+ *
+ * @param region 区域配置
+ * @param serverXmlMd5 server.xml 的MD5
+ * @return 是否成功
+ */
+bool writeManifest(const Region &region, const char *serverXmlMd5) {
+    std::string manifestPath = region.targetDirectory + APPFRAME_MANIFEST;
+    if (planOnly) {
+        logger() << "[PLAN ] write " << manifestPath << std::endl;
+        return true;
+    }
+    TRACE_SCOPE("write manifest");
+    Properties manifest;
+    manifest.set("config.tomcat.location", tomcatLocation.c_str());
+    manifest.set("config.war.location", region.warFile.c_str());
+
+    std::vector<std::vector<std::string>> files;
+    manifestFiles(region, files);
+    std::string stamp;
+    char md5Str[MD5_STRING_SIZE + 1];
+    for (auto &file : files) {
+        if (!cachedFileMd5(file[1], md5Str)) {
+            return false;
+        }
+        fileStamp(file[1], stamp);
+        manifest.set(("source." + file[0]).c_str(), stamp.c_str());
+        manifest.set(("source." + file[0] + ".md5").c_str(), md5Str);
+        fileStamp(file[2], stamp);
+        manifest.set(("target." + file[0]).c_str(), stamp.c_str());
+    }
+    fileStamp(region.targetDirectory + TOMCAT_SERVER_XML, stamp);
+    manifest.set("target.server.xml", stamp.c_str());
+    manifest.set("target.server.xml.md5", serverXmlMd5);
+
+    if (!manifest.save(manifestPath.c_str())) {
+        logger() << "[WARN ] write manifest failed: " << manifestPath << std::endl;
+    }
+    return true;
+}
+
+/**
+ * 生成区域的 CATALINA_BASE
+ *
+ * @param region 区域配置
+ * @return 是否成功
+ */
+bool generateVirtualTomcat(Region &region) {
+    Trace::TrackScope track(region.name);
+    TRACE_SCOPE("generateVirtualTomcat");
+    RegionMetricsScope metricsScope(region.metrics);
+    if (region.metrics != nullptr) {
+        // 快速路径不经过的阶段记为 0
+        for (auto value : region.metrics->prepareSeconds) {
+            Metrics::set(value, 0);
+        }
+    }
+    Metrics::Timer totalTimer(preparePhaseMetric(PREPARE_TOTAL));
+    region.targetDirectory = programDirectory + region.name + "_appframe";
+    if (!region.slot.empty()) {
+        region.targetDirectory.append("_").append(region.slot);
+    }
+    printKeyValue("CATALINA_BASE", region.targetDirectory);
+
+    // 所有输入与上次准备时相同时跳过准备
+    Metrics::Timer manifestTimer(preparePhaseMetric(PREPARE_MANIFEST));
+    char serverXmlMd5[MD5_STRING_SIZE + 1];
+    stringMd5(serverXmlContent(region), serverXmlMd5);
+    std::string reason;
+    bool upToDate = manifestMatches(region, serverXmlMd5, reason);
+    manifestTimer.end();
+    if (region.metrics != nullptr) {
+        Metrics::set(region.metrics->upToDate, upToDate ? 1 : 0);
+    }
+    if (upToDate) {
+        logger() << "[INFO ] CATALINA_BASE is up to date: " << region.targetDirectory << std::endl;
+        return prepareClassDataSharing(region);
+    }
+    if (enableDebug || planOnly) {
+        logger() << "[INFO ] prepare CATALINA_BASE: " << reason << std::endl;
+    }
+
+    Trace::Scope directoriesScope("check directories");
+    Metrics::Timer directoriesTimer(preparePhaseMetric(PREPARE_DIRECTORIES));
+    // check region.targetDirectory
+    if (!checkDirectory(region.targetDirectory)) {
+        return false;
+    }
+
+    // check region.targetDirectory/conf
+#if defined(WINDOWS)
+    std::string targetConf = region.targetDirectory + "\\conf\\";
+#elif defined(UNIX) || defined(LINUX)
+    std::string targetConf = region.targetDirectory + "/conf/";
+#endif
+    if (!checkDirectory(targetConf)) {
+        return false;
+    }
+
+    // check region.targetDirectory/logs
+#if defined(WINDOWS)
+    std::string targetLogs = region.targetDirectory + "\\logs\\";
+#elif defined(UNIX) || defined(LINUX)
+    std::string targetLogs = region.targetDirectory + "/logs/";
+#endif
+    if (!checkDirectory(targetLogs)) {
+        return false;
+    }
+
+    // check region.targetDirectory/work
+#if defined(WINDOWS)
+    std::string targetWork = region.targetDirectory + "\\work\\";
+#elif defined(UNIX) || defined(LINUX)
+    std::string targetWork = region.targetDirectory + "/work/";
+#endif
+    if (!checkDirectory(targetWork)) {
+        return false;
+    }
+
+    // check region.targetDirectory/webapps
+#if defined(WINDOWS)
+    std::string targetWebapps = region.targetDirectory + "\\webapps\\";
+#elif defined(UNIX) || defined(LINUX)
+    std::string targetWebapps = region.targetDirectory + "/webapps/";
+#endif
+    if (!checkDirectory(targetWebapps)) {
+        return false;
+    }
+
+    // check region.targetDirectory/temp
+#if defined(WINDOWS)
+    std::string targetTemp = region.targetDirectory + "\\temp\\";
+#elif defined(UNIX) || defined(LINUX)
+    std::string targetTemp = region.targetDirectory + "/temp/";
+#endif
+    if (!checkDirectory(targetTemp)) {
+        return false;
+    }
+    directoriesScope.end();
+    directoriesTimer.end();
+
+    char aMd5[MD5_STRING_SIZE + 1];
+    char bMd5[MD5_STRING_SIZE + 1];
+    {
+        TRACE_SCOPE("sync conf");
+        Metrics::Timer confTimer(preparePhaseMetric(PREPARE_CONF));
+        // 确认/conf下的配置文件
+#if defined(WINDOWS)
+        std::string tomcatConf = tomcatLocation + "\\conf\\";
+#elif defined(UNIX) || defined(LINUX)
+        std::string tomcatConf = tomcatLocation + "/conf/";
+#endif
+        for (auto &confFileName : CONF_COPY_FILE) {
+            std::string sourceConfFile = tomcatConf + confFileName;
+            std::string targetConfFile = targetConf + confFileName;
+
+            if (enableDebug) {
+                logger() << "[DEBUG] check file: " << targetConfFile << std::endl;
+            }
+            // 文件不存在或文件不一致
+            if (!fileExist(targetConfFile)) {
+                if (enableDebug) {
+                    logger() << "[DEBUG] file not exist: " << targetConfFile << std::endl;
+                }
+                // 复制文件
+                if (!copyFile(sourceConfFile, targetConfFile)) {
+                    logger() << "[ERROR] copy file failed: " << confFileName;
+                    return false;
+                }
+            } else if (!sameAsSource(sourceConfFile, targetConfFile, aMd5, bMd5)) {
+                if (enableDebug) {
+                    logger() << "[DEBUG] file was changed: " << sourceConfFile << std::endl;
+                }
+                // 复制文件
+                if (!copyFile(sourceConfFile, targetConfFile)) {
+                    logger() << "[ERROR] copy file failed: " << confFileName;
+                    return false;
+                }
+            }
+        }
+    }
+
+    {
+        TRACE_SCOPE("sync war");
+        Metrics::Timer warTimer(preparePhaseMetric(PREPARE_WAR));
+        // 检查war包
+        std::string targetWarPath = targetWebapps + "appframe.war";
+        // war包不存在
+        if (!fileExist(targetWarPath)) {
+            if (enableDebug) {
+                logger() << "[DEBUG] appframe package not exist: " << targetWebapps << std::endl;
+            }
+            if (!copyFile(region.warFile, targetWebapps + "appframe.war")) {
+                logger() << "[ERROR] copy appframe package failed: " << region.warFile;
+                return false;
+            }
+        }
+            // war包存在但不相同
+        else if (!sameAsSource(region.warFile, targetWarPath, aMd5, bMd5)) {
+            logger() << "[INFO ] appframe package was changed: " << region.warFile << std::endl;
+            printKeyValue("\tSource War MD5", aMd5);
+            printKeyValue("\tTarget War MD5", bMd5);
+            if (!copyFile(region.warFile, targetWebapps + "appframe.war")) {
+                logger() << "[ERROR] copy appframe package failed: " << region.warFile;
+                return false;
+            }
+        }
+    }
+
+    return writeServerXml(region) && writeManifest(region, serverXmlMd5) && prepareClassDataSharing(region);
+}
+
+/**
+ * JMX 远程端口的 JVM 参数, JMX 与 RMI 使用同一端口, 只监听 127.0.0.1, 默认使用密码认证
+ * (不需要 Tomcat 的 catalina-jmx-remote.jar)
+ *
+ * @param region 区域配置
+ * @param options JVM 参数
+ */
+void addJmxOptions(const Region &region, std::vector<std::string> &options) {
+    int port;
+    if (!PortPlanner::parsePort(region.jmxPort, port) || port <= 0) {
+        return;
+    }
+    options.push_back("-Dcom.sun.management.jmxremote");
+    options.push_back("-Dcom.sun.management.jmxremote.port=" + region.jmxPort);
+    options.push_back("-Dcom.sun.management.jmxremote.rmi.port=" + region.jmxPort);
+    options.push_back("-Dcom.sun.management.jmxremote.host=127.0.0.1");
+    options.push_back("-Djava.rmi.server.hostname=127.0.0.1");
+    options.push_back("-Dcom.sun.management.jmxremote.ssl=false");
+    if (!region.jmxAuthenticate) {
+        options.push_back("-Dcom.sun.management.jmxremote.authenticate=false");
+        return;
+    }
+    options.push_back("-Dcom.sun.management.jmxremote.authenticate=true");
+    options.push_back("-Dcom.sun.management.jmxremote.password.file=" + region.jmxPasswordFile);
+    if (!region.jmxAccessFile.empty()) {
+        options.push_back("-Dcom.sun.management.jmxremote.access.file=" + region.jmxAccessFile);
+    }
+}
+
+/**
+ * 生成 Tomcat 启动参数和环境变量, 不经过 shell
+ *
+ * @param launcher 启动器
+ * @param region 区域配置
+ */
+void prepareLauncher(Launcher &launcher, const Region &region) {
+    launcher.clearArguments();
+    launcher.setEnvironment("JAVA_HOME", javaHome);
+    launcher.setEnvironment("CATALINA_HOME", tomcatLocation);
+    launcher.setEnvironment("CATALINA_BASE", region.targetDirectory);
+    launcher.setPlacement(region.placementCpus, region.placementNode);
+
+    if (launchMode == "java") {
+        // 直接启动 JVM, 每个 JVM 参数都是独立的 argv 元素
+        launcher.setProgram(javaHome + JAVA_EXECUTABLE);
+        // 生成的参数在前, 同一参数出现多次时 JVM 使用最后一个
+        std::vector<std::string> options = region.sizingOptions;
+        addJmxOptions(region, options);
+        splitArguments(javaOptions, options);
+        for (auto &option : options) {
+            launcher.addArgument(option);
+        }
+        if (!region.cdsOption.empty()) {
+            launcher.addArgument(region.cdsOption);
+        }
+#if defined(WINDOWS)
+        std::string separator = "\\";
+#elif defined(UNIX) || defined(LINUX)
+        std::string separator = "/";
+#endif
+        launcher.addArgument("-DBOSSSOFT_HOME=" + region.bsHomeDirectory);
+        launcher.addArgument("-Djava.util.logging.config.file=" + region.targetDirectory + separator + "conf" +
+                             separator + "logging.properties");
+        launcher.addArgument("-Djava.util.logging.manager=org.apache.juli.ClassLoaderLogManager");
+        launcher.addArgument("-Dcatalina.base=" + region.targetDirectory);
+        launcher.addArgument("-Dcatalina.home=" + tomcatLocation);
+        launcher.addArgument("-Djava.io.tmpdir=" + region.targetDirectory + separator + "temp");
+        launcher.addArgument("-classpath");
+        launcher.addArgument(tomcatLocation + TOMCAT_BOOTSTRAP_CLASSPATH[0] + PATH_LIST_SEPARATOR +
+                             tomcatLocation + TOMCAT_BOOTSTRAP_CLASSPATH[1]);
+        launcher.addArgument("org.apache.catalina.startup.Bootstrap");
+        launcher.addArgument("start");
+    } else {
+        std::vector<std::string> options = region.sizingOptions;
+        addJmxOptions(region, options);
+        std::string opts;
+        for (auto &option : options) {
+            opts.append(option).append(" ");
+        }
+        opts.append(javaOptions);
+        if (!isBlank(javaOptions)) {
+            opts.append(" ");
+        }
+        opts.append("-DBOSSSOFT_HOME=").append(region.bsHomeDirectory);
+        if (!region.cdsOption.empty()) {
+            opts.append(" ").append(region.cdsOption);
+        }
+        launcher.setEnvironment("JAVA_OPTS", opts);
+        launcher.setProgram(tomcatLocation + TOMCAT_CATALINA);
+        launcher.addArgument("run");
+    }
+}
+
+struct PropertiesDiff {
+    Properties *other;
+    std::vector<std::string> *changedKeys;
+};
+
+static void collectChangedKey(const char *key, const char *value, void *context) {
+    auto *diff = (PropertiesDiff *) context;
+    const char *otherValue = diff->other->get(key);
+    if (otherValue == nullptr || 0 != strcmp(value, otherValue)) {
+        diff->changedKeys->push_back(key);
+    }
+}
+
+static void collectRemovedKey(const char *key, const char *, void *context) {
+    auto *diff = (PropertiesDiff *) context;
+    if (diff->other->get(key) == nullptr) {
+        diff->changedKeys->push_back(key);
+    }
+}
+
+/**
+ * 比较两份配置, 得到新增、修改和删除的键
+ *
+ * @param oldProperties 旧配置
+ * @param newProperties 新配置
+ * @param changedKeys 变化的键
+ */
+void diffProperties(Properties *oldProperties, Properties *newProperties, std::vector<std::string> &changedKeys) {
+    PropertiesDiff diff{oldProperties, &changedKeys};
+    newProperties->forEach(collectChangedKey, &diff);
+
+    diff.other = newProperties;
+    oldProperties->forEach(collectRemovedKey, &diff);
+}
+
+/**
+ * 是否只有端口配置发生变化 (只需要重新生成 server.xml)
+ *
+ * @param regionName 区域名称
+ * @param changedKeys 变化的键
+ * @return 是否只有端口变化
+ */
+bool onlyPortsChanged(const std::string &regionName, const std::vector<std::string> &changedKeys) {
+    // jmx.port 是 JVM 参数, 不在 server.xml 中
+    const char *portKeys[] = {APPDRAME_SHUTDOWN_PORT, APPFRAME_HTTP_PORT, APPFRAME_HTTPS_PORT,
+                              APPFRAME_AJP_PORT};
+    std::string regionPrefix = regionName + ".";
+    for (auto &key : changedKeys) {
+        // 其他区域的键
+        if (0 != key.compare(0, regionPrefix.length(), regionPrefix)) {
+            continue;
+        }
+        bool isPort = false;
+        for (auto &portKey : portKeys) {
+            if (key == regionName + portKey) {
+                isPort = true;
+                break;
+            }
+        }
+        if (!isPort) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * 区域生成的 server.xml, manifest 和启动命令, 重新生成前后不同时需要重启区域
+ *
+ * @param region 区域配置
+ * @return 指纹
+ */
+std::string regionFingerprint(const Region &region) {
+    std::string fingerprint;
+    std::string content;
+    for (auto file : {TOMCAT_SERVER_XML, APPFRAME_MANIFEST}) {
+        std::string path = region.targetDirectory + file;
+        if (fileExist(path) && readTextFile(path, content)) {
+            fingerprint.append(content);
+        }
+        fingerprint.append("\n");
+    }
+    Launcher launcher;
+    prepareLauncher(launcher, region);
+    fingerprint.append(launcher.describe());
+    return fingerprint;
+}
+
+/**
+ * checkCommonConfiguration 修改的全局配置, 重新读取的公共配置无效时恢复
+ */
+struct CommonConfiguration {
+    bool enableDebug;
+    std::string tomcatLocation;
+    std::string javaHome;
+    std::string javaOptions;
+    std::string launchMode;
+    bool consoleCapture;
+    bool classDataSharing;
+    bool jvmSizing;
+    int sizingHeapPercent;
+    std::string numaPlacement;
+    bool slotsEnabled;
+    int slotPortOffset;
+    Template serverXmlTemplate;
+    int samplerInterval;
+    int samplerCapacity;
+    LogRetention::Policy logsPolicy;
+    std::string metricsAddress;
+    int metricsPort;
+    ConsoleCapture::Policy consolePolicy;
+};
+
+/**
+ * 保存当前的公共配置
+ *
+ * @return 公共配置
+ */
+CommonConfiguration saveCommonConfiguration() {
+    return CommonConfiguration{enableDebug, tomcatLocation, javaHome, javaOptions, launchMode, consoleCapture,
+                               classDataSharing, jvmSizing, sizingHeapPercent, numaPlacement, slotsEnabled,
+                               slotPortOffset, serverXmlTemplate, samplerInterval, samplerCapacity, logsPolicy,
+                               metricsAddress, metricsPort, consolePolicy};
+}
+
+/**
+ * 恢复保存的公共配置
+ *
+ * @param saved 公共配置
+ */
+void restoreCommonConfiguration(const CommonConfiguration &saved) {
+    enableDebug = saved.enableDebug;
+    tomcatLocation = saved.tomcatLocation;
+    javaHome = saved.javaHome;
+    javaOptions = saved.javaOptions;
+    launchMode = saved.launchMode;
+    consoleCapture = saved.consoleCapture;
+    classDataSharing = saved.classDataSharing;
+    jvmSizing = saved.jvmSizing;
+    sizingHeapPercent = saved.sizingHeapPercent;
+    numaPlacement = saved.numaPlacement;
+    slotsEnabled = saved.slotsEnabled;
+    slotPortOffset = saved.slotPortOffset;
+    serverXmlTemplate = saved.serverXmlTemplate;
+    samplerInterval = saved.samplerInterval;
+    samplerCapacity = saved.samplerCapacity;
+    logsPolicy = saved.logsPolicy;
+    metricsAddress = saved.metricsAddress;
+    metricsPort = saved.metricsPort;
+    consolePolicy = saved.consolePolicy;
+}
+
+/**
+ * 重新读取配置文件, 只重新生成受影响区域的 server.xml 和启动命令
+ *
+ * @param configFilePath 配置文件路径
+ * @param regions 区域配置
+ * @param properties 当前配置, 读取成功后替换为新的配置
+ * @param changedRegions 生成的文件或启动命令变化的区域下标
+ */
+void reloadConfiguration(const std::string &configFilePath, std::vector<Region> &regions, Properties *&properties,
+                         std::vector<size_t> &changedRegions) {
+    auto begin = std::chrono::steady_clock::now();
+    auto *newProperties = new Properties(configFilePath.c_str());
+    if (!newProperties->isInitSuccess()) {
+        logger() << "[WARN ] reload configuration failed, keep the previous one." << std::endl;
+        delete newProperties;
+        return;
+    }
+
+    std::vector<std::string> changedKeys;
+    diffProperties(properties, newProperties, changedKeys);
+    auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - begin).count();
+    logger() << "[INFO ] configuration reloaded in " << elapsed << "us, "
+             << changedKeys.size() << " key(s) changed." << std::endl;
+
+    bool commonAffected = false;
+    for (auto &key : changedKeys) {
+        if (enableDebug) {
+            logger() << "[DEBUG] changed: " << key << std::endl;
+        }
+        if (0 == key.compare(0, 7, "common.")) {
+            commonAffected = true;
+        }
+    }
+
+    // 公共配置会修改全局变量, 在检查之前记录
+    std::vector<std::string> fingerprints;
+    for (auto &region : regions) {
+        fingerprints.push_back(regionFingerprint(region));
+    }
+
+    // checkCommonConfiguration 出错前已修改部分全局配置
+    CommonConfiguration saved = saveCommonConfiguration();
+    if (commonAffected && !checkCommonConfiguration(newProperties)) {
+        restoreCommonConfiguration(saved);
+        logger() << "[WARN ] invalid common configuration, regions are not changed." << std::endl;
+        delete newProperties;
+        return;
+    }
+
+    for (size_t i = 0; i < regions.size(); i++) {
+        Region &region = regions[i];
+        std::string regionPrefix = region.name + ".";
+        bool regionAffected = commonAffected;
+        for (auto &key : changedKeys) {
+            if (0 == key.compare(0, regionPrefix.length(), regionPrefix)) {
+                regionAffected = true;
+                break;
+            }
+        }
+        if (!regionAffected) {
+            continue;
+        }
+
+        std::vector<Region> updatedRegions(1);
+        Region &updated = updatedRegions[0];
+        updated.slot = region.slot;
+        updated.metrics = region.metrics;
+        if (!checkArguments(region.name, newProperties, updated) ||
+            !planPorts(updatedRegions, newProperties, false)) {
+            logger() << "[WARN ] invalid configuration, region " << region.name << " is not changed." << std::endl;
+            continue;
+        }
+
+        bool success;
+        if (!commonAffected && onlyPortsChanged(region.name, changedKeys)) {
+            updated.targetDirectory = region.targetDirectory;
+            updated.cdsOption = region.cdsOption;
+            success = writeServerXml(updated);
+        } else {
+            success = generateVirtualTomcat(updated);
+        }
+        if (!success) {
+            logger() << "[WARN ] regenerate region failed: " << region.name << std::endl;
+            continue;
+        }
+        // 资源按启动时的区域分配
+        updated.sizingOptions = region.sizingOptions;
+        updated.placementCpus = region.placementCpus;
+        updated.placementNode = region.placementNode;
+        region = updated;
+
+        if (regionFingerprint(region) == fingerprints[i]) {
+            logger() << "[INFO ] region " << region.name << " is unchanged." << std::endl;
+            continue;
+        }
+        Launcher launcher;
+        prepareLauncher(launcher, region);
+        logger() << "[INFO ] COMMAND(" << region.name << "): " << launcher.describe() << std::endl;
+        changedRegions.push_back(i);
+    }
+
+    delete properties;
+    properties = newProperties;
+}
+
+/**
+ * 读取配置文件变化的合并等待时间
+ *
+ * @param properties 配置信息
+ * @param debounce 等待时间(毫秒)
+ * @return 是否有效
+ */
+bool checkWatchDebounce(Properties *properties, int &debounce) {
+    std::string debounceStr;
+    checkNoRequired(properties, COMMON_WATCH_DEBOUNCE, debounceStr, "200");
+    long value;
+    if (!parseInteger(debounceStr, 0, value)) {
+        logger() << "[ERROR] " << COMMON_WATCH_DEBOUNCE
+                 << " cannot be " << debounceStr
+                 << "." << std::endl;
+        return false;
+    }
+    debounce = (int) value;
+    return true;
+}
+
+/**
+ * 监听配置文件, 变化后只重新生成受影响区域的 server.xml 和启动命令
+ *
+ * @param configFilePath 配置文件路径
+ * @param regions 区域配置
+ * @param properties 当前配置, 由该函数接管
+ * @return 退出码
+ */
+int watchConfiguration(const std::string &configFilePath, std::vector<Region> &regions, Properties *properties) {
+    int debounce;
+    if (!checkWatchDebounce(properties, debounce)) {
+        delete properties;
+        return 2;
+    }
+
+    ConfigWatcher watcher(configFilePath.c_str(), debounce);
+    if (!watcher.start()) {
+        delete properties;
+        return 1;
+    }
+    logger() << "[INFO ] watching " << configFilePath << std::endl;
+
+    while (watcher.waitForChange()) {
+        std::vector<size_t> changedRegions;
+        reloadConfiguration(configFilePath, regions, properties, changedRegions);
+    }
+
+    delete properties;
+    return 1;
+}
+
+/**
+ * 注册所有区域的指标并启动 /metrics
+ *
+ * @param regions 区域配置
+ * @return 是否成功
+ */
+bool startMetrics(std::vector<Region> &regions) {
+    if (metricsPort <= 0) {
+        return true;
+    }
+    Metrics::set(metrics.add("appframe_uptime_seconds", "Time since the starter was started.",
+                             Metrics::ELAPSED, "", 1000000), programStart);
+    // 启动后不再增加, 区域保存其中元素的指针
+    regionMetrics.resize(regions.size());
+    for (size_t i = 0; i < regions.size(); i++) {
+        RegionMetrics &item = regionMetrics[i];
+        std::string label = Metrics::label("region", regions[i].name);
+        for (int phase = 0; phase < PREPARE_PHASE_NUMBER; phase++) {
+            item.prepareSeconds[phase] = metrics.add(
+                    "appframe_prepare_seconds", "Duration of the last CATALINA_BASE preparation by phase.",
+                    Metrics::GAUGE, label + "," + Metrics::label("phase", PREPARE_PHASES[phase]), 1000000);
+        }
+        item.upToDate = metrics.add(
+                "appframe_prepare_up_to_date", "1 when the last preparation was skipped by the manifest.",
+                Metrics::GAUGE, label, 1);
+        item.bytesHashed = metrics.add(
+                "appframe_prepare_hashed_bytes_total", "Bytes read to compute MD5 digests.",
+                Metrics::COUNTER, label, 1);
+        item.bytesCopied = metrics.add(
+                "appframe_prepare_copied_bytes_total", "Bytes copied into CATALINA_BASE.",
+                Metrics::COUNTER, label, 1);
+        item.digestCacheHits = metrics.add(
+                "appframe_digest_cache_hits_total", "Digests taken from the cache, size and mtime unchanged.",
+                Metrics::COUNTER, label, 1);
+        item.digestCacheMisses = metrics.add(
+                "appframe_digest_cache_misses_total", "Digests that had to be computed.",
+                Metrics::COUNTER, label, 1);
+        item.spawns = metrics.add(
+                "appframe_region_spawns_total", "Tomcat processes started.",
+                Metrics::COUNTER, label, 1);
+        item.restarts = metrics.add(
+                "appframe_region_restarts_total", "Tomcat processes restarted by --supervise.",
+                Metrics::COUNTER, label, 1);
+        item.exits = metrics.add(
+                "appframe_region_exits_total", "Tomcat processes that exited.",
+                Metrics::COUNTER, label, 1);
+        item.lastExitStatus = metrics.add(
+                "appframe_region_last_exit_status", "Exit status of the last Tomcat process, -1 if it did not start.",
+                Metrics::GAUGE, label, 1);
+        item.uptime = metrics.add(
+                "appframe_region_uptime_seconds", "Time since the Tomcat process was started, 0 when not running.",
+                Metrics::ELAPSED, label, 1000000);
+        item.logsCompressed = metrics.add(
+                "appframe_logs_files_total", "Log files compressed, rotated or deleted by common.logs.*.",
+                Metrics::COUNTER, label + "," + Metrics::label("action", "compressed"), 1);
+        item.logsRotated = metrics.add(
+                "appframe_logs_files_total", "Log files compressed, rotated or deleted by common.logs.*.",
+                Metrics::COUNTER, label + "," + Metrics::label("action", "rotated"), 1);
+        item.logsDeleted = metrics.add(
+                "appframe_logs_files_total", "Log files compressed, rotated or deleted by common.logs.*.",
+                Metrics::COUNTER, label + "," + Metrics::label("action", "deleted"), 1);
+        item.logsBytesRead = metrics.add(
+                "appframe_logs_compress_input_bytes_total", "Log bytes compressed.",
+                Metrics::COUNTER, label, 1);
+        item.logsBytesWritten = metrics.add(
+                "appframe_logs_compress_output_bytes_total", "Bytes of the written .gz archives.",
+                Metrics::COUNTER, label, 1);
+        item.logsCompressSeconds = metrics.add(
+                "appframe_logs_compress_seconds_total", "Time spent compressing, input bytes / seconds is the throughput.",
+                Metrics::COUNTER, label, 1000000);
+        item.logsBytesReclaimed = metrics.add(
+                "appframe_logs_reclaimed_bytes_total", "Disk space freed by compression and deletion.",
+                Metrics::COUNTER, label, 1);
+        regions[i].metrics = &item;
+    }
+    if (!metrics.start(metricsAddress, metricsPort)) {
+        logger() << "[ERROR] start metrics failed, please check " << COMMON_METRICS_LISTEN << std::endl;
+        return false;
+    }
+    logger() << "[INFO ] METRICS: http://" << metricsAddress << ":" << metricsPort << "/metrics" << std::endl;
+    return true;
+}
+
+/**
+ * 记录区域的 Tomcat 已启动
+ *
+ * @param region 区域配置
+ */
+void recordSpawn(const Region &region) {
+    if (region.metrics == nullptr) {
+        return;
+    }
+    if (region.metrics->spawns->load(std::memory_order_relaxed) > 0) {
+        Metrics::count(region.metrics->restarts, 1);
+    }
+    Metrics::count(region.metrics->spawns, 1);
+    Metrics::set(region.metrics->uptime, Metrics::now());
+}
+
+/**
+ * 记录区域的 Tomcat 已退出
+ *
+ * @param region 区域配置
+ * @param status 退出码
+ */
+void recordExit(const Region &region, int status) {
+    if (region.metrics == nullptr) {
+        return;
+    }
+    Metrics::count(region.metrics->exits, 1);
+    Metrics::set(region.metrics->lastExitStatus, status);
+    Metrics::set(region.metrics->uptime, 0);
+}
+
+/**
+ * 并行生成所有区域的 CATALINA_BASE
+ *
+ * @param regions 区域配置
+ * @param jobs 最大并行数
+ * @return 是否全部成功
+ */
+bool prepareRegions(std::vector<Region> &regions, int jobs) {
+    TRACE_SCOPE("prepareRegions");
+    auto begin = std::chrono::steady_clock::now();
+    if (jobs > (int) regions.size()) {
+        jobs = (int) regions.size();
+    }
+
+    bool success = true;
+    if (jobs <= 1) {
+        for (auto &region : regions) {
+            success = generateVirtualTomcat(region) && success;
+        }
+    } else {
+        std::atomic<size_t> next(0);
+        std::atomic<bool> allSuccess(true);
+        std::mutex outputMutex;
+        std::vector<std::thread> workers;
+        for (int i = 0; i < jobs; i++) {
+            workers.emplace_back([&regions, &next, &allSuccess, &outputMutex]() {
+                size_t index;
+                while ((index = next.fetch_add(1)) < regions.size()) {
+                    // 每个区域的日志整体输出, 不与其他区域交错
+                    std::ostringstream buffer;
+                    logStream = &buffer;
+                    if (!generateVirtualTomcat(regions[index])) {
+                        allSuccess.store(false);
+                    }
+                    logStream = &std::cout;
+
+                    std::lock_guard<std::mutex> lock(outputMutex);
+                    std::cout << buffer.str() << std::flush;
+                }
+            });
+        }
+        for (auto &worker : workers) {
+            worker.join();
+        }
+        success = allSuccess.load();
+    }
+
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now() - begin).count();
+    logger() << "[INFO ] prepared " << regions.size() << " region(s) in " << elapsed
+             << "ms with " << (jobs < 1 ? 1 : jobs) << " worker(s)" << std::endl;
+    return success;
+}
+
+/**
+ * 为每个区域创建控制台输出通道, 通道序号与区域序号相同
+ *
+ * @param console 控制台输出
+ * @param regions 区域配置
+ * @return 是否成功
+ */
+bool startConsoleCapture(ConsoleCapture &console, const std::vector<Region> &regions) {
+    for (auto &region : regions) {
+        console.add(region.name, region.targetDirectory + TOMCAT_CONSOLE_LOG);
+    }
+    return console.start();
+}
+
+/**
+ * 停止控制台输出并打印统计
+ *
+ * @param console 控制台输出
+ */
+void stopConsoleCapture(ConsoleCapture &console) {
+    console.stop();
+    for (int i = 0; i < console.channels(); i++) {
+        ConsoleCapture::Statistics statistics = console.statistics(i);
+        logger() << "[INFO ] CONSOLE(" << console.name(i) << "): " << statistics.linesWritten << " lines, "
+                 << statistics.bytesWritten << " bytes written, " << statistics.linesDropped << " lines, "
+                 << statistics.bytesDropped << " bytes dropped, " << statistics.stalls << " stalls, "
+                 << statistics.rotations << " rotations" << std::endl;
+    }
+}
+
+/**
+ * 为每个区域创建 logs/samples.bin, 通道序号与区域序号相同
+ *
+ * @param sampler 采样器
+ * @param regions 区域配置
+ * @return 是否成功
+ */
+bool startSampler(ProcSampler &sampler, const std::vector<Region> &regions) {
+    for (auto &region : regions) {
+        sampler.add(region.name, region.targetDirectory + TOMCAT_SAMPLES);
+    }
+    if (!sampler.start()) {
+        return false;
+    }
+    logger() << "[INFO ] sampling /proc every " << samplerInterval << "ms, " << samplerCapacity
+             << " samples kept per region" << std::endl;
+    return true;
+}
+
+static void onLogsChanged(int channel, const LogRetention::Statistics &delta, void *context) {
+    const Region &region = (*(const std::vector<Region> *) context)[channel];
+    if (region.metrics == nullptr) {
+        return;
+    }
+    Metrics::count(region.metrics->logsCompressed, (long long) delta.filesCompressed);
+    Metrics::count(region.metrics->logsRotated, (long long) delta.filesRotated);
+    Metrics::count(region.metrics->logsDeleted, (long long) delta.filesDeleted);
+    Metrics::count(region.metrics->logsBytesRead, (long long) delta.bytesRead);
+    Metrics::count(region.metrics->logsBytesWritten, (long long) delta.bytesWritten);
+    Metrics::count(region.metrics->logsCompressSeconds, (long long) delta.compressMicros);
+    Metrics::count(region.metrics->logsBytesReclaimed, (long long) delta.bytesReclaimed);
+}
+
+/**
+ * 为每个区域的 logs 目录创建保留通道, 通道序号与区域序号相同
+ *
+ * @param retention 日志保留
+ * @param regions 区域配置
+ * @return 是否成功
+ */
+bool startLogRetention(LogRetention &retention, const std::vector<Region> &regions) {
+    for (auto &region : regions) {
+        retention.add(region.name, logsDirectory(region.targetDirectory));
+    }
+    retention.setListener(onLogsChanged, (void *) &regions);
+    if (!retention.start()) {
+        return false;
+    }
+    logger() << "[INFO ] scanning logs every " << logsPolicy.intervalSeconds << "s with "
+             << logsPolicy.threads << " idle thread(s)" << std::endl;
+    return true;
+}
+
+/**
+ * 停止日志保留并打印统计
+ *
+ * @param retention 日志保留
+ */
+void stopLogRetention(LogRetention &retention) {
+    retention.stop();
+    for (int i = 0; i < retention.channels(); i++) {
+        LogRetention::Statistics statistics = retention.statistics(i);
+        double seconds = (double) statistics.compressMicros / 1000000.0;
+        char throughput[32];
+        snprintf(throughput, sizeof(throughput), "%.1f",
+                 seconds > 0 ? (double) statistics.bytesRead / 1048576.0 / seconds : 0.0);
+        logger() << "[INFO ] LOGS(" << retention.name(i) << "): " << statistics.filesCompressed << " compressed, "
+                 << statistics.filesRotated << " rotated, " << statistics.filesDeleted << " deleted, "
+                 << statistics.bytesRead << " -> " << statistics.bytesWritten << " bytes at " << throughput
+                 << " MB/s, " << statistics.bytesReclaimed << " bytes reclaimed" << std::endl;
+    }
+}
+
+/**
+ * 监管模式下启动和退出回调的上下文
+ */
+struct SupervisedRegions {
+    const std::vector<Region> *regions;
+    // 未捕获控制台输出时为 nullptr
+    ConsoleCapture *console;
+    ProcSampler *sampler;
+};
+
+static void onRegionStarted(size_t index, Launcher *launcher, void *context) {
+    auto *supervised = (SupervisedRegions *) context;
+    if (supervised->console != nullptr) {
+        supervised->console->attach((int) index, launcher->takeOutput());
+    }
+    supervised->sampler->setPid((int) index, launcher->pid());
+    recordSpawn((*supervised->regions)[index]);
+}
+
+static void onRegionExited(size_t index, int status, void *context) {
+    auto *supervised = (SupervisedRegions *) context;
+    supervised->sampler->setPid((int) index, 0);
+    recordExit((*supervised->regions)[index], status);
+}
+
+/**
+ * 把启动过程的跟踪数据写入每个区域的 logs/trace.json
+ *
+ * @param regions 区域配置
+ */
+void writeTraces(const std::vector<Region> &regions) {
+    if (!Trace::enabled()) {
+        return;
+    }
+    for (auto &region : regions) {
+#if defined(WINDOWS)
+        std::string tracePath = region.targetDirectory + "\\logs\\trace.json";
+#elif defined(UNIX) || defined(LINUX)
+        std::string tracePath = region.targetDirectory + "/logs/trace.json";
+#endif
+        if (Trace::write(tracePath, region.name)) {
+            logger() << "[INFO ] TRACE(" << region.name << "): " << tracePath << std::endl;
+        }
+    }
+}
+
+/**
+ * 依次启动所有区域, 每次启动间隔 stagger 毫秒, 然后等待所有 Tomcat 退出
+ *
+ * @param regions 区域配置
+ * @param stagger 启动间隔(毫秒)
+ * @param readyTimeout 就绪超时(毫秒), 小于 0 时不检查
+ * @return 退出码
+ */
+int launchRegions(const std::vector<Region> &regions, int stagger, int readyTimeout) {
+    std::vector<std::unique_ptr<Launcher>> launchers;
+    std::vector<const Region *> started;
+    ReadinessProbe probe;
+    ConsoleCapture console(consolePolicy);
+    if (consoleCapture && !startConsoleCapture(console, regions)) {
+        return 5;
+    }
+    ProcSampler sampler(samplerInterval, samplerCapacity);
+    if (samplerInterval > 0 && !startSampler(sampler, regions)) {
+        return 5;
+    }
+    LogRetention retention(logsPolicy);
+    if (logsPolicy.intervalSeconds > 0 && !startLogRetention(retention, regions)) {
+        return 5;
+    }
+    for (size_t i = 0; i < regions.size(); i++) {
+        if (i > 0 && stagger > 0) {
+            // 检查就绪时在启动间隔内继续探测已启动的区域
+            if (readyTimeout >= 0) {
+                probe.run(stagger);
+            } else {
+                std::this_thread::sleep_for(std::chrono::milliseconds(stagger));
+            }
+        }
+
+        std::unique_ptr<Launcher> launcher(new Launcher());
+        prepareLauncher(*launcher, regions[i]);
+        launcher->captureOutput(consoleCapture);
+        logger() << "[INFO ] COMMAND(" << regions[i].name << "): " << launcher->describe() << std::endl;
+        bool spawned;
+        {
+            Trace::TrackScope track(regions[i].name);
+            TRACE_SCOPE("spawn");
+            spawned = launcher->start();
+        }
+        if (!spawned) {
+            logger() << "[ERROR] start region failed: " << regions[i].name << std::endl;
+            continue;
+        }
+        sampler.setPid((int) i, launcher->pid());
+        recordSpawn(regions[i]);
+        logger() << "[INFO ] PID(" << regions[i].name << "): " << launcher->pid()
+                 << ", spawn to exec: " << launcher->spawnMicros() << "us";
+        if (!regions[i].placementCpus.empty()) {
+            logger() << ", cpus " << Placement::formatCpuList(regions[i].placementCpus);
+        }
+        if (regions[i].placementNode != -1) {
+            logger() << ", node " << regions[i].placementNode;
+        }
+        logger() << std::endl;
+        console.attach((int) i, launcher->takeOutput());
+        if (readyTimeout >= 0) {
+            probe.add(regions[i].name, atoi(regions[i].httpPort.c_str()), regions[i].readyPath,
+                      logsDirectory(regions[i].targetDirectory), readyTimeout);
+        }
+        launchers.push_back(std::move(launcher));
+        started.push_back(&regions[i]);
+    }
+
+    writeTraces(regions);
+    if (launchers.empty()) {
+        return 5;
+    }
+
+    if (readyTimeout >= 0) {
+        bool ready = probe.run(-1);
+        for (auto &target : probe.targets()) {
+            if (target.readyMillis >= 0) {
+                logger() << "[INFO ] READY(" << target.name << "): spawn to listen " << target.listenMillis
+                         << "ms, startup log " << target.startupMillis << "ms";
+                if (!target.path.empty()) {
+                    logger() << ", GET " << target.path << " " << target.httpStatus << " "
+                             << target.httpMillis << "ms";
+                }
+                logger() << ", ready " << target.readyMillis << "ms" << std::endl;
+            } else {
+                logger() << "[ERROR] region " << target.name << " not ready in " << readyTimeout << "ms"
+                         << " (listen: " << target.listenMillis << "ms, startup log: " << target.startupMillis
+                         << "ms, GET status: " << target.httpStatus << ")" << std::endl;
+            }
+        }
+
+        // 超时后停止所有区域
+        if (!ready) {
+            for (auto &launcher : launchers) {
+                launcher->terminate();
+            }
+            for (auto &launcher : launchers) {
+                launcher->wait();
+            }
+            return 6;
+        }
+    }
+    // 启动失败的区域保留旧槽位
+    for (auto region : started) {
+        activateSlot(*region);
+    }
+    logger() << std::endl << "=========== VIRTUAL TOMCAT ===========" << std::endl;
+
+    int result = launchers.size() == regions.size() ? 0 : 5;
+    for (size_t i = 0; i < launchers.size(); i++) {
+        int status = launchers[i]->wait();
+        logger() << "[INFO ] tomcat(" << started[i]->name << ") exited with status " << status << std::endl;
+        sampler.setPid((int) (started[i] - regions.data()), 0);
+        recordExit(*started[i], status);
+        if (result == 0) {
+            result = status;
+        }
+    }
+    if (consoleCapture) {
+        stopConsoleCapture(console);
+    }
+    if (logsPolicy.intervalSeconds > 0) {
+        stopLogRetention(retention);
+    }
+    return result;
+}
+
+/**
+ * 监管模式下监听配置文件的上下文
+ */
+struct WatchedRegions {
+    std::string configFilePath;
+    ConfigWatcher *watcher;
+    std::vector<Region> *regions;
+    Properties **properties;
+    Supervisor *supervisor;
+    // 重启后的启动器, 与 supervisor 的生命周期相同
+    std::vector<std::unique_ptr<Launcher>> *launchers;
+};
+
+static void onConfigurationChanged(void *context) {
+    auto *watched = (WatchedRegions *) context;
+    bool changed;
+    if (!watched->watcher->pollChange(changed)) {
+        logger() << "[WARN ] watch configuration failed." << std::endl;
+        return;
+    }
+    if (!changed) {
+        return;
+    }
+
+    std::vector<size_t> changedRegions;
+    reloadConfiguration(watched->configFilePath, *watched->regions, *watched->properties, changedRegions);
+    for (auto index : changedRegions) {
+        const Region &region = (*watched->regions)[index];
+        std::unique_ptr<Launcher> launcher(new Launcher());
+        prepareLauncher(*launcher, region);
+        launcher->captureOutput(consoleCapture);
+        logger() << "[INFO ] restart region: " << region.name << std::endl;
+        watched->supervisor->restart(index, launcher.get(), atoi(region.shutdownPort.c_str()));
+        watched->launchers->push_back(std::move(launcher));
+    }
+}
+
+/**
+ * 监管模式: 启动所有区域, 异常退出的区域按退避时间重启, 收到 SIGTERM 时通过 shutdown.port 关闭.
+ * 同时监听配置文件时, 重新生成区域后重启生成的文件或启动命令变化的区域
+ *
+ * @param regions 区域配置
+ * @param stagger 启动间隔(毫秒)
+ * @param properties 配置信息, 监听配置文件时替换为新的配置
+ * @param configFilePath 要监听的配置文件, 为空时不监听
+ * @return 退出码
+ */
+int superviseRegions(std::vector<Region> &regions, int stagger, Properties *&properties,
+                     const std::string &configFilePath) {
+    std::string backoffStr;
+    std::string maxBackoffStr;
+    std::string restartLimitStr;
+    std::string shutdownTimeoutStr;
+    checkNoRequired(properties, COMMON_SUPERVISE_BACKOFF, backoffStr, "1000");
+    checkNoRequired(properties, COMMON_SUPERVISE_BACKOFF_MAX, maxBackoffStr, "60000");
+    checkNoRequired(properties, COMMON_SUPERVISE_RESTART_LIMIT, restartLimitStr, "5");
+    checkNoRequired(properties, COMMON_SUPERVISE_SHUTDOWN_TIMEOUT, shutdownTimeoutStr, "30000");
+
+    long backoff;
+    if (!parseInteger(backoffStr, 1, backoff)) {
+        logger() << "[ERROR] " << COMMON_SUPERVISE_BACKOFF
+                 << " cannot be " << backoffStr
+                 << "." << std::endl;
+        return 2;
+    }
+    long maxBackoff;
+    if (!parseInteger(maxBackoffStr, backoff, maxBackoff)) {
+        logger() << "[ERROR] " << COMMON_SUPERVISE_BACKOFF_MAX
+                 << " cannot be " << maxBackoffStr
+                 << ", it must not be less than " << COMMON_SUPERVISE_BACKOFF
+                 << "." << std::endl;
+        return 2;
+    }
+    // 0: 崩溃后不再重启
+    long restartLimit;
+    if (!parseInteger(restartLimitStr, 0, restartLimit)) {
+        logger() << "[ERROR] " << COMMON_SUPERVISE_RESTART_LIMIT
+                 << " cannot be " << restartLimitStr
+                 << "." << std::endl;
+        return 2;
+    }
+    long shutdownTimeout;
+    if (!parseInteger(shutdownTimeoutStr, 1, shutdownTimeout)) {
+        logger() << "[ERROR] " << COMMON_SUPERVISE_SHUTDOWN_TIMEOUT
+                 << " cannot be " << shutdownTimeoutStr
+                 << "." << std::endl;
+        return 2;
+    }
+    int debounce = 0;
+    if (!configFilePath.empty() && !checkWatchDebounce(properties, debounce)) {
+        return 2;
+    }
+
+    Supervisor::Policy policy{};
+    policy.staggerMillis = stagger;
+    policy.backoffMillis = (int) backoff;
+    policy.maxBackoffMillis = (int) maxBackoff;
+    policy.restartLimit = (int) restartLimit;
+    policy.shutdownTimeoutMillis = (int) shutdownTimeout;
+
+    std::vector<std::unique_ptr<Launcher>> launchers;
+    Supervisor supervisor(policy);
+    ConsoleCapture console(consolePolicy);
+    ProcSampler sampler(samplerInterval, samplerCapacity);
+    if (samplerInterval > 0 && !startSampler(sampler, regions)) {
+        return 5;
+    }
+    LogRetention retention(logsPolicy);
+    if (logsPolicy.intervalSeconds > 0 && !startLogRetention(retention, regions)) {
+        return 5;
+    }
+    SupervisedRegions supervised{&regions, nullptr, &sampler};
+    if (consoleCapture) {
+        if (!startConsoleCapture(console, regions)) {
+            return 5;
+        }
+        supervised.console = &console;
+    }
+    supervisor.setListener(onRegionStarted, &supervised);
+    supervisor.setExitListener(onRegionExited, &supervised);
+
+    ConfigWatcher watcher(configFilePath.c_str(), debounce);
+    WatchedRegions watched{configFilePath, &watcher, &regions, &properties, &supervisor, &launchers};
+    if (!configFilePath.empty()) {
+        if (!watcher.start()) {
+            return 1;
+        }
+        supervisor.watch(watcher.descriptor(), onConfigurationChanged, &watched);
+        logger() << "[INFO ] watching " << configFilePath << std::endl;
+    }
+    for (auto &region : regions) {
+        std::unique_ptr<Launcher> launcher(new Launcher());
+        prepareLauncher(*launcher, region);
+        launcher->captureOutput(consoleCapture);
+        logger() << "[INFO ] COMMAND(" << region.name << "): " << launcher->describe() << std::endl;
+        supervisor.add(region.name, launcher.get(), atoi(region.shutdownPort.c_str()));
+        launchers.push_back(std::move(launcher));
+    }
+    activateSlots(regions);
+
+    logger() << std::endl << "=========== VIRTUAL TOMCAT ===========" << std::endl;
+    int status = supervisor.run();
+    if (consoleCapture) {
+        stopConsoleCapture(console);
+    }
+    if (logsPolicy.intervalSeconds > 0) {
+        stopLogRetention(retention);
+    }
+    return status;
+}
+
+/**
+ * 子命令使用的区域 CATALINA_BASE, 使用槽位时为当前槽位
+ *
+ * @param regionName 区域名称
+ * @return CATALINA_BASE
+ */
+std::string activeTargetDirectory(const std::string &regionName) {
+    std::string targetDirectory = programDirectory + regionName + "_appframe";
+    std::string slot = readActiveSlot(regionName);
+    if (!slot.empty()) {
+        targetDirectory.append("_").append(slot);
+    }
+    return targetDirectory;
+}
+
+/**
+ * samples 命令: 以 CSV 打印区域的 /proc 采样, 最早的在前
+ *
+ * @param regionNames 区域名称
+ * @return 退出码
+ */
+int printSamples(const std::vector<std::string> &regionNames) {
+    std::cout << "region,time,pid,cpu_percent,threads,rss_bytes,pss_bytes,swap_bytes,"
+                 "read_bytes_per_second,write_bytes_per_second" << std::endl;
+    for (auto &name : regionNames) {
+        std::vector<ProcSampler::Sample> samples;
+        if (!ProcSampler::read(activeTargetDirectory(name) + TOMCAT_SAMPLES, samples)) {
+            return 1;
+        }
+        char line[256];
+        for (auto &sample : samples) {
+            snprintf(line, sizeof(line), ",%lld,%d,%d.%02d,%d,%lld,%lld,%lld,%lld,%lld",
+                     (long long) sample.time, sample.pid, sample.cpuHundredths / 100, sample.cpuHundredths % 100,
+                     sample.threads, (long long) sample.rssBytes, (long long) sample.pssBytes,
+                     (long long) sample.swapBytes, (long long) sample.readBytesPerSecond,
+                     (long long) sample.writeBytesPerSecond);
+            std::cout << name << line << '\n';
+        }
+    }
+    std::cout << std::flush;
+    return 0;
+}
+
+/**
+ * 格式化 unix 时间 (UTC)
+ *
+ * @param seconds unix 秒
+ * @return yyyy-MM-dd HH:mm:ss
+ */
+std::string formatUtc(long long seconds) {
+    time_t time = (time_t) seconds;
+    struct tm parts{};
+#if defined(WINDOWS)
+    gmtime_s(&parts, &time);
+#elif defined(UNIX) || defined(LINUX)
+    gmtime_r(&time, &parts);
+#endif
+    char buffer[32];
+    strftime(buffer, sizeof(buffer), "%Y-%m-%d %H:%M:%S", &parts);
+    return buffer;
+}
+
+/**
+ * logstat 命令: 统计区域的 logs/localhost_access_log*.txt
+ *
+ * @param regionNames 区域名称
+ * @param jobs 线程数
+ * @param top 显示访问最多的 URL 数量
+ * @return 退出码
+ */
+int printLogStat(const std::vector<std::string> &regionNames, int jobs, int top) {
+    for (auto &name : regionNames) {
+        std::string logs = logsDirectory(activeTargetDirectory(name));
+        std::vector<std::string> files = LogStat::accessLogs(logs);
+        if (files.empty()) {
+            logger() << "[ERROR] no access log found in " << logs << std::endl;
+            return 1;
+        }
+        LogStat::Result result;
+        if (!LogStat::run(files, jobs, (size_t) (top < 0 ? 0 : top), result)) {
+            return 1;
+        }
+
+        char line[256];
+        std::cout << "LOGSTAT(" << name << "): " << logs << std::endl;
+        snprintf(line, sizeof(line), "  %llu files, %.1f MB in %.3fs (%.0f MB/s, %d threads)",
+                 result.files, (double) result.fileBytes / 1048576.0, result.seconds,
+                 result.seconds > 0 ? (double) result.fileBytes / 1048576.0 / result.seconds : 0.0, result.threads);
+        std::cout << line << std::endl;
+        long long period = result.lastSecond - result.firstSecond + 1;
+        snprintf(line, sizeof(line), "  %llu requests, %llu bytes, %llu malformed lines, %llu urls",
+                 result.requests, result.bytes, result.malformed, result.urls);
+        std::cout << line << std::endl;
+        if (result.requests == 0) {
+            continue;
+        }
+        snprintf(line, sizeof(line), "  %.2f requests/s, peak %llu requests/s at ",
+                 (double) result.requests / (double) period, result.peakRequests);
+        std::cout << "  " << formatUtc(result.firstSecond) << " - " << formatUtc(result.lastSecond) << " UTC"
+                  << std::endl << line << formatUtc(result.peakSecond) << std::endl;
+
+        std::cout << "  status:";
+        for (int code = 0; code < 600; code++) {
+            if (result.status[code] > 0) {
+                std::cout << " " << (code == 0 ? "other" : std::to_string(code)) << "=" << result.status[code];
+            }
+        }
+        std::cout << std::endl;
+        for (auto &url : result.top) {
+            snprintf(line, sizeof(line), "  %12llu %16llu  ", url.requests, url.bytes);
+            std::cout << line << url.url << std::endl;
+        }
+    }
+    return 0;
+}
+
+/**
+ * --plan: 打印启动命令和槽位切换, 不启动
+ *
+ * @param regions 区域
+ */
+void printPlan(const std::vector<Region> &regions) {
+    for (auto &region : regions) {
+        Launcher launcher;
+        prepareLauncher(launcher, region);
+        logger() << "[PLAN ] start " << region.name << ": " << launcher.describe() << std::endl;
+    }
+    activateSlots(regions);
+}
+
+int main(int argc, char *argv[]) {
+    bool watchMode = false;
+    bool superviseMode = false;
+    bool readyMode = false;
+    bool traceMode = false;
+    bool snapshotMode = false;
+    bool redeployMode = false;
+    bool allRegions = false;
+    // 子命令, 例如 samples
+    std::string command;
+    int top = 10;
+    int jobs = (int) std::thread::hardware_concurrency();
+    int stagger = -1;
+    std::vector<std::string> regionNames;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (i == 1 && (arg == "samples" || arg == "logstat")) {
+            command = arg;
+        } else if (arg == "--watch") {
+            watchMode = true;
+        } else if (arg == "--trace") {
+            traceMode = true;
+        } else if (arg == "--ready") {
+            readyMode = true;
+        } else if (arg == "--supervise") {
+            superviseMode = true;
+        } else if (arg == "--snapshot") {
+            snapshotMode = true;
+        } else if (arg == "--redeploy") {
+            redeployMode = true;
+        } else if (arg == "--plan") {
+            planOnly = true;
+        } else if (arg == "--all") {
+            allRegions = true;
+        } else if ((arg == "--jobs" || arg == "--stagger") && i + 1 < argc) {
+            (arg == "--jobs" ? jobs : stagger) = atoi(argv[++i]);
+        } else if (arg == "--top" && i + 1 < argc) {
+            top = atoi(argv[++i]);
+        } else if (0 == arg.compare(0, 2, "--")) {
+            logger() << "[ERROR] unknown option: " << arg << std::endl;
+            return 1;
+        } else if (std::find(regionNames.begin(), regionNames.end(), arg) == regionNames.end()) {
+            regionNames.push_back(arg);
+        }
+    }
+
+    if (regionNames.empty() && !allRegions) {
+        logger() << "[ERROR] please enter the region of appframe." << std::endl;
+        return 1;
+    }
+    if (readyMode && (watchMode || superviseMode)) {
+        logger() << "[ERROR] --ready cannot be used with --watch or --supervise." << std::endl;
+        return 1;
+    }
+    if (redeployMode && (watchMode || superviseMode)) {
+        logger() << "[ERROR] --redeploy cannot be used with --watch or --supervise." << std::endl;
+        return 1;
+    }
+    // 新槽位就绪后才停止旧槽位
+    readyMode = readyMode || redeployMode;
+
+    if (traceMode) {
+        Trace::enable();
+    }
+
+    char *cwdDir = new char[MAX_PATH_LENGTH];
+
+#if defined(WINDOWS)
+    GetModuleFileNameA(nullptr, cwdDir, MAX_PATH_LENGTH);
+
+    // remove *.exe
+    size_t len = strlen(cwdDir);
+    for (size_t i = len - 1; i > 0; i--) {
+        if (cwdDir[i] == '\\') {
+            cwdDir[i] = '\0';
+            break;
+        }
+    }
+#elif defined(UNIX) || defined(LINUX)
+    getcwd(cwdDir, MAX_PATH_LENGTH);
+#endif
 
-    if (!checkArguments(argc, argv, properties)) {
+    programDirectory = std::string(cwdDir);
+
+    // 释放使用完的路径缓存
+    delete[] cwdDir;
+
+    if (command.empty()) {
+        printKeyValue("PROGRAM_HOME", programDirectory);
+    }
+
+#if defined(WINDOWS)
+    programDirectory.append("\\");
+#elif defined(UNIX) || defined(LINUX)
+    programDirectory.append("/");
+#endif
+
+    // 子命令不读取配置
+    if (!command.empty() && regionNames.empty()) {
+        logger() << "[ERROR] usage: " << command << " <region>..." << std::endl;
+        return 1;
+    }
+    if (command == "samples") {
+        return printSamples(regionNames);
+    }
+    if (command == "logstat") {
+        return printLogStat(regionNames, jobs, top);
+    }
+
+    std::string configFilePath = programDirectory + CONFIG_FILE;
+    printKeyValue("CONFIG_FILE", configFilePath);
+    Trace::Scope parseScope("parse configuration");
+    Properties *properties;
+    // --plan 不重新编译快照
+    if (snapshotMode && !planOnly) {
+        // 使用编译后的二进制配置快照, 配置文件变化后自动重新编译
+        std::string snapshotPath = configFilePath + CONFIG_SNAPSHOT_SUFFIX;
+        printKeyValue("CONFIG_SNAPSHOT", snapshotPath);
+        properties = new Properties();
+        if (!properties->loadSnapshot(configFilePath.c_str(), snapshotPath.c_str())) {
+            return 1;
+        }
+    } else {
+        properties = new Properties(configFilePath.c_str());
+    }
+
+    if (!properties->isInitSuccess()) {
+        return 1;
+    }
+    parseScope.end();
+
+    if (!checkCommonConfiguration(properties)) {
+        return 2;
+    }
+
+    if (allRegions) {
+        findRegions(properties, regionNames);
+        if (regionNames.empty()) {
+            logger() << "[ERROR] no region found in " << configFilePath << std::endl;
+            return 3;
+        }
+    }
+
+    // 启动间隔, 避免所有 JVM 同时启动
+    if (stagger < 0) {
+        std::string staggerStr;
+        checkNoRequired(properties, COMMON_LAUNCH_STAGGER, staggerStr, "1000");
+        stagger = atoi(staggerStr.c_str());
+    }
+
+    std::vector<Region> regions(regionNames.size());
+    for (size_t i = 0; i < regionNames.size(); i++) {
+        if (!checkArguments(regionNames[i], properties, regions[i])) {
+            return 3;
+        }
+    }
+
+    if (redeployMode && !slotsEnabled) {
+        logger() << "[ERROR] --redeploy needs " << COMMON_SLOTS_ENABLE << "=true" << std::endl;
+        return 1;
+    }
+    selectSlots(regions, redeployMode);
+
+    // 只监听时区域可能已在运行, 不检查端口能否绑定
+    if (!planPorts(regions, properties, !watchMode || superviseMode)) {
         return 3;
     }
 
-    // 释放使用完毕的配置
-    delete properties;
+    sizeRegions(regions);
+    if (!placeRegions(regions)) {
+        return 3;
+    }
+
+    // 准备区域前启动, 可以观察准备过程
+    if (!planOnly && !startMetrics(regions)) {
+        return 3;
+    }
 
-    std::string regionName = argv[1];
-    if (!generateVirtualTomcat(regionName)) {
+    if (!prepareRegions(regions, jobs)) {
         return 4;
     }
 
+    if (planOnly) {
+        printPlan(regions);
+        delete properties;
+        return 0;
+    }
+
+    if (watchMode || superviseMode) {
+        writeTraces(regions);
+    }
+
+    if (superviseMode) {
+        int status = superviseRegions(regions, stagger, properties, watchMode ? configFilePath : "");
+        delete properties;
+        return status;
+    }
+
+    if (watchMode) {
+        return watchConfiguration(configFilePath, regions, properties);
+    }
+
+    int readyTimeout = -1;
+    if (readyMode) {
+        std::string readyTimeoutStr;
+        checkNoRequired(properties, COMMON_READY_TIMEOUT, readyTimeoutStr, "120000");
+        readyTimeout = atoi(readyTimeoutStr.c_str());
+    }
+
+    // 释放使用完毕的配置
+    delete properties;
+
     // 生成并运行 Tomcat 命令
-    std::string command = generateCommand(javaHome, tomcatLocation, targetDirectory, javaOptions, bsHomeDirectory);
-    std::cout << "[INFO ] COMMAND: " << command << std::endl << std::endl
-              << "=========== VIRTUAL TOMCAT ===========" << std::endl;
-    system(command.c_str());
-    return 0;
+    return launchRegions(regions, stagger, readyTimeout);
 }
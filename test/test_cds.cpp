@@ -0,0 +1,229 @@
+//
+// Created by arsia on 2026/10/19.
+//
+// End-to-end check of the AppCDS archive handling (common.cds.enable).
+//
+// test_cds [--dir /tmp] [--starter PATH]
+//
+// Runs the real starter in java launch mode against a synthetic Tomcat home
+// whose bin/java is a shell stub. The stub records its arguments and, like a
+// JVM exiting normally, creates the file named by -XX:ArchiveClassesAtExit.
+// The first run must dump the archive, the next one must use it, and a
+// changed WAR, java.home or Tomcat jar must dump it again.
+//
+
+#include <cerrno>
+#include <cstdio>
+#include <string>
+#include <fcntl.h>
+#include <ftw.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+#ifndef APPFRAME_STARTER
+#define APPFRAME_STARTER "appframe-starter"
+#endif
+
+static const char *CONF_FILES[] = {
+        "catalina.policy",
+        "catalina.properties",
+        "context.xml",
+        "jaspic-providers.xml",
+        "jaspic-providers.xsd",
+        "logging.properties",
+        "tomcat-users.xml",
+        "tomcat-users.xsd",
+        "web.xml",
+        "server.xml"
+};
+
+static const char *DUMP = "-XX:ArchiveClassesAtExit=";
+static const char *USE = "-XX:SharedArchiveFile=";
+
+/* synthetic installation */
+struct Setup {
+    std::string directory;
+    std::string starter;
+    std::string war;
+};
+
+static bool writeFile(const std::string &path, const std::string &content, mode_t mode = 0644) {
+    int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, mode);
+    if (fd == -1 || write(fd, content.data(), content.size()) != (ssize_t) content.size()) {
+        fprintf(stderr, "test_cds: write file failed.[%s]\n", path.c_str());
+        if (fd != -1) {
+            close(fd);
+        }
+        return false;
+    }
+    close(fd);
+    return true;
+}
+
+static bool readFile(const std::string &path, std::string &content) {
+    FILE *file = fopen(path.c_str(), "rb");
+    if (file == nullptr) {
+        return false;
+    }
+    content.clear();
+    char buffer[4096];
+    size_t length;
+    while ((length = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+        content.append(buffer, length);
+    }
+    fclose(file);
+    return true;
+}
+
+// records the arguments and creates the archive a real JVM writes at exit
+static std::string javaStub(const std::string &directory) {
+    return "#!/bin/sh\n"
+           "printf '%s\\n' \"$@\" > " + directory + "/java.args\n"
+           "for arg in \"$@\"; do\n"
+           "    case \"$arg\" in\n"
+           "        " + DUMP + "*) : > \"${arg#" + DUMP + "}\" ;;\n"
+           "    esac\n"
+           "done\n"
+           "exit 0\n";
+}
+
+static bool createSetup(const Setup &setup) {
+    std::string tomcat = setup.directory + "/tomcat";
+    for (const std::string &path : {setup.directory, tomcat, tomcat + "/conf", tomcat + "/bin", tomcat + "/lib",
+                                    setup.directory + "/jdk", setup.directory + "/jdk/bin",
+                                    setup.directory + "/jdk2", setup.directory + "/jdk2/bin",
+                                    setup.directory + "/bshome"}) {
+        if (0 != mkdir(path.c_str(), 0755) && errno != EEXIST) {
+            fprintf(stderr, "test_cds: mkdir failed.[%s]\n", path.c_str());
+            return false;
+        }
+    }
+    for (auto name : CONF_FILES) {
+        if (!writeFile(tomcat + "/conf/" + name, std::string("<!-- ") + name + " -->\n")) {
+            return false;
+        }
+    }
+    return writeFile(tomcat + "/bin/bootstrap.jar", "bootstrap") &&
+           writeFile(tomcat + "/bin/tomcat-juli.jar", "juli") &&
+           writeFile(tomcat + "/lib/catalina.jar", "catalina") &&
+           writeFile(setup.directory + "/jdk/bin/java", javaStub(setup.directory), 0755) &&
+           writeFile(setup.directory + "/jdk2/bin/java", javaStub(setup.directory), 0755) &&
+           writeFile(setup.war, "war 1");
+}
+
+static bool writeConfiguration(const Setup &setup, const char *jdk) {
+    std::string content;
+    content.append("common.tomcat.location=").append(setup.directory).append("/tomcat\n");
+    content.append("common.java.home=").append(setup.directory).append("/").append(jdk).append("\n");
+    content.append("common.launch.mode=java\n");
+    content.append("common.launch.stagger=0\n");
+    content.append("common.cds.enable=true\n");
+    content.append("cds.war.location=").append(setup.war).append("\n");
+    content.append("cds.bshome.location=").append(setup.directory).append("/bshome\n");
+    content.append("cds.shutdown.port=auto\n");
+    content.append("cds.http.port=auto\n");
+    return writeFile(setup.directory + "/appframe-starter.conf", content);
+}
+
+static int removeEntry(const char *path, const struct stat *, int, struct FTW *) {
+    return remove(path);
+}
+
+static void removeTree(const std::string &path) {
+    nftw(path.c_str(), removeEntry, 16, FTW_DEPTH | FTW_PHYS);
+}
+
+static int runStarter(const Setup &setup) {
+    pid_t pid = fork();
+    if (pid == 0) {
+        if (0 != chdir(setup.directory.c_str())) {
+            _exit(127);
+        }
+        int log = open((setup.directory + "/starter.log").c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+        if (log != -1) {
+            dup2(log, STDOUT_FILENO);
+            dup2(log, STDERR_FILENO);
+        }
+        execl(setup.starter.c_str(), setup.starter.c_str(), "cds", (char *) nullptr);
+        _exit(127);
+    }
+    int status;
+    if (pid == -1 || waitpid(pid, &status, 0) != pid) {
+        return -1;
+    }
+    return WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+}
+
+// runs the starter and checks the CDS option the JVM got
+static bool expect(const Setup &setup, const char *step, const char *option) {
+    remove((setup.directory + "/java.args").c_str());
+    int status = runStarter(setup);
+    if (status != 0) {
+        fprintf(stderr, "test_cds: %s: the starter exited with %d, see %s/starter.log\n",
+                step, status, setup.directory.c_str());
+        return false;
+    }
+    std::string args;
+    if (!readFile(setup.directory + "/java.args", args)) {
+        fprintf(stderr, "test_cds: %s: java was not started, see %s/starter.log\n", step, setup.directory.c_str());
+        return false;
+    }
+    std::string archive = setup.directory + "/cds_appframe/work/appcds.jsa";
+    const char *other = option == DUMP ? USE : DUMP;
+    if (args.find(option + archive + "\n") == std::string::npos || args.find(other) != std::string::npos) {
+        fprintf(stderr, "test_cds: %s: expected %s%s, java got:\n%s", step, option, archive.c_str(), args.c_str());
+        return false;
+    }
+    printf("test_cds: %s: %s\n", step, option);
+    fflush(stdout);
+    return true;
+}
+
+int main(int argc, char *argv[]) {
+    Setup setup;
+    setup.starter = APPFRAME_STARTER;
+    std::string directory = "/tmp";
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--dir" && i + 1 < argc) {
+            directory = argv[++i];
+        } else if (arg == "--starter" && i + 1 < argc) {
+            setup.starter = argv[++i];
+        } else {
+            fprintf(stderr, "usage: test_cds [--dir DIR] [--starter PATH]\n");
+            return 1;
+        }
+    }
+
+    char buffer[64];
+    snprintf(buffer, sizeof(buffer), "/test_cds_%d", (int) getpid());
+    setup.directory = directory + buffer;
+    setup.war = setup.directory + "/app.war";
+    if (!createSetup(setup) || !writeConfiguration(setup, "jdk")) {
+        removeTree(setup.directory);
+        return 1;
+    }
+
+    // the size changes with the content, the stamp does not depend on the mtime resolution
+    bool success = expect(setup, "first run", DUMP) &&
+                   expect(setup, "second run", USE) &&
+                   writeFile(setup.war, "war 22") &&
+                   expect(setup, "changed war", DUMP) &&
+                   expect(setup, "after changed war", USE) &&
+                   writeConfiguration(setup, "jdk2") &&
+                   expect(setup, "changed java.home", DUMP) &&
+                   expect(setup, "after changed java.home", USE) &&
+                   writeFile(setup.directory + "/tomcat/lib/catalina.jar", "catalina 2") &&
+                   expect(setup, "changed tomcat jar", DUMP) &&
+                   expect(setup, "after changed tomcat jar", USE) &&
+                   writeFile(setup.directory + "/tomcat/lib/extra.jar", "extra") &&
+                   expect(setup, "added tomcat jar", DUMP);
+
+    // keeps the installation for a look at starter.log
+    if (success) {
+        removeTree(setup.directory);
+    }
+    return success ? 0 : 2;
+}